@@ -17,8 +17,10 @@
 //#include <app/Info.h>
 //#include <app/Lens.h>
 #include <core/Logger.h>
+#include <core/Metrics.h>
 #include <app/McuMisc.h>
 
+#include <chrono>
 #include <curses.h>
 #include <sstream>
 
@@ -32,8 +34,9 @@ extern int g_exit;
 namespace ncc
 {
 
-Application::Application(IMqttClient& mqttClient)
+Application::Application(IMqttClient& mqttClient, const SimClock& clock)
 	: m_mqtt(mqttClient)
+	, m_clock(clock)
 {
 	logger()->trace("Application::Application()");
 
@@ -85,6 +88,10 @@ void Application::Run()
 
 	doupdate();
 
+	auto& frames = metrics().Counter("app_frames_total", "Iterations of the UI loop");
+	auto& frameTime = metrics().Summary("app_frame_seconds", "Time spent in one UI loop iteration, excluding the sleep");
+	auto& handled = metrics().Counter("app_messages_handled_total", "MQTT messages handled by the UI");
+
 	for (;;)
 	{
 		if (g_exit)
@@ -92,6 +99,11 @@ void Application::Run()
 			break;
 		}
 
+		auto start = std::chrono::steady_clock::now();
+
+		handled.Add(m_tempSub->GetMailbox()->Drain());
+		handled.Add(m_heaterSub->GetMailbox()->Drain());
+
 		struct timeval tv;
 		gettimeofday(&tv, nullptr);
 
@@ -133,6 +145,11 @@ void Application::Run()
 		update_panels();
 		doupdate();
 
+		frames.Add();
+		frameTime.Record(std::chrono::steady_clock::now() - start);
+
+		// The frame rate is for the screen, so it stays in real time; how far
+		// things move per frame follows the clock.
 		usleep(30000);
 	}
 }
@@ -147,7 +164,7 @@ void Application::InitWindows_()
 		int y = 0;
 		int w = 40;
 		int h = 4; // useLabelBox => 4, !useLabelBox => 6
-		win = new Compass(x, y, w, h, "Pan" , 4, "Mm,.");
+		win = new Compass(x, y, w, h, "Pan" , 4, "Mm,.", false, m_clock);
 //		win->SetResponseHandler([this](const std::string& msg) { SendResponse_(msg); });
 		win->SetSendMessageFn([this](const std::vector<std::string>& msg) { OnCompMessage_(msg); });
 		m_wins["Pan"] = win;
@@ -158,7 +175,7 @@ void Application::InitWindows_()
 		int y = 0;
 		int w = 40;
 		int h = 4; // Base::useLabelBox => 4, !Base::useLabelBox => 6
-		win = new Compass(x, y, w, h, "Tilt", 4, "Nn[]", true);
+		win = new Compass(x, y, w, h, "Tilt", 4, "Nn[]", true, m_clock);
 		win->SetSendMessageFn([this](const std::vector<std::string>& msg) { OnCompMessage_(msg); });
 		m_wins["Tilt"] = win;
 	}
@@ -341,36 +358,21 @@ void Application::ShowStatusLine_()
 
 void Application::AddSubscriptions_()
 {
-	m_mqtt.RegisterSub("/temperature-monitor/temperature", this);
-	m_mqtt.RegisterSub("/heater/#", this);
-
-#if 0
-	m_notifier.Add(
+	// Replay the cached state so the windows don't start out blank.
+	m_tempSub = m_mqtt.Subscribe<Demo::temperature_t>(
 		"/temperature-monitor/temperature",
-		[this](const std::string& topic, const nlohmann::json& json) {
-			OnMessage_(topic, json);
-		});
-#endif
-
-#if 1
-//	m_mqtt.RegisterSub("/heater/#", this);
-#else
-	m_notifier.Add(
+		[this](std::string_view topic, const Demo::temperature_t& msg) {
+			OnTemperature_(msg);
+		},
+		MailboxConfig {.name = "Application/temperature"},
+		true);
+	m_heaterSub = m_mqtt.Subscribe<Demo::heater_t>(
 		"/heater/#",
-		[this](const std::string& topic, const nlohmann::json& json) {
-			OnMessage_(topic, json);
-		});
-#endif
-}
-
-void Application::OnConnect(int rc)
-{
-	logger()->trace("Application::OnConnect(rc={})", rc);
-}
-
-void Application::OnDisconnect(int rc)
-{
-	logger()->trace("Application::OnDisconnect(rc={})", rc);
+		[this](std::string_view topic, const Demo::heater_t& msg) {
+			OnHeater_(msg);
+		},
+		MailboxConfig {.name = "Application/heater"},
+		true);
 }
 
 // Handles messages coming from components.
@@ -406,25 +408,18 @@ void Application::SendCompMessage_(const std::vector<std::string>& msg)
 	}
 }
 
-// Handles messages coming from MQTT Broker.
-void Application::OnMessage(const std::string& topic, const nlohmann::json& json)
+// Handles temperature updates coming from MQTT Broker.
+void Application::OnTemperature_(const Demo::temperature_t& msg)
 {
-	const std::string tempTopic {"/temperature-monitor/temperature"};
-	const std::string heatTopic {"/heater/#"};
+	SendCompMessage_({ "SetTemp", std::to_string(msg.degCelsius)});
+}
 
-//	logger()->trace("Application::OnMessage(topic={}, json={})", topic, json.dump());
-	if (m_mqtt.IsTopicMatch(tempTopic, topic))
-	{
-		// TODO: Verify json field exists
-		SendCompMessage_({ "SetTemp", std::to_string(json["temperature"].get<float>())});
-	}
-	if (m_mqtt.IsTopicMatch(heatTopic, topic))
-	{
-//		SendCompMessage_({"SetHeater", json["enabled"], json["heater"]});
-		SendCompMessage_({
-			std::string("CmdHeater") + std::to_string(json["heater"].get<int>()),
-			(json["enabled"] ? "on" : "off")
-		});
-	}
+// Handles heater updates coming from MQTT Broker.
+void Application::OnHeater_(const Demo::heater_t& msg)
+{
+	SendCompMessage_({
+		std::string("CmdHeater") + std::to_string(msg.heaterType),
+		(msg.enabled ? "on" : "off")
+	});
 }
 } // namespace ncc
@@ -2,28 +2,30 @@
 
 #include <app/Base.h>
 #include <core/IMqttClient.h>
-#include <core/IMqttSubscriber.h>
+#include <core/Mailbox.h>
+#include <core/SimClock.h>
 
 #include <map>
+#include <memory>
 #include <vector>
 
+#include <types/Demo/heater_t.hpp>
+#include <types/Demo/temperature_t.hpp>
+
 #define NCURSES_NOMACROS
 #include <panel.h>
 
 namespace ncc
 {
 
-class Application : public IMqttSubscriber
+class Application
 {
 public:
-	Application(IMqttClient& mqttClient);
+	// The compasses move in the time of "clock".
+	Application(IMqttClient& mqttClient, const SimClock& clock = realClock());
 	~Application();
 	void Run();
 
-	void OnConnect(int rc) override;
-	void OnDisconnect(int rc) override;
-	void OnMessage(const std::string& topic, const nlohmann::json& json) override;
-
 private:
 	void InitWindows_();
 
@@ -34,12 +36,18 @@ private:
 	void ShowStatusLine_();
 
 	void AddSubscriptions_();
-	void OnMessage_(const std::string& topic, const nlohmann::json&);
+	void OnTemperature_(const Demo::temperature_t& msg);
+	void OnHeater_(const Demo::heater_t& msg);
 	void OnCompMessage_(const std::vector<std::string>& msg);
 	void SendCompMessage_(const std::vector<std::string>& msg);
 
 private:
 	IMqttClient& m_mqtt;
+	const SimClock& m_clock;
+
+	// curses isn't thread safe, so messages are queued and handled by Run().
+	std::unique_ptr<TypedSubscriber<Demo::temperature_t>> m_tempSub;
+	std::unique_ptr<TypedSubscriber<Demo::heater_t>> m_heaterSub;
 
 	std::map<std::string, Base*> m_wins;
 	Base* m_activeWin {nullptr};
@@ -2,11 +2,24 @@
 #include <app/Base.h>
 #include <app/Registry.h>
 
+#include <algorithm>
 #include <string>
 
 namespace ncc
 {
 
+namespace
+{
+
+// About one degree per frame of the UI loop, as when it moved a step per
+// frame.
+constexpr double degreesPerSecond {30.0};
+
+// Limits the catching up after a pause (or a jump of a simulation's clock).
+constexpr double maxStepsPerUpdate {360.0};
+
+} // namespace
+
 Compass::Compass(
 		int x,
 		int y,
@@ -15,9 +28,12 @@ Compass::Compass(
 		const std::string& label,
 		int labelColor,
 		const std::string& keys,
-		bool neg)
+		bool neg,
+		const SimClock& clock)
 	: Base(x, y, w, h, label, labelColor, false)
 	, m_label(label)
+	, m_clock(clock)
+	, m_lastUpdate(clock.Now())
 {
 	if (keys.length() != 4) throw std::runtime_error("Need four keys to bind to functions.");
 
@@ -95,7 +111,7 @@ int Compass::GetPosition() const
 	return m_pos;
 }
 
-std::string Compass::GenerateRepeatingPattern_(const std::string pattern, size_t width, size_t offset)
+std::string Compass::GenerateRepeatingPattern(const std::string& pattern, size_t width, size_t offset)
 {
 	if (offset > pattern.size() || offset > width)
 		throw std::out_of_range("Offset cannot exceed pattern length or generated string length.");
@@ -150,7 +166,7 @@ void Compass::DrawPos_()
 		int y = (m_useLabelBox ? 3 : 1);
 //		mvwprintw(win  , y, x, fmt, ...);
 		mvwprintw(m_win, y+0, 1, "%s", oss.str().substr(mid - c - 1, w).c_str());
-		mvwprintw(m_win, y+1, 1, "%s", GenerateRepeatingPattern_(m_ticks, w, m_tickOffset).c_str());
+		mvwprintw(m_win, y+1, 1, "%s", GenerateRepeatingPattern(m_ticks, w, m_tickOffset).c_str());
 		mvwchgat(m_win, y+0, c  , 3, A_BOLD, 1, nullptr);
 		mvwchgat(m_win, y+1, c+1, 1, A_BOLD, 1, nullptr);
 	}
@@ -210,7 +226,7 @@ void Compass::DrawNeg_()
 	{
 		int y = (m_useLabelBox ? 3 : 1);
 		mvwprintw(m_win, y+0, 1, "%s", oss.str().substr(mid - c - 1, w).c_str());
-		mvwprintw(m_win, y+1, 1, "%s", GenerateRepeatingPattern_(m_ticks, w, m_tickOffset).c_str());
+		mvwprintw(m_win, y+1, 1, "%s", GenerateRepeatingPattern(m_ticks, w, m_tickOffset).c_str());
 		if (m_pos >= 0)
 			mvwchgat(m_win, y+0, c, 3, A_BOLD, 1, nullptr);
 		else
@@ -270,6 +286,26 @@ void Compass::AdvanceNeg_()
 }
 
 void Compass::UpdateInfo_(uint32_t, uint32_t)
+{
+	auto now = m_clock.Now();
+	std::chrono::duration<double> elapsed = now - m_lastUpdate;
+	m_lastUpdate = now;
+
+	if (m_movement == movement_t::idle)
+	{
+		m_steps = 0.0;
+		return;
+	}
+
+	m_steps = std::min(m_steps + elapsed.count() * degreesPerSecond, maxStepsPerUpdate);
+	while (m_steps >= 1.0 && m_movement != movement_t::idle)
+	{
+		m_steps -= 1.0;
+		Step_();
+	}
+}
+
+void Compass::Step_()
 {
 	switch (m_movement)
 	{
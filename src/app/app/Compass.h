@@ -1,7 +1,9 @@
 #pragma once
 
 #include <app/Base.h>
+#include <core/SimClock.h>
 
+#include <chrono>
 #include <string>
 #include <functional>
 #include <map>
@@ -16,6 +18,9 @@ namespace ncc
 // |5  130  135  140  145|
 // |....|....|....|....|.|
 // +---------------------+
+//
+// The compass moves at a fixed speed in the time of "clock", however often
+// it is updated, so it keeps pace with an accelerated simulation.
 class Compass : public Base
 {
 public:
@@ -28,15 +33,19 @@ public:
 		const std::string& label,
 		int labelColor,
 		const std::string& keys,
-		bool neg = false);
+		bool neg = false,
+		const SimClock& clock = realClock());
 
 	void MoveTo(int pos);
 	void MoveBy(int value);
 	void MoveCont();
 	int GetPosition() const;
 
+	// Repeats "pattern" to fill "width" characters, starting "offset"
+	// characters into the pattern.
+	static std::string GenerateRepeatingPattern(const std::string& pattern, size_t width, size_t offset = 0);
+
 private:
-	std::string GenerateRepeatingPattern_(const std::string pattern, size_t width, size_t offset = 0);
 	void Draw_();
 	void DrawPos_();
 	void DrawNeg_();
@@ -45,6 +54,7 @@ private:
 	void Advance_();
 	void AdvancePos_();
 	void AdvanceNeg_();
+	void Step_();
 
 	std::string OnMessage_(const std::vector<std::string>& msg) override;
 	bool HandleInput_(int ch) override;
@@ -63,6 +73,10 @@ private:
 	int m_desiredPos = 0;		// 0-359
 	bool m_stepMove = false;	// Override m_moving for one step.
 
+	const SimClock& m_clock;
+	std::chrono::nanoseconds m_lastUpdate;
+	double m_steps = 0.0;		// Degrees due but not moved yet.
+
 	std::map<int, std::function<void()>> m_handlers;
 	std::pair<int, int> m_range = { 0, 0 };
 };
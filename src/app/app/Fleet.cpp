@@ -0,0 +1,72 @@
+#include <app/Fleet.h>
+#include <app/PluginLoader.h>
+#include <core/Logger.h>
+
+#include <ranges>
+#include <stdexcept>
+
+namespace ncc
+{
+
+Fleet::Fleet(PluginFactory& pluginFactory, IMqttClient& mqttClient, const FleetConfig& config)
+	: m_pluginFactory(pluginFactory)
+	, m_mqtt(mqttClient)
+	, m_config(config)
+	, m_scheduler(SchedulerConfig {.name = "Fleet", .threads = config.threads, .kernel = config.kernel})
+{
+	logger()->trace("Fleet::Fleet(cameras={}, threads={})", m_config.cameras, m_scheduler.Pool().Size());
+
+	constexpr int cbversion {3};
+	m_cameras.reserve(m_config.cameras);
+	for (int id = 0; id < m_config.cameras; ++id)
+	{
+		// Plugins keep a pointer to their Callbacks, so it must not move.
+		auto camera = std::make_unique<Camera>(Camera {
+			.cb {logger(), m_mqtt, cbversion, Prefix(id), &m_scheduler, m_config.dataDir},
+		});
+		for (const auto& name : m_config.plugins)
+		{
+			auto plugin = m_pluginFactory.Create(name, &camera->cb);
+			if (!plugin)
+			{
+				m_cameras.push_back(std::move(camera));
+				DestroyCameras_();
+				throw std::runtime_error("Fleet: failed to create " + name + " for " + Prefix(id));
+			}
+			camera->plugins.emplace_back(name, plugin);
+		}
+		m_cameras.push_back(std::move(camera));
+	}
+}
+
+Fleet::~Fleet()
+{
+	DestroyCameras_();
+}
+
+void Fleet::DestroyCameras_()
+{
+	// Stops the plugins' tasks, so nothing uses the scheduler after.
+	for (auto& camera : m_cameras)
+	{
+		for (auto& [name, plugin] : camera->plugins | std::views::reverse)
+		{
+			m_pluginFactory.Destroy(name, plugin);
+		}
+	}
+	m_cameras.clear();
+}
+
+void Fleet::Run()
+{
+	logger()->info("Fleet::Run(): starting {} camera(s)", m_cameras.size());
+	for (auto& camera : m_cameras)
+	{
+		for (auto& [name, plugin] : camera->plugins)
+		{
+			plugin->Run();
+		}
+	}
+}
+
+} // namespace ncc
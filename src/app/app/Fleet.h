@@ -0,0 +1,79 @@
+#pragma once
+
+#include <core/IMqttClient.h>
+#include <core/Scheduler.h>
+#include <core/SimKernel.h>
+#include <plugin/IPlugin.h>
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ncc
+{
+
+class PluginFactory;
+
+struct FleetConfig
+{
+	int cameras {0};
+
+	// Threads shared by every camera's plugins.
+	std::size_t threads {4};
+
+	// Each camera gets one instance of each; they must already have been
+	// added to the PluginFactory.
+	std::vector<std::string> plugins;
+
+	// Runs the plugins in the kernel's virtual time (see SchedulerConfig).
+	SimKernel* kernel {nullptr};
+
+	// Passed to the plugins (see Callbacks).
+	std::string dataDir;
+};
+
+// Fleet hosts many simulated cameras in one process, replacing a process per
+// camera. Every camera gets its own instance of each plugin, publishing and
+// subscribing under "/camera/<id>".
+//
+// All cameras share one MqttClient connection, and their plugins do their
+// work on the fleet's Scheduler rather than threads of their own. An extra
+// camera costs its plugin objects, coroutine frames and inboxes, which are a
+// few kilobytes.
+class Fleet
+{
+public:
+	Fleet(PluginFactory& pluginFactory, IMqttClient& mqttClient, const FleetConfig& config);
+	~Fleet();
+
+	Fleet(const Fleet&) = delete;
+	Fleet& operator=(const Fleet&) = delete;
+
+	// Calls Run() on every plugin instance.
+	void Run();
+
+	std::size_t Size() const { return m_cameras.size(); }
+
+	static std::string Prefix(int id) { return "/camera/" + std::to_string(id); }
+
+private:
+	void DestroyCameras_();
+
+	struct Camera
+	{
+		Callbacks cb;
+		std::vector<std::pair<std::string, IPlugin*>> plugins;
+	};
+
+private:
+	PluginFactory& m_pluginFactory;
+	IMqttClient& m_mqtt;
+	const FleetConfig m_config;
+
+	Scheduler m_scheduler;
+
+	std::vector<std::unique_ptr<Camera>> m_cameras;
+};
+
+} // namespace ncc
@@ -1,5 +1,6 @@
 #include <app/PluginLoader.h>
 #include <core/Logger.h>
+#include <core/Metrics.h>
 
 #include <algorithm>
 
@@ -10,6 +11,28 @@
 namespace ncc
 {
 
+namespace
+{
+
+GaugeMetric& LibrariesLoaded()
+{
+	static auto& gauge = metrics().Gauge("plugin_libraries_loaded", "Plugin libraries currently loaded");
+	return gauge;
+}
+
+CounterMetric& LoadFailures()
+{
+	static auto& counter = metrics().Counter("plugin_load_failures_total", "Plugin libraries that failed to load");
+	return counter;
+}
+
+GaugeMetric& Instances(const std::string& name)
+{
+	return metrics().Gauge("plugin_instances", "Plugin instances currently created", {{"plugin", name}});
+}
+
+} // namespace
+
 bool PluginFactory::Add(const std::string& name, const std::string& path)
 {
 	if (m_plugins.find(name) != m_plugins.end())
@@ -23,16 +46,23 @@ bool PluginFactory::Add(const std::string& name, const std::string& path)
 	if (!PluginLoad_(plugin, name, path))
 	{
 		ncc::logger()->debug("PluginFactory::AddFactory(): {} Plugin::Load() failed", name);
+		LoadFailures().Add();
 		return false;
 	}
 
 	m_plugins.insert({name, plugin});
+	LibrariesLoaded().Add();
 	return true;
 }
 
 bool PluginFactory::Remove(const std::string& name)
 {
-	return m_plugins.erase(name) == 1;
+	if (m_plugins.erase(name) != 1)
+	{
+		return false;
+	}
+	LibrariesLoaded().Sub();
+	return true;
 }
 
 IPlugin* PluginFactory::Create(const std::string& name, Callbacks* cb)
@@ -81,6 +111,7 @@ bool PluginFactory::PluginAddObj_(Plugin& plugin, IPlugin* ptr)
 	if (ptr)
 	{
 		plugin.objs.push_back(ptr);
+		Instances(plugin.name).Add();
 		return true;
 	}
 	return false;
@@ -89,7 +120,13 @@ bool PluginFactory::PluginAddObj_(Plugin& plugin, IPlugin* ptr)
 bool PluginFactory::PluginRemoveObj_(Plugin& plugin, IPlugin* ptr)
 {
 	auto it = std::find_if(plugin.objs.begin(), plugin.objs.end(), [ptr](IPlugin* p) { return p == ptr; });
-	return plugin.objs.erase(it) != plugin.objs.end(); 
+	if (it == plugin.objs.end())
+	{
+		return false;
+	}
+	plugin.objs.erase(it);
+	Instances(plugin.name).Sub();
+	return true;
 }
 
 bool PluginFactory::PluginLoad_(Plugin& plugin, const std::string& pluginName, const std::string& filePath)
@@ -1,12 +1,26 @@
 #include <app/Application.h>
+#include <app/Fleet.h>
 #include <app/PluginLoader.h>
 #include <core/Logger.h>
+#include <core/MetricsServer.h>
 #include <core/MqttClient.h>
+#include <core/Scheduler.h>
+#include <core/SimKernel.h>
+#include <core/SimMqttClient.h>
 //#include <plugin/Heater/HeaterTask.h>
 //#include <plugin/TempMonitor/TempMonitorTask.h>
 
+#include <algorithm>
+#include <charconv>
+#include <chrono>
 #include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
 
+#include <iomanip>
 #include <iostream>
 #include <signal.h>
 
@@ -22,14 +36,25 @@ void SigIntHandler(int signum)
 	}
 }
 
-IPlugin* LoadPlugin(
-	ncc::PluginFactory& pluginFactory,
-	Callbacks* cb,
-	const std::string& pluginName)
+// Returns false unless all of "str" is a number.
+template <typename T>
+bool ParseNumber(std::string_view str, T& value)
+{
+	auto end = str.data() + str.size();
+	auto [ptr, ec] = std::from_chars(str.data(), end, value);
+	return ec == std::errc {} && ptr == end;
+}
+
+void PrintUsage(const char* exe)
+{
+	std::cerr << "Usage: " << exe
+		<< " [--fleet <cameras>] [--sim-rate <rate>] [--sim-time <seconds>] [--telemetry <dir>]" << std::endl;
+}
+
+bool AddPlugin(ncc::PluginFactory& pluginFactory, const std::string& pluginName)
 {
 	namespace fs = std::filesystem;
 
-	IPlugin* plugin {nullptr};
 	int pos {0};
 	try
 	{
@@ -41,50 +66,283 @@ IPlugin* LoadPlugin(
 		if (!pluginFactory.Add(pluginName, filePath))
 		{
 			ncc::logger()->error("Failed to load {} from {}", pluginName, filePath);
+			return false;
 		}
-		else
-		{
-			pos = 3;
-			plugin = pluginFactory.Create(pluginName, cb);
-			if (!plugin)
-			{
-				ncc::logger()->error("Failed to create {}", pluginName);
-			}
-		}
-		pos = 4;
+		return true;
 	}
 	catch (const std::exception& e)
 	{
-		ncc::logger()->error("Loadplugin(pos={}): Caught: {}", pos, e.what());
+		ncc::logger()->error("AddPlugin(pos={}): Caught: {}", pos, e.what());
+	}
+	return false;
+}
+
+IPlugin* LoadPlugin(
+	ncc::PluginFactory& pluginFactory,
+	Callbacks* cb,
+	const std::string& pluginName)
+{
+	IPlugin* plugin {nullptr};
+	if (AddPlugin(pluginFactory, pluginName))
+	{
+		plugin = pluginFactory.Create(pluginName, cb);
+		if (!plugin)
+		{
+			ncc::logger()->error("Failed to create {}", pluginName);
+		}
 	}
 	return plugin;
 }
 
-int main()
+// Runs "cameras" cameras in this process, without the UI, until SIGINT.
+//
+// With a kernel (and "mqttClient" a SimMqttClient on it), the cameras run in
+// its virtual time instead, for "simTime" (or until SIGINT), then a summary
+// is printed. Its digest is the same for every run of the same scenario.
+int RunFleet(
+	ncc::PluginFactory& pluginFactory,
+	ncc::IMqttClient& mqttClient,
+	int cameras,
+	ncc::SimKernel* kernel,
+	const ncc::SimMqttClient* simClient,
+	std::chrono::seconds simTime,
+	const std::string& telemetryDir)
+{
+	ncc::FleetConfig config {
+		.cameras = cameras,
+		.threads = std::max(2u, std::thread::hardware_concurrency()),
+		.plugins = {"PluginHeater", "PluginTempMonitor"},
+		.kernel = kernel,
+		.dataDir = telemetryDir,
+	};
+	if (!telemetryDir.empty())
+	{
+		config.plugins.push_back("PluginTelemetry");
+	}
+	for (const auto& pluginName : config.plugins)
+	{
+		if (!AddPlugin(pluginFactory, pluginName))
+		{
+			std::cerr << "Failed to load " << pluginName << std::endl;
+			return 1;
+		}
+	}
+
+	ncc::Fleet fleet(pluginFactory, mqttClient, config);
+	fleet.Run();
+
+	if (!kernel)
+	{
+		std::cout << "Running " << fleet.Size() << " cameras under " << ncc::Fleet::Prefix(0)
+			<< "..., press Ctrl-C to stop." << std::endl;
+		while (!g_exit)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		}
+		return 0;
+	}
+
+	std::cout << "Simulating " << fleet.Size() << " cameras for " << simTime.count() << " s";
+	if (kernel->Config().rate > 0.0)
+	{
+		std::cout << " at " << kernel->Config().rate << "x";
+	}
+	std::cout << "..." << std::endl;
+
+	// In slices, so SIGINT is noticed.
+	auto start = std::chrono::steady_clock::now();
+	while (!g_exit && kernel->Now() < simTime)
+	{
+		kernel->RunFor(std::min<std::chrono::nanoseconds>(1s, simTime - kernel->Now()));
+	}
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	std::chrono::duration<double> simulated = kernel->Now();
+	std::cout << "Simulated " << simulated.count() << " s in " << elapsed.count() << " s: "
+		<< kernel->Executed() << " events, " << simClient->Published() << " messages, digest "
+		<< std::hex << std::setw(16) << std::setfill('0') << simClient->Digest() << std::dec << std::endl;
+	return 0;
+}
+
+int main(int argc, char** argv)
 {
+	// --fleet N runs N cameras headless instead of one camera with the UI.
+	//
+	// --sim-rate R runs the plugins in virtual time, R times faster than real
+	// time (0 for as fast as possible), on an in-process broker instead of
+	// the MQTT broker. With --fleet, --sim-time S stops after S simulated
+	// seconds (an hour by default).
+	//
+	// --telemetry DIR records each camera's telemetry under DIR/telemetry
+	// (see PluginTelemetry).
+	int fleetSize {0};
+	double simRate {-1.0};
+	std::chrono::seconds simTime {3600s};
+	std::string telemetryDir;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg(argv[i]);
+		if (i + 1 == argc)
+		{
+			PrintUsage(argv[0]);
+			return 1;
+		}
+
+		std::string_view value(argv[++i]);
+		bool valid {true};
+		if (arg == "--fleet")
+		{
+			valid = ParseNumber(value, fleetSize) && fleetSize > 0;
+		}
+		else if (arg == "--sim-rate")
+		{
+			valid = ParseNumber(value, simRate) && simRate >= 0.0;
+		}
+		else if (arg == "--sim-time")
+		{
+			long seconds {0};
+			valid = ParseNumber(value, seconds) && seconds > 0;
+			simTime = std::chrono::seconds(seconds);
+		}
+		else if (arg == "--telemetry")
+		{
+			telemetryDir = value;
+		}
+		else
+		{
+			PrintUsage(argv[0]);
+			return 1;
+		}
+
+		if (!valid)
+		{
+			std::cerr << "Invalid " << arg << " \"" << value << "\"" << std::endl;
+			PrintUsage(argv[0]);
+			return 1;
+		}
+	}
+
 	signal(SIGINT, SigIntHandler);
 
 	int ret {0};
 
 	try
 	{
-		ncc::InitializeLogger("camera", false, {"udp", "file"}, spdlog::level::trace);
+		// Everything down to trace is logged, including from the MQTT network
+		// thread, so the sinks are written by a logging thread instead. If it
+		// falls behind, the oldest messages are dropped rather than holding
+		// up the caller (see log_messages_dropped_total).
+		ncc::InitializeLogger("camera", false, {"udp", "file"}, spdlog::level::trace, ncc::AsyncLogConfig {
+			.enabled = true,
+			.queueSize = 8192,
+			.threads = 1,
+			.overflow = ncc::LogOverflowPolicy::DropOldest,
+		});
 		ncc::logger()->trace("main()");
 		// TODO: Use a better way to manage version number rather than hard-coding it.
 		ncc::logger()->info("Camera Simulator v0.0.2");
 
 		const std::string host{"localhost"};
 		constexpr int port {1883};
-		ncc::MqttClient mqttClient("client", host, port);
-		constexpr int cbversion {1};
+		// Publishing must never block the network or UI threads, so queue
+		// messages while disconnected rather than waiting for the broker.
+		// Temperature and heater messages carry state, so only the newest
+		// value of each is kept while messages are queued.
+		ncc::OutboxConfig outbox {
+			.capacity = 1024,
+			.policy = ncc::OverflowPolicy::DropOldest,
+			.conflate = {
+				"/temperature-monitor/temperature",
+				"/heater/+",
+				"/camera/+/temperature-monitor/temperature",
+				"/camera/+/heater/+",
+			},
+		};
+		// The plugins and the UI share this client, so deliver their messages
+		// to each other directly. Everything is still sent to the broker for
+		// external tools.
+		ncc::LocalDeliveryConfig local {.enabled = true};
+		// Each camera publishes about half a dozen topics (temperature, two
+		// heaters, power, telemetry), so keep room for every camera of the
+		// fleet rather than only the first ones.
+		constexpr std::size_t topicsPerCamera {8};
+		ncc::LatencyConfig latency {
+			.enabled = true,
+			.maxTopics = std::max<std::size_t>(1024, topicsPerCamera * fleetSize),
+		};
+		// The plugins and the UI replay the temperature and heater state when
+		// they subscribe; nothing else needs to be cached.
+		ncc::CacheConfig cache {
+			.topics = {
+				"/temperature-monitor/temperature",
+				"/heater/+",
+				"/camera/+/temperature-monitor/temperature",
+				"/camera/+/heater/+",
+			},
+		};
+
+		// A simulation is self-contained: its messages are events of the
+		// kernel, so that runs are reproducible.
+		std::unique_ptr<ncc::SimKernel> kernel;
+		std::unique_ptr<ncc::IMqttClient> mqttClient;
+		ncc::SimMqttClient* simClient {nullptr};
+		if (simRate >= 0.0)
+		{
+			kernel = std::make_unique<ncc::SimKernel>(ncc::SimKernelConfig {
+				.name = "Simulation",
+				.rate = simRate,
+			});
+			auto client = std::make_unique<ncc::SimMqttClient>(*kernel);
+			simClient = client.get();
+			mqttClient = std::move(client);
+		}
+		else
+		{
+			mqttClient = std::make_unique<ncc::MqttClient>("client", host, port, outbox, local,
+				ncc::ReconnectConfig {}, ncc::InFlightConfig {}, latency, cache);
+		}
+
+		// The stand-alone camera's plugins; only needed to run on the kernel.
+		std::unique_ptr<ncc::Scheduler> simScheduler;
+		if (kernel && fleetSize == 0)
+		{
+			simScheduler = std::make_unique<ncc::Scheduler>(ncc::SchedulerConfig {
+				.name = "Simulation",
+				.threads = 1,
+				.kernel = kernel.get(),
+			});
+		}
+
+		constexpr int cbversion {3};
 		Callbacks cb {
 			ncc::logger(),
-			mqttClient,
-			cbversion
+			*mqttClient,
+			cbversion,
+			{},
+			simScheduler.get(),
+			telemetryDir,
 		};
 
+		// Metrics are scraped from http://127.0.0.1:9464/metrics. The simulator
+		// still runs if the port is taken.
+		std::unique_ptr<ncc::MetricsServer> metricsServer;
+		try
+		{
+			constexpr int metricsPort {9464};
+			metricsServer = std::make_unique<ncc::MetricsServer>(ncc::metrics(), metricsPort);
+		}
+		catch (const std::system_error& e)
+		{
+			ncc::logger()->warn("Metrics are not available: {}", e.what());
+		}
+
 		ncc::PluginFactory pluginFactory;
 
+		if (fleetSize > 0)
+		{
+			return RunFleet(pluginFactory, *mqttClient, fleetSize, kernel.get(), simClient, simTime, telemetryDir);
+		}
+
 		// TODO: Load and configure plugins from a configuration file.
 		// For now, create some here to verify that loading works and MQTT works.
 
@@ -104,6 +362,18 @@ int main()
 			return 1;
 		}
 
+		IPlugin* telemetryPlugin {nullptr};
+		if (!telemetryDir.empty())
+		{
+			pluginName = "PluginTelemetry";
+			telemetryPlugin = LoadPlugin(pluginFactory, &cb, pluginName);
+			if (!telemetryPlugin)
+			{
+				std::cerr << "Failed to load and create " << pluginName << std::endl;
+				return 1;
+			}
+		}
+
 		// After all plugins have been loaded, call their Run() method to
 		// kick them off.
 		//
@@ -112,9 +382,17 @@ int main()
 		// passively respond to MQTT requests (using callers thread).
 		heaterPlugin->Run();
 		tempMonitorPlugin->Run();
+		if (telemetryPlugin)
+		{
+			telemetryPlugin->Run();
+		}
 
 		// Now start ncurses interface to visualize what is happening.
-		ncc::Application app(mqttClient);
+		if (kernel)
+		{
+			kernel->Start();
+		}
+		ncc::Application app(*mqttClient, kernel ? *kernel : ncc::realClock());
 		app.Run();
 	}
 	catch (const std::exception& e)
@@ -0,0 +1,46 @@
+#include <app/Compass.h>
+#include <app/Registry.h>
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+
+namespace ncc
+{
+
+// Formatting one line of the Info panel; range(0) is the line number, so the
+// cost of walking the entries in front of it is included.
+static void BM_RegistryGetLine(benchmark::State& state)
+{
+	Registry reg;
+	for (int i = 0; i < 32; ++i)
+	{
+		auto name = "Entry" + std::to_string(i);
+		reg.Add(name, "[ab]", name + ": description", "idle", 8);
+	}
+
+	auto num = static_cast<std::size_t>(state.range(0));
+	std::string line;
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(reg.GetLine(num, line));
+	}
+}
+BENCHMARK(BM_RegistryGetLine)->Arg(0)->Arg(8)->Arg(31);
+
+// The tick line drawn by Compass on every frame; range(0) is the window width.
+static void BM_CompassRepeatingPattern(benchmark::State& state)
+{
+	const std::string ticks {"....|"};
+	auto width = static_cast<std::size_t>(state.range(0));
+	std::size_t offset {0};
+	for (auto _ : state)
+	{
+		auto line = Compass::GenerateRepeatingPattern(ticks, width, offset);
+		benchmark::DoNotOptimize(line.data());
+		offset = (offset + 1) % ticks.size();
+	}
+}
+BENCHMARK(BM_CompassRepeatingPattern)->Arg(38)->Arg(78)->Arg(238);
+
+} // namespace ncc
@@ -0,0 +1,169 @@
+#include <bench/FakeMqttClient.h>
+#include <core/JsonWriter.h>
+#include <core/ZcmMessage.h>
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+
+#include <nlohmann/json.hpp>
+
+#include <types/Demo/heater_t.hpp>
+#include <types/Demo/temperature_t.hpp>
+
+namespace ncc
+{
+
+// Heater state as HeaterTask::PublishHeater_() publishes it, in its ZCM
+// encoding...
+static void BM_HeaterEncodeZcm(benchmark::State& state)
+{
+	Demo::heater_t msg {};
+	msg.utime = UtimeNow();
+	msg.heaterType = Demo::heater_t::HOUSING;
+	msg.enabled = true;
+	for (auto _ : state)
+	{
+		auto payload = ZcmEncode(msg);
+		benchmark::DoNotOptimize(payload.data());
+	}
+}
+BENCHMARK(BM_HeaterEncodeZcm);
+
+// ...and as the JSON it used to publish, for comparison.
+static void BM_HeaterEncodeJsonWriter(benchmark::State& state)
+{
+	for (auto _ : state)
+	{
+		auto& writer = JsonWriter::ThreadLocal();
+		writer.BeginObject()
+			.Field("heater", 1)
+			.Field("enabled", true)
+			.EndObject();
+		benchmark::DoNotOptimize(writer.Bytes().data());
+	}
+}
+BENCHMARK(BM_HeaterEncodeJsonWriter);
+
+static void BM_HeaterEncodeNlohmann(benchmark::State& state)
+{
+	for (auto _ : state)
+	{
+		nlohmann::json json {{"heater", 1}, {"enabled", true}};
+		auto text = json.dump();
+		benchmark::DoNotOptimize(text.data());
+	}
+}
+BENCHMARK(BM_HeaterEncodeNlohmann);
+
+// Heater state as read by Application::OnHeater_()...
+static void BM_HeaterDecodeZcm(benchmark::State& state)
+{
+	Demo::heater_t in {};
+	in.utime = UtimeNow();
+	in.heaterType = Demo::heater_t::HOUSING;
+	in.enabled = true;
+	auto encoded = ZcmEncode(in);
+	std::vector<std::byte> payload(encoded.begin(), encoded.end());
+
+	Demo::heater_t out {};
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(ZcmDecode(payload, out));
+	}
+}
+BENCHMARK(BM_HeaterDecodeZcm);
+
+// ...and from JSON.
+static void BM_HeaterDecode(benchmark::State& state)
+{
+	const std::string payload {R"({"heater":1,"enabled":true})"};
+	for (auto _ : state)
+	{
+		MqttMessage message("/heater/1", std::as_bytes(std::span(payload)));
+		auto json = message.Json();
+		benchmark::DoNotOptimize((*json)["heater"].get<int>());
+		benchmark::DoNotOptimize((*json)["enabled"].get<bool>());
+	}
+}
+BENCHMARK(BM_HeaterDecode);
+
+// Temperature as published by TempMonitorTask, in its ZCM encoding...
+static void BM_TemperatureEncodeZcm(benchmark::State& state)
+{
+	Demo::temperature_t msg {};
+	msg.utime = UtimeNow();
+	msg.degCelsius = 21.5f;
+	for (auto _ : state)
+	{
+		auto payload = ZcmEncode(msg);
+		benchmark::DoNotOptimize(payload.data());
+	}
+}
+BENCHMARK(BM_TemperatureEncodeZcm);
+
+static void BM_TemperatureDecodeZcm(benchmark::State& state)
+{
+	Demo::temperature_t in {};
+	in.utime = UtimeNow();
+	in.degCelsius = 21.5f;
+	auto encoded = ZcmEncode(in);
+	std::vector<std::byte> payload(encoded.begin(), encoded.end());
+
+	Demo::temperature_t out {};
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(ZcmDecode(payload, out));
+	}
+}
+BENCHMARK(BM_TemperatureDecodeZcm);
+
+// ...and the same message as JSON, for comparison.
+static void BM_TemperatureEncodeJson(benchmark::State& state)
+{
+	auto utime = UtimeNow();
+	for (auto _ : state)
+	{
+		auto& writer = JsonWriter::ThreadLocal();
+		writer.BeginObject()
+			.Field("utime", utime)
+			.Field("degCelsius", 21.5f)
+			.EndObject();
+		benchmark::DoNotOptimize(writer.Bytes().data());
+	}
+}
+BENCHMARK(BM_TemperatureEncodeJson);
+
+static void BM_TemperatureDecodeJson(benchmark::State& state)
+{
+	const std::string payload = nlohmann::json {{"utime", UtimeNow()}, {"degCelsius", 21.5}}.dump();
+	for (auto _ : state)
+	{
+		MqttMessage message("/temperature-monitor/temperature", std::as_bytes(std::span(payload)));
+		auto json = message.Json();
+		benchmark::DoNotOptimize((*json)["degCelsius"].get<float>());
+	}
+}
+BENCHMARK(BM_TemperatureDecodeJson);
+
+// Typed publish -> TypedSubscriber round trip through IMqttClient.
+static void BM_TemperatureTypedRoundTrip(benchmark::State& state)
+{
+	FakeMqttClient client;
+	float received {0};
+	auto sub = client.Subscribe<Demo::temperature_t>(
+		"/temperature-monitor/temperature",
+		[&received](std::string_view, const Demo::temperature_t& msg) { received = msg.degCelsius; });
+
+	Demo::temperature_t msg {};
+	msg.degCelsius = 21.5f;
+	for (auto _ : state)
+	{
+		msg.utime = UtimeNow();
+		client.Publish("/temperature-monitor/temperature", msg);
+	}
+	benchmark::DoNotOptimize(received);
+}
+BENCHMARK(BM_TemperatureTypedRoundTrip);
+
+} // namespace ncc
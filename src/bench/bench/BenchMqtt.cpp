@@ -0,0 +1,116 @@
+#include <bench/FakeMqttClient.h>
+#include <core/MqttClient.h>
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <mosquitto.h>
+
+namespace ncc
+{
+
+namespace
+{
+
+// Counts messages without parsing them, so only matching and dispatch are
+// measured.
+class CountingSubscriber : public IMqttSubscriber
+{
+public:
+	void OnConnect(int rc) override {}
+	void OnDisconnect(int rc) override {}
+	void OnRawMessage(const MqttMessage& msg) override { benchmark::DoNotOptimize(++m_count); }
+
+private:
+	std::uint64_t m_count {0};
+};
+
+// A client that never reaches a broker: port 1 refuses the connection and the
+// retry delay keeps the network thread asleep while benchmarks run.
+std::unique_ptr<MqttClient> MakeOfflineClient()
+{
+	ReconnectConfig reconnect {.initialDelay = 60s, .maxDelay = 60s};
+	return std::make_unique<MqttClient>("camsim_bench", "127.0.0.1", 1, OutboxConfig{}, LocalDeliveryConfig{}, reconnect);
+}
+
+} // namespace
+
+static void BM_IsTopicMatch(benchmark::State& state)
+{
+	auto client = MakeOfflineClient();
+	const std::vector<std::pair<std::string, std::string>> cases {
+		{"/heater/+", "/heater/1"},
+		{"/heater/#", "/heater/1/state"},
+		{"/temperature-monitor/temperature", "/temperature-monitor/temperature"},
+		{"/camera/+/lens/+", "/camera/42/lens/zoom"},
+		{"/camera/+/lens/+", "/camera/42/pan/position"},
+	};
+	std::size_t i {0};
+	for (auto _ : state)
+	{
+		const auto& [filter, topic] = cases[i++ % cases.size()];
+		benchmark::DoNotOptimize(client->IsTopicMatch(filter, topic));
+	}
+}
+BENCHMARK(BM_IsTopicMatch);
+
+// Dispatch of one incoming message with range(0) subscriptions registered,
+// 1 in 8 of which match the topic.
+static void BM_OnMessage(benchmark::State& state)
+{
+	auto client = MakeOfflineClient();
+	auto count = static_cast<int>(state.range(0));
+	std::vector<std::unique_ptr<CountingSubscriber>> subs;
+	for (int i = 0; i < count; ++i)
+	{
+		subs.push_back(std::make_unique<CountingSubscriber>());
+		auto filter = (i % 8 == 0 ? "/camera/+/temperature" : "/camera/" + std::to_string(i) + "/lens/#");
+		client->RegisterSub(filter, subs.back().get());
+	}
+
+	std::string topic {"/camera/7/temperature"};
+	std::string payload {R"({"degCelsius":21.5})"};
+	mosquitto_message msg {};
+	msg.topic = topic.data();
+	msg.payload = payload.data();
+	msg.payloadlen = static_cast<int>(payload.size());
+
+	for (auto _ : state)
+	{
+		MqttClient::OnMessage(nullptr, client.get(), &msg);
+	}
+	state.SetItemsProcessed(state.iterations());
+
+	for (auto& sub : subs)
+	{
+		client->UnregisterSub(sub.get());
+	}
+}
+BENCHMARK(BM_OnMessage)->RangeMultiplier(8)->Range(8, 4096);
+
+// The same publish -> subscriber path through the IMqttClient interface,
+// without MqttClient's cache and metrics.
+static void BM_FakePublish(benchmark::State& state)
+{
+	FakeMqttClient client;
+	auto count = static_cast<int>(state.range(0));
+	std::vector<std::unique_ptr<CountingSubscriber>> subs;
+	for (int i = 0; i < count; ++i)
+	{
+		subs.push_back(std::make_unique<CountingSubscriber>());
+		client.RegisterSub("/heater/+", subs.back().get());
+	}
+
+	std::string payload {R"({"heater":1,"enabled":true})"};
+	for (auto _ : state)
+	{
+		client.Publish("/heater/1", std::as_bytes(std::span(payload)));
+	}
+	state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_FakePublish)->RangeMultiplier(4)->Range(1, 256);
+
+} // namespace ncc
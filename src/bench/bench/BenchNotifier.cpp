@@ -0,0 +1,55 @@
+#include <core/Notifier.h>
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+
+#include <nlohmann/json.hpp>
+
+namespace ncc
+{
+
+// Notify() fan-out to range(0) callbacks, all registered on filters that
+// match the topic.
+static void BM_NotifierFanOut(benchmark::State& state)
+{
+	Notifier notifier;
+	auto count = static_cast<int>(state.range(0));
+	std::uint64_t calls {0};
+	const char* filters[] {"/heater/1", "/heater/+", "/heater/#", "#"};
+	for (int i = 0; i < count; ++i)
+	{
+		notifier.Add(filters[i % 4], [&calls](const std::string&, const nlohmann::json&) { ++calls; });
+	}
+
+	const std::string topic {"/heater/1"};
+	const nlohmann::json json {{"heater", 1}, {"enabled", true}};
+	for (auto _ : state)
+	{
+		notifier.Notify(topic, json);
+	}
+	benchmark::DoNotOptimize(calls);
+	state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_NotifierFanOut)->RangeMultiplier(4)->Range(1, 1024);
+
+// Notify() on a topic nobody listens to, with range(0) unrelated callbacks.
+static void BM_NotifierMiss(benchmark::State& state)
+{
+	Notifier notifier;
+	auto count = static_cast<int>(state.range(0));
+	for (int i = 0; i < count; ++i)
+	{
+		notifier.Add("/camera/" + std::to_string(i) + "/+", [](const std::string&, const nlohmann::json&) {});
+	}
+
+	const std::string topic {"/heater/1"};
+	const nlohmann::json json {{"heater", 1}, {"enabled", true}};
+	for (auto _ : state)
+	{
+		notifier.Notify(topic, json);
+	}
+}
+BENCHMARK(BM_NotifierMiss)->RangeMultiplier(8)->Range(8, 4096);
+
+} // namespace ncc
@@ -0,0 +1,61 @@
+#include <bench/FakeMqttClient.h>
+#include <core/SharedBuffer.h>
+#include <core/ZcmMessage.h>
+
+#include <benchmark/benchmark.h>
+
+#include <cstring>
+#include <vector>
+
+#include <types/Demo/shm_buffer_t.hpp>
+
+namespace ncc
+{
+
+// A frame of range(0) bytes handed over through shared memory: the publisher
+// copies it into a pool slot and publishes the descriptor, the subscriber
+// decodes the descriptor and maps the slot. Only the descriptor goes through
+// the client, so the cost shouldn't grow with the frame beyond the copy in.
+static void BM_SharedBufferRoundTrip(benchmark::State& state)
+{
+	const auto size = static_cast<std::size_t>(state.range(0));
+	FakeMqttClient client;
+	SharedBufferPool pool("camsim_bench", 4, size);
+	SharedBufferReader reader;
+
+	std::size_t received {0};
+	auto sub = client.Subscribe<Demo::shm_buffer_t>(
+		"/camera/1/frame",
+		[&reader, &received](std::string_view topic, const Demo::shm_buffer_t& desc) {
+			auto buffer = reader.Acquire(desc);
+			if (buffer)
+			{
+				benchmark::DoNotOptimize(buffer.Data().back());
+				received += buffer.Size();
+			}
+		});
+
+	const std::vector<std::byte> frame(size, std::byte {0x5a});
+	SharedBuffer buffer;
+	for (auto _ : state)
+	{
+		// Assigning releases the previous frame, which keeps it readable until
+		// the next one is published.
+		buffer = pool.Allocate(size);
+		if (!buffer)
+		{
+			state.SkipWithError("pool exhausted");
+			break;
+		}
+		std::memcpy(buffer.Data().data(), frame.data(), size);
+		client.Publish("/camera/1/frame", buffer.Descriptor());
+	}
+	if (received != state.iterations() * size)
+	{
+		state.SkipWithError("a frame couldn't be read back");
+	}
+	state.SetBytesProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_SharedBufferRoundTrip)->RangeMultiplier(16)->Range(4 << 10, 4 << 20);
+
+} // namespace ncc
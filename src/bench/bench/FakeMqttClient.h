@@ -0,0 +1,106 @@
+#pragma once
+
+#include <core/IMqttClient.h>
+#include <core/MqttMessage.h>
+#include <core/TopicTrie.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace ncc
+{
+
+// In-process IMqttClient for benchmarks: every publish is dispatched to the
+// matching subscribers on the calling thread, as if the broker had echoed it
+// back instantly. Nothing is cached, queued or tracked.
+class FakeMqttClient : public IMqttClient
+{
+public:
+	void RegisterSub(const std::string& topic, IMqttSubscriber* sub, bool replay = false) override
+	{
+		auto& subs = m_topics.Insert(topic)->values;
+		if (std::find(subs.begin(), subs.end(), sub) == subs.end())
+		{
+			subs.push_back(sub);
+		}
+	}
+
+	void UnregisterSub(IMqttSubscriber* sub) override
+	{
+		m_topics.ForEach([sub](auto& node) {
+			std::erase(node.values, sub);
+		});
+	}
+
+	bool IsConnected() const override { return true; }
+
+	using IMqttClient::Publish;
+
+	bool Publish(
+		const std::string& topic,
+		const nlohmann::json& json,
+		int qos = 0,
+		bool retain = false,
+		const std::chrono::duration<long, std::ratio<1, 1>>& delay = 5s) override
+	{
+		std::string jsonstr = json.dump();
+		return Publish(topic, std::as_bytes(std::span(jsonstr)), qos, retain, delay);
+	}
+
+	bool Publish(
+		const std::string& topic,
+		std::span<const std::byte> payload,
+		int qos = 0,
+		bool retain = false,
+		const std::chrono::duration<long, std::ratio<1, 1>>& delay = 5s) override
+	{
+		MqttMessage message(topic, payload);
+		m_topics.Match(message.Topic(), [&message](const auto& node) {
+			for (auto sub : node.values)
+			{
+				sub->OnRawMessage(message);
+			}
+		});
+		++m_published;
+		return true;
+	}
+
+	PublishToken PublishTracked(
+		const std::string& topic,
+		std::span<const std::byte> payload,
+		int qos = 1,
+		bool retain = false) override
+	{
+		Publish(topic, payload, qos, retain);
+		return {};
+	}
+
+	PublishStats GetPublishStats() const override { return {}; }
+
+	bool IsTopicMatch(const std::string& sub, const std::string& topic) override
+	{
+		TopicTrie<bool> trie;
+		trie.Insert(sub)->values.push_back(true);
+		bool match {false};
+		trie.Match(topic, [&match](const auto&) { match = true; });
+		return match;
+	}
+
+	OutboxStats GetOutboxStats() const override { return {}; }
+	ConnectionStats GetConnectionStats() const override { return {.connected = true}; }
+	std::map<std::string, LatencyStats> GetLatencyStats() const override { return {}; }
+	void ResetLatencyStats() override {}
+
+	bool GetLatest(const std::string& topic, std::vector<std::byte>& payload) const override { return false; }
+
+	std::uint64_t Published() const { return m_published; }
+
+private:
+	TopicTrie<IMqttSubscriber*> m_topics;
+	std::uint64_t m_published {0};
+};
+
+} // namespace ncc
@@ -0,0 +1,19 @@
+#include <core/Logger.h>
+
+#include <benchmark/benchmark.h>
+
+// Same as benchmark_main, but libcore needs its logger. Logging is turned off
+// so it doesn't distort the results.
+int main(int argc, char** argv)
+{
+	ncc::InitializeLogger("camsim_bench", false, {}, spdlog::level::off);
+
+	benchmark::Initialize(&argc, argv);
+	if (benchmark::ReportUnrecognizedArguments(argc, argv))
+	{
+		return 1;
+	}
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::Shutdown();
+	return 0;
+}
@@ -1,10 +1,12 @@
 #include <core/BaseThread.h>
+#include <core/SimKernel.h>
 
 namespace ncc
 {
 
-BaseThread::BaseThread(const std::string& name, bool autostart)
+BaseThread::BaseThread(const std::string& name, bool autostart, Scheduler* scheduler)
 	: m_name(name)
+	, m_scheduler(scheduler ? *scheduler : ncc::scheduler())
 {
 	if (autostart)
 	{
@@ -19,16 +21,37 @@ BaseThread::~BaseThread()
 
 void BaseThread::Start()
 {
-	if (!m_thread.joinable())
 	{
-		std::unique_lock lock(m_mutex);
-//		logger()->debug("{}: Start(): Starting thread...", m_name);
-		m_thread = std::thread(&BaseThread::Run, this);
+		std::unique_lock lock(m_timersMutex);
+		if (m_started)
+		{
+			return;
+		}
+		m_started = true;
 	}
+	OnStart_();
 }
 
 void BaseThread::Stop()
 {
+	std::vector<Scheduler::TimerId> timers;
+	{
+		std::unique_lock lock(m_timersMutex);
+		if (!m_started)
+		{
+			return;
+		}
+		m_started = false;
+		timers.swap(m_timers);
+	}
+
+	// Not under m_timersMutex: a running callback may be adding a timer.
+	for (auto id : timers)
+	{
+		m_scheduler.Cancel(id);
+	}
+	OnStop_();
+
 	if (m_thread.joinable())
 	{
 		std::unique_lock lock(m_mutex);
@@ -47,4 +70,69 @@ void BaseThread::Run()
 	Run_();
 }
 
+void BaseThread::OnStart_()
+{
+	std::unique_lock lock(m_mutex);
+//	logger()->debug("{}: Start(): Starting thread...", m_name);
+	m_running = true;
+	m_thread = std::thread(&BaseThread::Run, this);
+}
+
+Scheduler::TimerId BaseThread::Every(std::chrono::milliseconds period, Scheduler::Callback fn)
+{
+	std::unique_lock lock(m_timersMutex);
+	if (!m_started)
+	{
+		return 0; // Stopping; a late callback must not outlive Stop().
+	}
+	auto id = m_scheduler.Every(period, std::move(fn));
+	m_timers.push_back(id);
+	return id;
+}
+
+Scheduler::TimerId BaseThread::After(std::chrono::milliseconds delay, Scheduler::Callback fn)
+{
+	std::unique_lock lock(m_timersMutex);
+	if (!m_started)
+	{
+		return 0;
+	}
+
+	// Forget one-shots that have run, so a task that keeps rescheduling
+	// doesn't accumulate them.
+	std::erase_if(m_timers, [this](auto id) { return !m_scheduler.Pending(id); });
+
+	auto id = m_scheduler.After(delay, std::move(fn));
+	m_timers.push_back(id);
+	return id;
+}
+
+bool BaseThread::WaitFor_(std::unique_lock<std::mutex>& lock, std::chrono::milliseconds timeout)
+{
+	auto kernel = m_scheduler.Kernel();
+	if (!kernel)
+	{
+		m_cv.wait_for(lock, timeout);
+		return m_running;
+	}
+
+	// The kernel wakes us once its clock has advanced by "timeout".
+	bool due {false};
+	auto event = kernel->After(timeout, [this, &due]() {
+		std::unique_lock lock(m_mutex);
+		due = true;
+		m_cv.notify_all();
+	});
+	m_cv.wait(lock);
+
+	if (!due)
+	{
+		// Not under m_mutex: the event may be waiting for it.
+		lock.unlock();
+		kernel->Cancel(event);
+		lock.lock();
+	}
+	return m_running;
+}
+
 } // namespace ncc
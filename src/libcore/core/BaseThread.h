@@ -1,18 +1,41 @@
 #pragma once
 
+#include <core/Scheduler.h>
+
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <mutex>
 #include <string>
 #include <thread>
+#include <vector>
 
 namespace ncc
 {
 
+// BaseThread is the base of the simulator's tasks.
+//
+// A task does its work in callbacks on a Scheduler: it overrides OnStart_()
+// to register timers with Every() and After(), and handles messages in a
+// Mailbox drained on GetScheduler().Pool(). Stop() cancels the timers and
+// waits for any that are running, then calls OnStop_(). Such a task has no
+// thread of its own.
+//
+// For compatibility, a task that overrides Run_() instead gets a thread of
+// its own running it, as before: Stop() clears m_running, notifies m_cv and
+// joins the thread. It should wait with WaitFor_(), which follows the
+// scheduler's clock; when that is a SimKernel's, the thread keeps to virtual
+// time but isn't deterministic, as it isn't an event of the kernel.
+//
+// NOTE: The constructor and destructor can't call into a subclass (and a
+// thread started by the constructor may run before the subclass is
+// constructed), so a task passes autostart=false here and calls Start() at
+// the end of its own constructor, and calls Stop() in its destructor.
 class BaseThread
 {
 public:
-	explicit BaseThread(const std::string& name, bool autostart = true);
+	// Uses the process-wide scheduler() if "scheduler" is null.
+	explicit BaseThread(const std::string& name, bool autostart = true, Scheduler* scheduler = nullptr);
 	virtual ~BaseThread();
 
 	void Start();
@@ -21,14 +44,40 @@ public:
 	void Run();
 
 protected:
-	virtual void Run_() = 0;
+	// Called by Start(). The default runs Run() on a thread of its own.
+	virtual void OnStart_();
+
+	// Called by Stop() once the task's timers are cancelled.
+	virtual void OnStop_() {}
+
+	// Body of the task's own thread; it must return soon after m_running is
+	// cleared.
+	virtual void Run_() {}
+
+	// Timers cancelled by Stop(). Return 0 (no timer) once Stop() was called.
+	Scheduler::TimerId Every(std::chrono::milliseconds period, Scheduler::Callback fn);
+	Scheduler::TimerId After(std::chrono::milliseconds delay, Scheduler::Callback fn);
+
+	// Waits on m_cv (with "lock" held on m_mutex) for "timeout" of the
+	// scheduler's time, a notification or Stop(). Returns m_running.
+	bool WaitFor_(std::unique_lock<std::mutex>& lock, std::chrono::milliseconds timeout);
+
+	Scheduler& GetScheduler() { return m_scheduler; }
+	const SimClock& GetClock() const { return m_scheduler.GetClock(); }
 
 protected:
 	std::thread m_thread;
 	std::mutex m_mutex;
 	std::condition_variable m_cv;
-	std::atomic_bool m_running;
+	std::atomic_bool m_running {false};
 	const std::string m_name;
+
+private:
+	Scheduler& m_scheduler;
+
+	std::mutex m_timersMutex;
+	std::vector<Scheduler::TimerId> m_timers;
+	bool m_started {false};
 };
 
 } // namespace ncc
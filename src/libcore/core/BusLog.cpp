@@ -0,0 +1,332 @@
+#include <core/BusLog.h>
+#include <core/Logger.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ncc
+{
+
+namespace
+{
+
+constexpr std::uint64_t logMagic {0x31474c5355424d43};   // "CMBUSLG1"
+constexpr std::uint64_t indexMagic {0x3158495355424d43}; // "CMBUSIX1"
+constexpr std::uint32_t version {1};
+
+// Records start here, so they are cache line aligned.
+constexpr std::size_t headerSize {64};
+
+struct FileHeader
+{
+	std::uint64_t magic;
+	std::uint32_t version;
+	std::uint32_t reserved;
+	std::uint64_t indexInterval;
+};
+static_assert(sizeof(FileHeader) <= headerSize);
+
+struct RecordHeader
+{
+	std::uint32_t length; // Whole record, padded; 0 until the record is complete
+	std::uint16_t topicSize;
+	std::uint16_t reserved;
+	std::uint32_t payloadSize;
+	std::uint32_t reserved2;
+	std::int64_t utime;
+};
+static_assert(sizeof(RecordHeader) == 24);
+
+struct IndexEntry
+{
+	std::int64_t utime;
+	std::uint64_t offset; // Plus one; 0 until the entry is written
+};
+
+constexpr std::size_t AlignUp(std::size_t value, std::size_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+// The files are shared with other processes, so their fields are accessed
+// through atomic_ref rather than being std::atomic.
+template <typename T>
+T LoadAcquire(const T& value)
+{
+	return std::atomic_ref<T>(const_cast<T&>(value)).load(std::memory_order_acquire);
+}
+
+template <typename T>
+void StoreRelease(T& value, T desired)
+{
+	std::atomic_ref<T>(value).store(desired, std::memory_order_release);
+}
+
+// Maps "path" read-only. Returns false if it doesn't exist.
+bool MapReadOnly(const std::string& path, int& fd, std::size_t& length, const std::byte*& base)
+{
+	fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		if (errno == ENOENT)
+		{
+			return false;
+		}
+		throw std::system_error(errno, std::generic_category(), "open(\"" + path + "\") failed");
+	}
+
+	struct stat st {};
+	if (fstat(fd, &st) < 0)
+	{
+		int err = errno;
+		close(fd);
+		throw std::system_error(err, std::generic_category(), "fstat(\"" + path + "\") failed");
+	}
+	length = static_cast<std::size_t>(st.st_size);
+	if (length < headerSize)
+	{
+		close(fd);
+		throw std::runtime_error(path + " is not a bus log");
+	}
+
+	void* addr = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+	if (addr == MAP_FAILED)
+	{
+		int err = errno;
+		close(fd);
+		throw std::system_error(err, std::generic_category(), "mmap(\"" + path + "\") failed");
+	}
+	base = static_cast<const std::byte*>(addr);
+	return true;
+}
+
+} // namespace
+
+BusLogWriter::BusLogWriter(const std::string& path, const BusLogConfig& config)
+	: m_config(config)
+{
+	m_log = Create_(path, headerSize + config.capacity);
+	try
+	{
+		m_index = Create_(path + ".idx", headerSize + (config.capacity / config.indexInterval + 1) * sizeof(IndexEntry));
+	}
+	catch (...)
+	{
+		Close_(m_log, headerSize);
+		throw;
+	}
+
+	for (auto [file, magic] : {std::pair {&m_log, logMagic}, std::pair {&m_index, indexMagic}})
+	{
+		auto header = reinterpret_cast<FileHeader*>(file->base);
+		header->version = version;
+		header->indexInterval = config.indexInterval;
+		StoreRelease(header->magic, magic);
+	}
+
+	logger()->debug("BusLogWriter(\"{}\"): capacity={}, indexInterval={}", path, config.capacity, config.indexInterval);
+}
+
+BusLogWriter::~BusLogWriter()
+{
+	auto size = Size();
+	Close_(m_log, headerSize + size);
+	Close_(m_index, headerSize + (size + m_config.indexInterval - 1) / m_config.indexInterval * sizeof(IndexEntry));
+}
+
+bool BusLogWriter::Append(std::int64_t utime, std::string_view topic, std::span<const std::byte> payload)
+{
+	auto length = AlignUp(sizeof(RecordHeader) + topic.size() + payload.size(), alignof(RecordHeader));
+	if (topic.size() > UINT16_MAX || length > UINT32_MAX)
+	{
+		m_dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	// Reserving the space is all the writers contend on.
+	auto offset = m_tail.fetch_add(length, std::memory_order_relaxed);
+	if (offset + length > m_config.capacity)
+	{
+		m_dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	auto record = m_log.base + headerSize + offset;
+	auto header = reinterpret_cast<RecordHeader*>(record);
+	header->topicSize = static_cast<std::uint16_t>(topic.size());
+	header->payloadSize = static_cast<std::uint32_t>(payload.size());
+	header->utime = utime;
+	std::memcpy(record + sizeof(RecordHeader), topic.data(), topic.size());
+	if (!payload.empty())
+	{
+		std::memcpy(record + sizeof(RecordHeader) + topic.size(), payload.data(), payload.size());
+	}
+	StoreRelease(header->length, static_cast<std::uint32_t>(length));
+
+	// Index the record if an index point falls within it.
+	auto entries = reinterpret_cast<IndexEntry*>(m_index.base + headerSize);
+	auto interval = m_config.indexInterval;
+	for (auto k = (offset + interval - 1) / interval; k * interval < offset + length; ++k)
+	{
+		entries[k].utime = utime;
+		StoreRelease(entries[k].offset, offset + 1);
+	}
+
+	m_records.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+std::uint64_t BusLogWriter::Size() const
+{
+	return std::min<std::uint64_t>(m_tail.load(std::memory_order_relaxed), m_config.capacity);
+}
+
+BusLogWriter::File BusLogWriter::Create_(const std::string& path, std::size_t length)
+{
+	File file;
+	file.fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (file.fd < 0)
+	{
+		throw std::system_error(errno, std::generic_category(), "open(\"" + path + "\") failed");
+	}
+
+	// Sparse: blocks are only allocated as records are written.
+	if (ftruncate(file.fd, static_cast<off_t>(length)) < 0)
+	{
+		int err = errno;
+		close(file.fd);
+		throw std::system_error(err, std::generic_category(), "ftruncate(\"" + path + "\") failed");
+	}
+
+	void* base = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, file.fd, 0);
+	if (base == MAP_FAILED)
+	{
+		int err = errno;
+		close(file.fd);
+		throw std::system_error(err, std::generic_category(), "mmap(\"" + path + "\") failed");
+	}
+	file.base = static_cast<std::byte*>(base);
+	file.length = length;
+	return file;
+}
+
+void BusLogWriter::Close_(File& file, std::size_t length)
+{
+	munmap(file.base, file.length);
+	if (ftruncate(file.fd, static_cast<off_t>(std::min(length, file.length))) < 0)
+	{
+		logger()->warn("BusLogWriter::Close_(): ftruncate() failed: errno={}", errno);
+	}
+	close(file.fd);
+	file = {};
+}
+
+BusLogReader::BusLogReader(const std::string& path)
+{
+	if (!MapReadOnly(path, m_fd, m_length, m_base))
+	{
+		throw std::system_error(ENOENT, std::generic_category(), "open(\"" + path + "\") failed");
+	}
+	auto header = reinterpret_cast<const FileHeader*>(m_base);
+	if (LoadAcquire(header->magic) != logMagic || header->version != version)
+	{
+		munmap(const_cast<std::byte*>(m_base), m_length);
+		close(m_fd);
+		throw std::runtime_error(path + " is not a bus log");
+	}
+
+	try
+	{
+		if (MapReadOnly(path + ".idx", m_indexFd, m_indexLength, m_indexBase))
+		{
+			auto indexHeader = reinterpret_cast<const FileHeader*>(m_indexBase);
+			if (LoadAcquire(indexHeader->magic) == indexMagic && indexHeader->version == version)
+			{
+				m_entries = (m_indexLength - headerSize) / sizeof(IndexEntry);
+			}
+		}
+	}
+	catch (const std::exception& e)
+	{
+		logger()->warn("BusLogReader(\"{}\"): ignoring the index: {}", path, e.what());
+	}
+}
+
+BusLogReader::~BusLogReader()
+{
+	munmap(const_cast<std::byte*>(m_base), m_length);
+	close(m_fd);
+	if (m_indexBase)
+	{
+		munmap(const_cast<std::byte*>(m_indexBase), m_indexLength);
+	}
+	if (m_indexFd >= 0)
+	{
+		close(m_indexFd);
+	}
+}
+
+std::optional<BusLogRecord> BusLogReader::Next(std::uint64_t& offset) const
+{
+	auto available = m_length - headerSize;
+	if (offset + sizeof(RecordHeader) > available)
+	{
+		return {};
+	}
+
+	auto record = m_base + headerSize + offset;
+	auto header = reinterpret_cast<const RecordHeader*>(record);
+	auto length = LoadAcquire(header->length);
+	if (length == 0
+		|| offset + length > available
+		|| sizeof(RecordHeader) + header->topicSize + header->payloadSize > length)
+	{
+		return {}; // Not written (yet), or truncated
+	}
+
+	offset += length;
+	auto topic = reinterpret_cast<const char*>(record + sizeof(RecordHeader));
+	return BusLogRecord {
+		.utime = header->utime,
+		.topic = {topic, header->topicSize},
+		.payload = {record + sizeof(RecordHeader) + header->topicSize, header->payloadSize},
+	};
+}
+
+std::uint64_t BusLogReader::Seek(std::int64_t utime) const
+{
+	// Start from the last index point before "utime". Records from several
+	// threads may be slightly out of order, so this is only a starting
+	// point.
+	std::uint64_t offset {Begin()};
+	if (m_entries)
+	{
+		auto entries = reinterpret_cast<const IndexEntry*>(m_indexBase + headerSize);
+		auto end = entries + m_entries;
+		auto it = std::partition_point(entries, end, [utime](const IndexEntry& entry) {
+			return LoadAcquire(entry.offset) != 0 && entry.utime < utime;
+		});
+		if (it != entries)
+		{
+			offset = (it - 1)->offset - 1;
+		}
+	}
+
+	for (auto next = offset; auto record = Next(next); offset = next)
+	{
+		if (record->utime >= utime)
+		{
+			break;
+		}
+	}
+	return offset;
+}
+
+} // namespace ncc
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace ncc
+{
+
+// A bus log records MQTT messages (topic, payload and receive time) in two
+// files:
+//
+// - "<path>": a header followed by the records, back to back and 8-byte
+//   aligned. Each record is a RecordHeader, the topic and the payload.
+// - "<path>.idx": a header followed by one entry every "indexInterval" bytes
+//   of records, holding the time and offset of the record at that point. It
+//   is what makes seeking to a time cheap.
+//
+// Both files are memory mapped at their full capacity (they are sparse until
+// written) and truncated to what was used when the writer closes them. A
+// record's length is written last, so a reader (even one mapping the log
+// while it is being written, or after a crash) stops at the first record
+// that isn't complete.
+
+struct BusLogConfig
+{
+	// Bytes of records the log can hold. Messages that don't fit are
+	// dropped, and counted.
+	std::size_t capacity {std::size_t {1} << 30};
+
+	// Bytes of records per index entry.
+	std::size_t indexInterval {64 * 1024};
+};
+
+struct BusLogRecord
+{
+	std::int64_t utime {0};
+	std::string_view topic;
+	std::span<const std::byte> payload;
+};
+
+// BusLogWriter appends records to a new bus log. Append() is lock free and
+// doesn't allocate, so it can be called from several threads at once,
+// including a dispatch thread.
+class BusLogWriter
+{
+public:
+	// Creates (or truncates) the log. Throws std::system_error on failure.
+	explicit BusLogWriter(const std::string& path, const BusLogConfig& config = {});
+	~BusLogWriter();
+
+	BusLogWriter(const BusLogWriter&) = delete;
+	BusLogWriter& operator=(const BusLogWriter&) = delete;
+
+	// Returns false if the record doesn't fit.
+	bool Append(std::int64_t utime, std::string_view topic, std::span<const std::byte> payload);
+
+	std::uint64_t Records() const { return m_records.load(std::memory_order_relaxed); }
+	std::uint64_t Dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+	// Bytes of records written.
+	std::uint64_t Size() const;
+
+private:
+	struct File
+	{
+		int fd {-1};
+		std::size_t length {0};
+		std::byte* base {nullptr};
+	};
+
+	static File Create_(const std::string& path, std::size_t length);
+	static void Close_(File& file, std::size_t length);
+
+private:
+	const BusLogConfig m_config;
+	File m_log;
+	File m_index;
+
+	std::atomic<std::uint64_t> m_tail {0}; // Next record offset
+	std::atomic<std::uint64_t> m_records {0};
+	std::atomic<std::uint64_t> m_dropped {0};
+};
+
+// BusLogReader reads a bus log, which may still be being written.
+class BusLogReader
+{
+public:
+	// Throws std::system_error if the log can't be opened and
+	// std::runtime_error if it isn't a bus log.
+	explicit BusLogReader(const std::string& path);
+	~BusLogReader();
+
+	BusLogReader(const BusLogReader&) = delete;
+	BusLogReader& operator=(const BusLogReader&) = delete;
+
+	// Offset of the first record.
+	std::uint64_t Begin() const { return 0; }
+
+	// Reads the record at "offset" and advances "offset" to the next one.
+	// Returns nothing at the end of the log. The record's views are valid
+	// for the reader's lifetime.
+	std::optional<BusLogRecord> Next(std::uint64_t& offset) const;
+
+	// Offset of the first record received at or after "utime".
+	std::uint64_t Seek(std::int64_t utime) const;
+
+private:
+	int m_fd {-1};
+	std::size_t m_length {0};
+	const std::byte* m_base {nullptr};
+
+	// The index is optional; without it, Seek() reads from the start.
+	int m_indexFd {-1};
+	std::size_t m_indexLength {0};
+	const std::byte* m_indexBase {nullptr};
+	std::size_t m_entries {0};
+};
+
+} // namespace ncc
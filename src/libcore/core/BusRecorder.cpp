@@ -0,0 +1,108 @@
+#include <core/BusRecorder.h>
+#include <core/Logger.h>
+#include <core/MqttMessage.h>
+#include <core/TopicTrie.h>
+
+#include <chrono>
+#include <thread>
+
+namespace ncc
+{
+
+BusRecorder::BusRecorder(
+		IMqttClient& mqttClient,
+		const std::string& path,
+		const BusRecorderConfig& config,
+		const SimClock& clock)
+	: m_mqtt(mqttClient)
+	, m_clock(clock)
+	, m_log(path, config.log)
+{
+	m_mqtt.RegisterSub(config.topic, this);
+}
+
+BusRecorder::~BusRecorder()
+{
+	// Once unregistered, nothing is appending, and the log can be closed.
+	m_mqtt.UnregisterSub(this);
+
+	if (m_log.Dropped())
+	{
+		logger()->warn("BusRecorder::~BusRecorder(): {} message(s) didn't fit in the log", m_log.Dropped());
+	}
+}
+
+void BusRecorder::OnRawMessage(const MqttMessage& msg)
+{
+	m_log.Append(m_clock.Utime(), msg.Topic(), msg.Payload());
+}
+
+BusReplayer::BusReplayer(IMqttClient& mqttClient, const std::string& path)
+	: m_mqtt(mqttClient)
+	, m_log(path)
+{
+}
+
+ReplayStats BusReplayer::Run(const ReplayConfig& config, const std::atomic_bool& stop)
+{
+	using Clock = std::chrono::steady_clock;
+
+	// Waits in short slices so "stop" is noticed.
+	constexpr auto maxSleep {std::chrono::milliseconds(50)};
+
+	TopicTrie<bool> filter;
+	filter.Insert(config.topic)->values.push_back(true);
+
+	ReplayStats stats;
+	std::string topic; // Reused, so replaying doesn't allocate per message
+	auto start = Clock::now();
+
+	auto offset = m_log.Seek(config.from);
+	while (!stop)
+	{
+		auto record = m_log.Next(offset);
+		if (!record || record->utime > config.to)
+		{
+			break;
+		}
+
+		bool match {false};
+		filter.Match(record->topic, [&match](const auto&) { match = true; });
+		if (!match)
+		{
+			continue;
+		}
+
+		if (!stats.published && !stats.failed)
+		{
+			stats.first = record->utime;
+		}
+		if (config.rate > 0.0)
+		{
+			std::chrono::duration<double, std::micro> elapsed((record->utime - stats.first) / config.rate);
+			auto due = start + std::chrono::duration_cast<Clock::duration>(elapsed);
+			for (auto now = Clock::now(); now < due && !stop; now = Clock::now())
+			{
+				std::this_thread::sleep_for(std::min<Clock::duration>(due - now, maxSleep));
+			}
+			if (stop)
+			{
+				break;
+			}
+		}
+
+		topic.assign(record->topic);
+		if (m_mqtt.Publish(topic, record->payload, config.qos, config.retain))
+		{
+			++stats.published;
+		}
+		else
+		{
+			++stats.failed;
+		}
+		stats.last = record->utime;
+	}
+	return stats;
+}
+
+} // namespace ncc
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <core/BusLog.h>
+#include <core/IMqttClient.h>
+#include <core/IMqttSubscriber.h>
+#include <core/SimClock.h>
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <string>
+
+namespace ncc
+{
+
+struct BusRecorderConfig
+{
+	// Topic filter of the messages to record.
+	std::string topic {"#"};
+
+	BusLogConfig log;
+};
+
+// BusRecorder records every message matching its topic filter, with the time
+// it was received, to a bus log (see BusLog.h), so a field issue can be
+// replayed with BusReplayer.
+//
+// Messages are appended on the dispatch thread: a reservation and two memcpy
+// into the mapped log, without allocating or locking. The log is complete
+// (and truncated to size) once the recorder is destroyed.
+//
+// NOTE: The retain flag isn't known to subscribers, so it isn't recorded.
+class BusRecorder : public IMqttSubscriber
+{
+public:
+	// Receive times come from "clock", so a simulation is recorded in its
+	// virtual time. Throws std::system_error if the log can't be created.
+	BusRecorder(
+		IMqttClient& mqttClient,
+		const std::string& path,
+		const BusRecorderConfig& config = {},
+		const SimClock& clock = realClock());
+	~BusRecorder() override;
+
+	void OnConnect(int rc) override {}
+	void OnDisconnect(int rc) override {}
+	void OnRawMessage(const MqttMessage& msg) override;
+
+	std::uint64_t Recorded() const { return m_log.Records(); }
+	std::uint64_t Dropped() const { return m_log.Dropped(); }
+	std::uint64_t Bytes() const { return m_log.Size(); }
+
+private:
+	IMqttClient& m_mqtt;
+	const SimClock& m_clock;
+	BusLogWriter m_log;
+};
+
+struct ReplayConfig
+{
+	// Speed relative to the recording: 1 keeps the original timing, 10 is ten
+	// times faster. 0 replays as fast as possible.
+	double rate {1.0};
+
+	// Receive times (utime) to replay, inclusive.
+	std::int64_t from {0};
+	std::int64_t to {std::numeric_limits<std::int64_t>::max()};
+
+	// Only messages matching this topic filter are replayed.
+	std::string topic {"#"};
+
+	int qos {0};
+	bool retain {false};
+};
+
+struct ReplayStats
+{
+	std::uint64_t published {0};
+	std::uint64_t failed {0};
+
+	// Receive times of the first and last message replayed.
+	std::int64_t first {0};
+	std::int64_t last {0};
+};
+
+// BusReplayer republishes the messages of a bus log through an IMqttClient,
+// keeping their original spacing divided by ReplayConfig::rate.
+class BusReplayer
+{
+public:
+	// Throws like BusLogReader.
+	BusReplayer(IMqttClient& mqttClient, const std::string& path);
+
+	// Replays the log, or part of it. Blocks until done or "stop" is set.
+	ReplayStats Run(const ReplayConfig& config, const std::atomic_bool& stop);
+
+private:
+	IMqttClient& m_mqtt;
+	BusLogReader m_log;
+};
+
+} // namespace ncc
@@ -0,0 +1,242 @@
+#include <core/CoBus.h>
+
+#include <stdexcept>
+
+namespace ncc
+{
+
+CoBus::CoBus(CoExecutor& executor, IMqttClient& mqttClient, std::size_t capacity)
+	: m_executor(executor)
+	, m_mqtt(mqttClient)
+	, m_capacity(capacity)
+{
+}
+
+CoBus::~CoBus()
+{
+	for (auto& [filter, inbox] : m_inboxes)
+	{
+		m_mqtt.UnregisterSub(inbox.get());
+	}
+}
+
+void CoBus::Subscribe(const std::string& filter, bool replay)
+{
+	Inbox_(filter, replay);
+}
+
+CoBus::NextAwaiter CoBus::Next(const std::string& filter)
+{
+	return NextAwaiter(Inbox_(filter));
+}
+
+CoBus::NextForAwaiter CoBus::Next(const std::string& filter, std::chrono::milliseconds timeout)
+{
+	return NextForAwaiter(Inbox_(filter), timeout);
+}
+
+CoBus::NextForAwaiter CoBus::Request(
+	const std::string& topic,
+	std::span<const std::byte> payload,
+	const std::string& replyFilter,
+	std::chrono::milliseconds timeout)
+{
+	// Subscribe before publishing, so a quick reply isn't missed.
+	auto& inbox = Inbox_(replyFilter);
+	inbox.Clear();
+	m_mqtt.Publish(topic, payload);
+	return NextForAwaiter(inbox, timeout);
+}
+
+CoBus::NextForAwaiter CoBus::Request(
+	const std::string& topic,
+	const nlohmann::json& json,
+	const std::string& replyFilter,
+	std::chrono::milliseconds timeout)
+{
+	auto& inbox = Inbox_(replyFilter);
+	inbox.Clear();
+	m_mqtt.Publish(topic, json);
+	return NextForAwaiter(inbox, timeout);
+}
+
+std::uint64_t CoBus::Dropped() const
+{
+	std::unique_lock lock(m_mutex);
+	std::uint64_t dropped {0};
+	for (const auto& [filter, inbox] : m_inboxes)
+	{
+		dropped += inbox->Dropped();
+	}
+	return dropped;
+}
+
+CoBus::Inbox& CoBus::Inbox_(const std::string& filter, bool replay)
+{
+	std::unique_lock lock(m_mutex);
+	auto& inbox = m_inboxes[filter];
+	if (!inbox)
+	{
+		inbox = std::make_unique<Inbox>(m_executor, filter, m_capacity);
+		m_mqtt.RegisterSub(filter, inbox.get(), replay);
+	}
+	return *inbox;
+}
+
+CoBus::Inbox::Inbox(CoExecutor& executor, const std::string& filter, std::size_t capacity)
+	: m_executor(executor)
+	, m_filter(filter)
+	, m_capacity(capacity ? capacity : 1)
+{
+}
+
+void CoBus::Inbox::OnRawMessage(const MqttMessage& msg)
+{
+	BusMessage message {
+		std::string(msg.Topic()),
+		std::vector<std::byte>(msg.Payload().begin(), msg.Payload().end()),
+	};
+
+	std::unique_lock lock(m_mutex);
+	auto waiter = std::exchange(m_waiter, {});
+	if (waiter.id)
+	{
+		// Handed over rather than queued, so no Next() on another coroutine
+		// can take it before the waiter runs.
+		*waiter.slot = std::move(message);
+		lock.unlock();
+		m_executor.Resume(waiter.id, waiter.token);
+		return;
+	}
+
+	if (m_queue.size() == m_capacity)
+	{
+		m_queue.pop_front();
+		m_dropped.fetch_add(1, std::memory_order_relaxed);
+	}
+	m_queue.push_back(std::move(message));
+}
+
+std::optional<BusMessage> CoBus::Inbox::Pop()
+{
+	std::unique_lock lock(m_mutex);
+	if (m_queue.empty())
+	{
+		return {};
+	}
+	auto msg = std::move(m_queue.front());
+	m_queue.pop_front();
+	return msg;
+}
+
+void CoBus::Inbox::Clear()
+{
+	std::unique_lock lock(m_mutex);
+	m_queue.clear();
+}
+
+bool CoBus::Inbox::Wait(std::uint64_t id, std::uint64_t token, std::optional<BusMessage>* slot)
+{
+	std::unique_lock lock(m_mutex);
+	if (!m_queue.empty())
+	{
+		return false;
+	}
+	if (m_waiter.id && m_waiter.id != id)
+	{
+		throw std::logic_error("CoBus: another coroutine is already waiting for \"" + m_filter + "\"");
+	}
+	m_waiter = {id, token, slot};
+	return true;
+}
+
+void CoBus::Inbox::Forget(std::uint64_t id)
+{
+	std::unique_lock lock(m_mutex);
+	if (m_waiter.id == id)
+	{
+		m_waiter = {};
+	}
+}
+
+CoBus::NextAwaiter::~NextAwaiter()
+{
+	// Only set while suspended, i.e. when the coroutine is destroyed by
+	// CoExecutor::Stop().
+	if (m_id)
+	{
+		m_inbox.Forget(m_id);
+	}
+}
+
+bool CoBus::NextAwaiter::await_suspend(CoTask::Handle handle)
+{
+	auto& promise = handle.promise();
+	m_token = promise.executor->Suspend(handle);
+	if (!m_inbox.Wait(promise.id, m_token, &m_msg))
+	{
+		return false; // A message arrived since await_ready()
+	}
+	m_id = promise.id;
+	return true;
+}
+
+BusMessage CoBus::NextAwaiter::await_resume()
+{
+	m_id = 0;
+	if (!m_msg)
+	{
+		m_msg = m_inbox.Pop();
+	}
+	// Only a message resumes this awaiter, and it is either handed over or
+	// still queued, since no other coroutine waits on this inbox.
+	if (!m_msg)
+	{
+		throw std::logic_error("CoBus: Next() resumed without a message");
+	}
+	return std::move(*m_msg);
+}
+
+CoBus::NextForAwaiter::~NextForAwaiter()
+{
+	if (m_timer)
+	{
+		m_executor->GetScheduler().Cancel(m_timer);
+	}
+}
+
+bool CoBus::NextForAwaiter::await_suspend(CoTask::Handle handle)
+{
+	if (!NextAwaiter::await_suspend(handle))
+	{
+		return false;
+	}
+
+	// Whichever of the message and the timeout comes first resumes the
+	// coroutine; the other's wakeup is stale by then and ignored.
+	m_executor = handle.promise().executor;
+	m_timer = m_executor->GetScheduler().After(m_timeout, [executor = m_executor, id = m_id, token = m_token]() {
+		executor->Resume(id, token);
+	});
+	return true;
+}
+
+std::optional<BusMessage> CoBus::NextForAwaiter::await_resume()
+{
+	if (m_timer)
+	{
+		m_executor->GetScheduler().Cancel(std::exchange(m_timer, 0));
+	}
+	// A message handed over before this is in m_msg.
+	if (m_id)
+	{
+		m_inbox.Forget(std::exchange(m_id, 0));
+	}
+	if (!m_msg)
+	{
+		m_msg = m_inbox.Pop();
+	}
+	return std::move(m_msg);
+}
+
+} // namespace ncc
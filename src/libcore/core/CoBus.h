@@ -0,0 +1,197 @@
+#pragma once
+
+#include <core/Coroutine.h>
+#include <core/IMqttClient.h>
+#include <core/IMqttSubscriber.h>
+#include <core/ZcmMessage.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace ncc
+{
+
+// A message received by a CoBus. Unlike MqttMessage it owns its topic and
+// payload, so it can be kept across a co_await.
+struct BusMessage
+{
+	std::string topic;
+	std::vector<std::byte> payload;
+
+	std::string_view PayloadString() const
+	{
+		return {reinterpret_cast<const char*>(payload.data()), payload.size()};
+	}
+
+	// Returns a discarded value (see is_discarded()) if the payload isn't
+	// valid JSON.
+	nlohmann::json Json() const
+	{
+		return nlohmann::json::parse(PayloadString(), nullptr, false);
+	}
+
+	template <ZcmMessage T>
+	bool Decode(T& msg) const
+	{
+		return ZcmDecode(payload, msg);
+	}
+};
+
+// CoBus lets coroutines on a CoExecutor wait for MQTT messages as straight
+// line code:
+//
+//    auto msg = co_await m_bus.Next("/heater/#");
+//    auto reply = co_await m_bus.Request("/lens/zoom", json, "/lens/zoom/reply", 2s);
+//
+// Each topic filter gets a bounded inbox the first time it is used (or
+// Subscribe() is called), and keeps it, so messages that arrive while the
+// coroutine is busy are queued for its next Next() rather than lost. When an
+// inbox is full the oldest message is dropped.
+//
+// Messages are copied into the inbox on the dispatching thread, or straight
+// to the coroutine waiting for one, which is then resumed on its executor.
+// Only one coroutine may wait on a filter at a time; Next() throws
+// std::logic_error in a second one (which ends it, see CoTask). Stop the
+// executor before the bus is destroyed.
+class CoBus
+{
+public:
+	class NextAwaiter;
+	class NextForAwaiter;
+
+	CoBus(CoExecutor& executor, IMqttClient& mqttClient, std::size_t capacity = 16);
+	~CoBus();
+
+	CoBus(const CoBus&) = delete;
+	CoBus& operator=(const CoBus&) = delete;
+
+	// Subscribes to "filter" now, so messages are queued before Next() is
+	// first awaited. With "replay", the client's cached retained messages are
+	// queued as well.
+	void Subscribe(const std::string& filter, bool replay = false);
+
+	// Waits for the next message matching "filter".
+	NextAwaiter Next(const std::string& filter);
+
+	// Waits at most "timeout"; the result is empty if nothing arrived.
+	NextForAwaiter Next(const std::string& filter, std::chrono::milliseconds timeout);
+
+	// Publishes a request and waits at most "timeout" for the first message
+	// matching "replyFilter". Replies queued before the request are dropped.
+	NextForAwaiter Request(
+		const std::string& topic,
+		std::span<const std::byte> payload,
+		const std::string& replyFilter,
+		std::chrono::milliseconds timeout);
+	NextForAwaiter Request(
+		const std::string& topic,
+		const nlohmann::json& json,
+		const std::string& replyFilter,
+		std::chrono::milliseconds timeout);
+
+	// Messages dropped because an inbox was full.
+	std::uint64_t Dropped() const;
+
+private:
+	class Inbox;
+
+	Inbox& Inbox_(const std::string& filter, bool replay = false);
+
+private:
+	CoExecutor& m_executor;
+	IMqttClient& m_mqtt;
+	const std::size_t m_capacity;
+
+	mutable std::mutex m_mutex;
+	std::map<std::string, std::unique_ptr<Inbox>> m_inboxes;
+};
+
+class CoBus::Inbox : public IMqttSubscriber
+{
+public:
+	Inbox(CoExecutor& executor, const std::string& filter, std::size_t capacity);
+
+	void OnConnect(int rc) override {}
+	void OnDisconnect(int rc) override {}
+	void OnRawMessage(const MqttMessage& msg) override;
+
+	std::optional<BusMessage> Pop();
+	void Clear();
+
+	// Registers the coroutine to be resumed by the next message, which is
+	// stored in "slot" rather than queued. Returns false (and registers
+	// nothing) if a message is already queued. Throws std::logic_error if
+	// another coroutine is waiting.
+	bool Wait(std::uint64_t id, std::uint64_t token, std::optional<BusMessage>* slot);
+	void Forget(std::uint64_t id);
+
+	std::uint64_t Dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+private:
+	struct Waiter
+	{
+		std::uint64_t id {0};
+		std::uint64_t token {0};
+		std::optional<BusMessage>* slot {nullptr};
+	};
+
+	CoExecutor& m_executor;
+	const std::string m_filter;
+	const std::size_t m_capacity;
+
+	std::mutex m_mutex;
+	std::deque<BusMessage> m_queue;
+	Waiter m_waiter;
+	std::atomic<std::uint64_t> m_dropped {0};
+};
+
+class CoBus::NextAwaiter
+{
+public:
+	explicit NextAwaiter(Inbox& inbox) : m_inbox(inbox) {}
+	~NextAwaiter();
+
+	bool await_ready() { return (m_msg = m_inbox.Pop()).has_value(); }
+	bool await_suspend(CoTask::Handle handle);
+	BusMessage await_resume();
+
+protected:
+	Inbox& m_inbox;
+	std::optional<BusMessage> m_msg;
+	std::uint64_t m_id {0}; // Set while waiting
+	std::uint64_t m_token {0};
+};
+
+class CoBus::NextForAwaiter : public NextAwaiter
+{
+public:
+	NextForAwaiter(Inbox& inbox, std::chrono::milliseconds timeout)
+		: NextAwaiter(inbox)
+		, m_timeout(timeout)
+	{
+	}
+	~NextForAwaiter();
+
+	bool await_suspend(CoTask::Handle handle);
+	std::optional<BusMessage> await_resume();
+
+private:
+	std::chrono::milliseconds m_timeout;
+	CoExecutor* m_executor {nullptr};
+	Scheduler::TimerId m_timer {0};
+};
+
+} // namespace ncc
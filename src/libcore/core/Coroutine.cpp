@@ -0,0 +1,218 @@
+#include <core/Coroutine.h>
+#include <core/Logger.h>
+
+#include <exception>
+
+namespace ncc
+{
+
+namespace
+{
+
+// Wakeups handled per pool task before the executor yields the thread to
+// other executors.
+constexpr std::size_t poolBatchSize {64};
+
+} // namespace
+
+CoTask::promise_type::~promise_type()
+{
+	if (executor)
+	{
+		executor->Forget_(id);
+	}
+}
+
+void CoTask::promise_type::unhandled_exception()
+{
+	try
+	{
+		std::rethrow_exception(std::current_exception());
+	}
+	catch (const std::exception& e)
+	{
+		logger()->error("CoTask: {}: coroutine threw: {}", executor ? executor->Name() : "", e.what());
+	}
+	catch (...)
+	{
+		logger()->error("CoTask: {}: coroutine threw", executor ? executor->Name() : "");
+	}
+}
+
+CoExecutor::CoExecutor(const std::string& name, Scheduler* scheduler)
+	: m_name(name)
+	, m_scheduler(scheduler ? *scheduler : ncc::scheduler())
+{
+}
+
+CoExecutor::~CoExecutor()
+{
+	Stop();
+
+	// Wakeups may still be queued; they refer to this executor.
+	std::unique_lock lock(m_mutex);
+	m_idle.wait(lock, [this]() { return !m_active; });
+}
+
+void CoExecutor::Spawn(CoTask task)
+{
+	auto handle = task.Release();
+	Post_([this, handle]() {
+		auto id = m_nextId++;
+		handle.promise().executor = this;
+		handle.promise().id = id;
+		m_frames.emplace(id, handle);
+		handle.resume();
+	});
+}
+
+void CoExecutor::Stop()
+{
+	{
+		std::unique_lock lock(m_mutex);
+		if (!m_active)
+		{
+			// Idle: take the strand and destroy the frames here. Besides being
+			// cheaper, this doesn't depend on the pool, which may never run
+			// (i.e. a simulation's kernel that wasn't started yet).
+			m_active = true;
+			lock.unlock();
+			DestroyFrames_();
+			lock.lock();
+			if (m_queue.empty())
+			{
+				m_active = false;
+				m_idle.notify_all();
+			}
+			else
+			{
+				// Posted to meanwhile.
+				lock.unlock();
+				m_scheduler.Post([this]() { Drain_(); });
+			}
+			return;
+		}
+	}
+
+	bool done {false};
+	Post_([this, &done]() {
+		DestroyFrames_();
+
+		std::unique_lock lock(m_mutex);
+		done = true;
+		m_idle.notify_all();
+	});
+
+	std::unique_lock lock(m_mutex);
+	m_idle.wait(lock, [&done]() { return done; });
+}
+
+CoExecutor::SleepAwaiter CoExecutor::Sleep(std::chrono::milliseconds duration)
+{
+	return SleepAwaiter(*this, duration);
+}
+
+std::uint64_t CoExecutor::Suspend(CoTask::Handle handle)
+{
+	return ++handle.promise().token;
+}
+
+void CoExecutor::Resume(std::uint64_t id, std::uint64_t token)
+{
+	Post_([this, id, token]() {
+		auto it = m_frames.find(id);
+		if (it == m_frames.end())
+		{
+			return; // Finished or stopped
+		}
+		auto handle = it->second;
+		if (handle.promise().token != token)
+		{
+			return; // Already woken by something else
+		}
+		++handle.promise().token;
+		handle.resume();
+	});
+}
+
+void CoExecutor::Post_(InplaceFunction<void()> fn)
+{
+	std::unique_lock lock(m_mutex);
+	m_queue.push_back(std::move(fn));
+	if (m_active)
+	{
+		return;
+	}
+	m_active = true;
+	lock.unlock();
+
+	m_scheduler.Post([this]() { Drain_(); });
+}
+
+void CoExecutor::Drain_()
+{
+	for (std::size_t count = 0; ; ++count)
+	{
+		InplaceFunction<void()> fn;
+		{
+			std::unique_lock lock(m_mutex);
+			if (m_queue.empty())
+			{
+				m_active = false;
+				m_idle.notify_all();
+				return;
+			}
+			if (count == poolBatchSize)
+			{
+				// Still active; continue in a new pool task.
+				lock.unlock();
+				m_scheduler.Post([this]() { Drain_(); });
+				return;
+			}
+			fn = std::move(m_queue.front());
+			m_queue.pop_front();
+		}
+		fn();
+	}
+}
+
+void CoExecutor::Forget_(std::uint64_t id)
+{
+	m_frames.erase(id);
+}
+
+void CoExecutor::DestroyFrames_()
+{
+	// Destroying a frame erases it from m_frames (see Forget_()), so take
+	// them all first.
+	auto frames = std::move(m_frames);
+	m_frames.clear();
+	for (auto& [id, handle] : frames)
+	{
+		handle.promise().executor = nullptr;
+		handle.destroy();
+	}
+}
+
+CoExecutor::SleepAwaiter::~SleepAwaiter()
+{
+	// Only set while suspended, i.e. when the coroutine is destroyed by Stop().
+	if (m_timer)
+	{
+		m_executor.GetScheduler().Cancel(m_timer);
+	}
+}
+
+void CoExecutor::SleepAwaiter::await_suspend(CoTask::Handle handle)
+{
+	auto id = handle.promise().id;
+	auto token = m_executor.Suspend(handle);
+
+	// The wakeup can't run before this returns, since it is posted to the
+	// executor that is running this coroutine.
+	m_timer = m_executor.GetScheduler().After(m_duration, [&executor = m_executor, id, token]() {
+		executor.Resume(id, token);
+	});
+}
+
+} // namespace ncc
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <core/InplaceFunction.h>
+#include <core/Scheduler.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+
+namespace ncc
+{
+
+class CoExecutor;
+
+// CoTask is the return type of a coroutine run by a CoExecutor:
+//
+//    CoTask Loop_()
+//    {
+//        for (;;)
+//        {
+//            auto msg = co_await m_bus.Next("/heater/#");
+//            ...
+//            co_await m_executor.Sleep(1s);
+//        }
+//    }
+//
+//    m_executor.Spawn(Loop_());
+//
+// It starts running once spawned. It can't be awaited and doesn't return a
+// value.
+class CoTask
+{
+public:
+	struct promise_type
+	{
+		CoExecutor* executor {nullptr};
+		std::uint64_t id {0};
+
+		// Incremented whenever the coroutine is suspended or resumed, so a
+		// stale wakeup (i.e. a timeout after the message arrived) is ignored.
+		std::uint64_t token {0};
+
+		~promise_type();
+
+		CoTask get_return_object() { return CoTask(Handle::from_promise(*this)); }
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception();
+	};
+	using Handle = std::coroutine_handle<promise_type>;
+
+	CoTask(CoTask&& other) noexcept : m_handle(std::exchange(other.m_handle, {})) {}
+	CoTask(const CoTask&) = delete;
+	CoTask& operator=(const CoTask&) = delete;
+	CoTask& operator=(CoTask&&) = delete;
+
+	// Destroys the coroutine if it was never spawned.
+	~CoTask()
+	{
+		if (m_handle)
+		{
+			m_handle.destroy();
+		}
+	}
+
+private:
+	friend class CoExecutor;
+
+	explicit CoTask(Handle handle) : m_handle(handle) {}
+	Handle Release() { return std::exchange(m_handle, {}); }
+
+	Handle m_handle;
+};
+
+// CoExecutor runs coroutines one at a time, in the order they were woken, on
+// a Scheduler's pool. Coroutines spawned on the same executor never run
+// concurrently, so the state they share needs no locking, and a suspended
+// coroutine costs its frame (a few hundred bytes) rather than a thread.
+//
+// Coroutines are woken by awaitables such as Sleep() and CoBus::Next(); each
+// wakeup is posted to the executor, so it doesn't matter which thread it
+// comes from.
+//
+// Stop() destroys every coroutine that hasn't finished at the co_await it is
+// suspended in, which releases its locals and cancels what it was waiting
+// for. The owner must call Stop() before destroying anything the coroutines
+// refer to, such as a CoBus.
+class CoExecutor
+{
+public:
+	class SleepAwaiter;
+
+	// Uses the process-wide scheduler() if "scheduler" is null.
+	explicit CoExecutor(const std::string& name, Scheduler* scheduler = nullptr);
+	~CoExecutor();
+
+	CoExecutor(const CoExecutor&) = delete;
+	CoExecutor& operator=(const CoExecutor&) = delete;
+
+	// Starts "task" on the executor.
+	void Spawn(CoTask task);
+
+	// Destroys the suspended coroutines and waits until that is done. Tasks
+	// spawned afterwards run as usual, so a task can be restarted. Must not be
+	// called from one of the executor's coroutines. If the executor is idle,
+	// this is done on the calling thread without waiting for the pool.
+	void Stop();
+
+	// co_await executor.Sleep(1s);
+	SleepAwaiter Sleep(std::chrono::milliseconds duration);
+
+	// For awaitables: Suspend() marks the coroutine as waiting and returns
+	// the token to pass to Resume(), which can be called from any thread.
+	std::uint64_t Suspend(CoTask::Handle handle);
+	void Resume(std::uint64_t id, std::uint64_t token);
+
+	Scheduler& GetScheduler() { return m_scheduler; }
+	const std::string& Name() const { return m_name; }
+
+private:
+	friend struct CoTask::promise_type;
+
+	void Post_(InplaceFunction<void()> fn);
+	void Drain_();
+	void Forget_(std::uint64_t id);
+	void DestroyFrames_();
+
+private:
+	const std::string m_name;
+	Scheduler& m_scheduler;
+
+	std::mutex m_mutex;
+	std::condition_variable m_idle;
+	std::deque<InplaceFunction<void()>> m_queue;
+	bool m_active {false}; // A pool task is draining m_queue
+
+	// Only touched by the functions posted to the executor.
+	std::map<std::uint64_t, CoTask::Handle> m_frames;
+	std::uint64_t m_nextId {1};
+};
+
+class CoExecutor::SleepAwaiter
+{
+public:
+	SleepAwaiter(CoExecutor& executor, std::chrono::milliseconds duration)
+		: m_executor(executor)
+		, m_duration(duration)
+	{
+	}
+	~SleepAwaiter();
+
+	bool await_ready() const noexcept { return m_duration <= std::chrono::milliseconds::zero(); }
+	void await_suspend(CoTask::Handle handle);
+	void await_resume() noexcept { m_timer = 0; }
+
+private:
+	CoExecutor& m_executor;
+	std::chrono::milliseconds m_duration;
+	Scheduler::TimerId m_timer {0};
+};
+
+} // namespace ncc
@@ -0,0 +1,61 @@
+#include <core/Histogram.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace ncc
+{
+
+std::uint64_t Histogram::Percentile(double quantile) const
+{
+	auto count = Count();
+	if (count == 0)
+	{
+		return 0;
+	}
+
+	quantile = std::clamp(quantile, 0.0, 1.0);
+	auto rank = static_cast<std::uint64_t>(std::ceil(quantile * static_cast<double>(count)));
+	rank = std::max<std::uint64_t>(rank, 1);
+
+	std::uint64_t seen {0};
+	for (std::size_t i = 0; i < bucketCount; ++i)
+	{
+		seen += m_buckets[i].load(std::memory_order_relaxed);
+		if (seen >= rank)
+		{
+			// The bucket's bound may be past the largest value recorded.
+			return std::min(BucketUpperBound(i), Max());
+		}
+	}
+	return Max();
+}
+
+HistogramSummary Histogram::Summary() const
+{
+	HistogramSummary summary;
+	summary.count = Count();
+	if (summary.count > 0)
+	{
+		summary.mean = m_sum.load(std::memory_order_relaxed) / summary.count;
+	}
+	summary.p50 = Percentile(0.50);
+	summary.p90 = Percentile(0.90);
+	summary.p99 = Percentile(0.99);
+	summary.p999 = Percentile(0.999);
+	summary.max = Max();
+	return summary;
+}
+
+void Histogram::Reset()
+{
+	for (auto& bucket : m_buckets)
+	{
+		bucket.store(0, std::memory_order_relaxed);
+	}
+	m_count.store(0, std::memory_order_relaxed);
+	m_sum.store(0, std::memory_order_relaxed);
+	m_max.store(0, std::memory_order_relaxed);
+}
+
+} // namespace ncc
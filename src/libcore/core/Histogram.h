@@ -0,0 +1,105 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace ncc
+{
+
+struct HistogramSummary
+{
+	std::uint64_t count {0};
+	std::uint64_t mean {0};
+	std::uint64_t p50 {0};
+	std::uint64_t p90 {0};
+	std::uint64_t p99 {0};
+	std::uint64_t p999 {0};
+	std::uint64_t max {0};
+};
+
+// Histogram counts values (typically latencies in nanoseconds) in log-linear
+// buckets: every power of two is split into 16 linear sub-buckets, so a
+// percentile is reported within ~6% of the real value while the whole range
+// of std::uint64_t fits in under 1000 counters.
+//
+// Record() is a few relaxed atomic increments and never allocates or locks,
+// so it can be called from any thread, including the network thread. Reads
+// are not a consistent snapshot while values are being recorded, which is
+// fine for monitoring.
+class Histogram
+{
+public:
+	static constexpr unsigned subBucketBits {4};
+	static constexpr std::size_t subBuckets {std::size_t{1} << subBucketBits};
+	static constexpr std::size_t bucketCount {(64 - subBucketBits + 1) * subBuckets};
+
+	Histogram() = default;
+
+	Histogram(const Histogram&) = delete;
+	Histogram& operator=(const Histogram&) = delete;
+
+	void Record(std::uint64_t value)
+	{
+		m_buckets[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+		m_count.fetch_add(1, std::memory_order_relaxed);
+		m_sum.fetch_add(value, std::memory_order_relaxed);
+
+		auto max = m_max.load(std::memory_order_relaxed);
+		while (value > max && !m_max.compare_exchange_weak(max, value, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	template <typename Rep, typename Period>
+	void Record(std::chrono::duration<Rep, Period> duration)
+	{
+		auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+		Record(static_cast<std::uint64_t>(ns > 0 ? ns : 0));
+	}
+
+	std::uint64_t Count() const { return m_count.load(std::memory_order_relaxed); }
+	std::uint64_t Max() const { return m_max.load(std::memory_order_relaxed); }
+	std::uint64_t Sum() const { return m_sum.load(std::memory_order_relaxed); }
+
+	// Returns the value below which "quantile" (0.0 - 1.0) of the recorded
+	// values fall, rounded up to the end of its bucket. Zero if empty.
+	std::uint64_t Percentile(double quantile) const;
+
+	HistogramSummary Summary() const;
+
+	void Reset();
+
+	static constexpr std::size_t BucketIndex(std::uint64_t value)
+	{
+		if (value < subBuckets)
+		{
+			return static_cast<std::size_t>(value);
+		}
+		unsigned shift = static_cast<unsigned>(std::bit_width(value)) - 1 - subBucketBits;
+		return (shift + 1) * subBuckets + static_cast<std::size_t>((value >> shift) - subBuckets);
+	}
+
+	// Largest value that falls in bucket "index".
+	static constexpr std::uint64_t BucketUpperBound(std::size_t index)
+	{
+		if (index < subBuckets)
+		{
+			return index;
+		}
+		unsigned shift = static_cast<unsigned>(index / subBuckets) - 1;
+		std::uint64_t mantissa = index % subBuckets + subBuckets;
+		return ((mantissa + 1) << shift) - 1;
+	}
+
+private:
+	std::array<std::atomic<std::uint64_t>, bucketCount> m_buckets {};
+	std::atomic<std::uint64_t> m_count {0};
+	std::atomic<std::uint64_t> m_sum {0};
+	std::atomic<std::uint64_t> m_max {0};
+};
+
+} // namespace ncc
@@ -1,10 +1,24 @@
 #pragma once
 
 #include <core/IMqttSubscriber.h>
+#include <core/InplaceFunction.h>
+#include <core/LatencyMonitor.h>
+#include <core/Logger.h>
+#include <core/Mailbox.h>
+#include <core/Outbox.h>
+#include <core/PublishTracker.h>
+#include <core/ZcmMessage.h>
 
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
 #include <ratio>
+#include <span>
 #include <string>
+#include <string_view>
+#include <vector>
 
 #include <nlohmann/json_fwd.hpp>
 
@@ -13,13 +27,41 @@ using namespace std::chrono_literals;
 namespace ncc
 {
 
+template <ZcmMessage T>
+class TypedSubscriber;
+
+struct ConnectionStats
+{
+	bool connected {false};
+	std::uint64_t connects {0};
+	std::uint64_t disconnects {0};
+	std::uint64_t reconnectAttempts {0};
+
+	// From losing the connection (or starting) until the broker accepted the
+	// new connection.
+	std::chrono::microseconds lastTimeToReconnect {0};
+	std::chrono::microseconds maxTimeToReconnect {0};
+
+	// From losing the connection (or starting) until the first message was
+	// received again, i.e. how long subscribers were deaf.
+	std::chrono::microseconds lastTimeToFirstMessage {0};
+};
+
 class IMqttClient
 {
 public:
 	virtual ~IMqttClient() = default;
 
 	// TODO: Add support for std::function
-	virtual void RegisterSub(const std::string& topic, IMqttSubscriber* sub) = 0;
+	// With "replay", the last cached message of every topic matching "topic"
+	// is delivered to "sub" right away, so it learns the current state
+	// without waiting for the next publish. Newer messages are delivered
+	// after it, though the newest may arrive twice. Which topics are cached
+	// depends on the client (see CacheConfig).
+	virtual void RegisterSub(const std::string& topic, IMqttSubscriber* sub, bool replay = false) = 0;
+	// Once this returns, "sub" isn't called again and may be destroyed,
+	// unless it is called from a subscriber's callback: messages other
+	// threads are already delivering may then still reach "sub".
 	virtual void UnregisterSub(IMqttSubscriber* sub) = 0;
 	virtual bool IsConnected() const = 0;
 
@@ -30,7 +72,161 @@ public:
 		bool retain = false,
 		const std::chrono::duration<long, std::ratio<1, 1>>& delay = 5s) = 0;
 
+	// Publishes a preformatted payload as-is.
+	virtual bool Publish(
+		const std::string& topic,
+		std::span<const std::byte> payload,
+		int qos = 0,
+		bool retain = false,
+		const std::chrono::duration<long, std::ratio<1, 1>>& delay = 5s) = 0;
+
+	// Same as Publish(), but returns a token that completes once the broker
+	// acknowledged the message. Tracked messages are never queued in the
+	// outbox: the token is invalid if the client isn't connected or too many
+	// tracked messages are already in flight.
+	virtual PublishToken PublishTracked(
+		const std::string& topic,
+		std::span<const std::byte> payload,
+		int qos = 1,
+		bool retain = false) = 0;
+
+	// In-flight window and broker ack latency of tracked publishes.
+	virtual PublishStats GetPublishStats() const = 0;
+
 	virtual bool IsTopicMatch(const std::string& sub, const std::string& topic) = 0;
+
+	// Queue depth and drop counters of the asynchronous publish outbox. All
+	// zero when the outbox is disabled.
+	virtual OutboxStats GetOutboxStats() const = 0;
+
+	// Reconnect counters and timings.
+	virtual ConnectionStats GetConnectionStats() const = 0;
+
+	// Per topic publish-to-dispatch and publish-to-handled latencies. Empty
+	// unless LatencyConfig::enabled.
+	virtual std::map<std::string, LatencyStats> GetLatencyStats() const = 0;
+	virtual void ResetLatencyStats() = 0;
+
+	// Copies the last payload seen on "topic" (published by this client or
+	// received from the broker) into "payload". Returns false if there is
+	// none or the topic isn't cached.
+	virtual bool GetLatest(const std::string& topic, std::vector<std::byte>& payload) const = 0;
+
+	// Decodes the last message seen on "topic" into "msg".
+	template <ZcmMessage T>
+	bool GetLatest(const std::string& topic, T& msg) const
+	{
+		auto& buffer = ZcmScratchBuffer();
+		return GetLatest(topic, buffer) && ZcmDecode(buffer, msg);
+	}
+
+	// Publishes a ZCM message using its binary encoding. The message is
+	// encoded into a per-thread buffer, so this doesn't allocate.
+	template <ZcmMessage T>
+	bool Publish(const std::string& topic, const T& msg, int qos = 0, bool retain = false)
+	{
+		auto payload = ZcmEncode(msg);
+		if (payload.empty())
+		{
+			logger()->error("IMqttClient::Publish(topic=\"{}\"): failed to encode {}", topic, T::getTypeName());
+			return false;
+		}
+		return Publish(topic, payload, qos, retain);
+	}
+
+	// Subscribes "handler" to ZCM messages of type T published on "topic".
+	// The subscription lasts until the returned object is destroyed.
+	// See RegisterSub() for "replay".
+	template <ZcmMessage T>
+	std::unique_ptr<TypedSubscriber<T>> Subscribe(
+		const std::string& topic,
+		typename TypedSubscriber<T>::Handler handler,
+		bool replay = false);
+
+	// Same as above, but the handler runs wherever "mailbox" is drained
+	// instead of on the network thread.
+	template <ZcmMessage T>
+	std::unique_ptr<TypedSubscriber<T>> Subscribe(
+		const std::string& topic,
+		typename TypedSubscriber<T>::Handler handler,
+		MailboxConfig mailbox,
+		bool replay = false);
 };
 
+// TypedSubscriber decodes each message into a member T that is reused for
+// every message, then passes it to the handler. Payloads that don't decode as
+// T (wrong type or truncated) are dropped.
+template <ZcmMessage T>
+class TypedSubscriber : public IMqttSubscriber
+{
+public:
+	using Handler = InplaceFunction<void(std::string_view topic, const T& msg)>;
+
+	TypedSubscriber(IMqttClient& mqttClient, const std::string& topic, Handler handler, bool replay = false)
+		: m_mqtt(mqttClient)
+		, m_handler(std::move(handler))
+	{
+		m_mqtt.RegisterSub(topic, this, replay);
+	}
+
+	TypedSubscriber(
+			IMqttClient& mqttClient,
+			const std::string& topic,
+			Handler handler,
+			MailboxConfig mailbox,
+			bool replay = false)
+		: m_mqtt(mqttClient)
+		, m_handler(std::move(handler))
+		, m_mailbox(std::make_unique<Mailbox>(*this, std::move(mailbox)))
+	{
+		m_mqtt.RegisterSub(topic, this, replay);
+	}
+
+	~TypedSubscriber() override
+	{
+		m_mqtt.UnregisterSub(this);
+	}
+
+	void OnConnect(int rc) override {}
+	void OnDisconnect(int rc) override {}
+
+	void OnRawMessage(const MqttMessage& msg) override
+	{
+		if (!ZcmDecode(msg.Payload(), m_msg))
+		{
+			logger()->warn("TypedSubscriber::OnRawMessage(topic=\"{}\"): payload is not a valid {}",
+				msg.Topic(), T::getTypeName());
+			return;
+		}
+		m_handler(msg.Topic(), m_msg);
+	}
+
+	Mailbox* GetMailbox() override { return m_mailbox.get(); }
+
+private:
+	IMqttClient& m_mqtt;
+	Handler m_handler;
+	T m_msg {};
+	std::unique_ptr<Mailbox> m_mailbox; // Destroyed first; may still be draining.
+};
+
+template <ZcmMessage T>
+std::unique_ptr<TypedSubscriber<T>> IMqttClient::Subscribe(
+	const std::string& topic,
+	typename TypedSubscriber<T>::Handler handler,
+	bool replay)
+{
+	return std::make_unique<TypedSubscriber<T>>(*this, topic, std::move(handler), replay);
+}
+
+template <ZcmMessage T>
+std::unique_ptr<TypedSubscriber<T>> IMqttClient::Subscribe(
+	const std::string& topic,
+	typename TypedSubscriber<T>::Handler handler,
+	MailboxConfig mailbox,
+	bool replay)
+{
+	return std::make_unique<TypedSubscriber<T>>(*this, topic, std::move(handler), std::move(mailbox), replay);
+}
+
 } // namespace ncc
@@ -1,18 +1,42 @@
 #pragma once
 
+#include <core/MqttMessage.h>
+
 #include <string>
 #include <nlohmann/json_fwd.hpp>
 
 namespace ncc
 {
 
+class Mailbox;
+
 class IMqttSubscriber
 {
 public:
 	virtual ~IMqttSubscriber() = default;
 	virtual void OnConnect(int rc) = 0;
 	virtual void OnDisconnect(int rc) = 0;
-	virtual void OnMessage(const std::string& topic, const nlohmann::json& json) = 0;
+
+	// Called for every message matching one of the subscriber's topics. The
+	// default implementation parses the payload (once per message, shared with
+	// the other subscribers) and forwards it to OnMessage(). Override it to
+	// read the topic or raw payload without paying for parsing.
+	virtual void OnRawMessage(const MqttMessage& msg)
+	{
+		if (auto json = msg.Json())
+		{
+			OnMessage(msg.TopicString(), *json);
+		}
+	}
+
+	// Called with the parsed payload. Messages that aren't valid JSON are
+	// dropped before reaching this method.
+	virtual void OnMessage(const std::string& topic, const nlohmann::json& json) {}
+
+	// Subscribers that return a mailbox have their messages queued to it and
+	// handled off the network thread. OnConnect() and OnDisconnect() are
+	// still called directly.
+	virtual Mailbox* GetMailbox() { return nullptr; }
 };
 
 } // namespace ncc
@@ -1,6 +1,8 @@
 #pragma once
 
-#include <functional>
+#include <core/InplaceFunction.h>
+
+#include <cstdint>
 #include <string>
 
 #include <nlohmann/json_fwd.hpp>
@@ -13,16 +15,23 @@ namespace ncc
 //
 // The 'topic' is needed to subscribe for messages from the MQTT broker as well
 // as to identify which callback to call when messages are received.
+//
+// Add() returns a Token that identifies the subscription. Callbacks can't be
+// compared with each other, so the token is the only way to remove a single
+// callback again.
 class INotifier
 {
 public:
-	using MethodHandle = std::function<void(const std::string& topic, const nlohmann::json&)>;
+	using MethodHandle = InplaceFunction<void(const std::string& topic, const nlohmann::json&)>;
+	using Token = std::uint64_t;
+
+	static constexpr Token InvalidToken {0};
 
 	virtual ~INotifier() = default;
 
-	virtual bool Add(const std::string& topic, MethodHandle callback) = 0;
+	virtual Token Add(const std::string& topic, MethodHandle callback) = 0;
 	virtual bool Remove(const std::string& topic) = 0;
-	virtual bool Remove(const std::string& topic, MethodHandle callback) = 0;
+	virtual bool Remove(Token token) = 0;
 
 	virtual void Notify(const std::string& topic, const nlohmann::json& json) = 0;
 };
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace ncc
+{
+
+// InplaceFunction is a move-only replacement for std::function that stores
+// the callable in a fixed-size buffer inside the object, so it never
+// allocates. Callables that don't fit in "Capacity" bytes are rejected at
+// compile time instead of silently falling back to the heap.
+template <typename Signature, std::size_t Capacity = 48>
+class InplaceFunction;
+
+template <typename R, typename... Args, std::size_t Capacity>
+class InplaceFunction<R(Args...), Capacity>
+{
+public:
+	InplaceFunction() = default;
+	InplaceFunction(std::nullptr_t) {}
+
+	template <typename F>
+		requires (!std::is_same_v<std::decay_t<F>, InplaceFunction>
+			&& std::is_invocable_r_v<R, std::decay_t<F>&, Args...>)
+	InplaceFunction(F&& f)
+	{
+		using Fn = std::decay_t<F>;
+		static_assert(sizeof(Fn) <= Capacity, "Callable is too large for InplaceFunction; increase Capacity.");
+		static_assert(alignof(Fn) <= alignof(std::max_align_t), "Callable is over-aligned.");
+		static_assert(std::is_nothrow_move_constructible_v<Fn>, "Callable must be nothrow move constructible.");
+
+		::new (static_cast<void*>(m_storage)) Fn(std::forward<F>(f));
+		m_ops = &s_ops<Fn>;
+	}
+
+	InplaceFunction(InplaceFunction&& other) noexcept
+	{
+		MoveFrom_(other);
+	}
+
+	InplaceFunction& operator=(InplaceFunction&& other) noexcept
+	{
+		if (&other != this)
+		{
+			Reset();
+			MoveFrom_(other);
+		}
+		return *this;
+	}
+
+	InplaceFunction(const InplaceFunction&) = delete;
+	InplaceFunction& operator=(const InplaceFunction&) = delete;
+
+	~InplaceFunction()
+	{
+		Reset();
+	}
+
+	void Reset()
+	{
+		if (m_ops)
+		{
+			m_ops->destroy(m_storage);
+			m_ops = nullptr;
+		}
+	}
+
+	explicit operator bool() const { return m_ops != nullptr; }
+
+	R operator()(Args... args) const
+	{
+		return m_ops->invoke(const_cast<std::byte*>(m_storage), std::forward<Args>(args)...);
+	}
+
+private:
+	struct Ops
+	{
+		R (*invoke)(void* fn, Args&&... args);
+		void (*move)(void* dst, void* src) noexcept;
+		void (*destroy)(void* fn) noexcept;
+	};
+
+	template <typename Fn>
+	static constexpr Ops s_ops {
+		[](void* fn, Args&&... args) -> R {
+			return (*static_cast<Fn*>(fn))(std::forward<Args>(args)...);
+		},
+		[](void* dst, void* src) noexcept {
+			::new (dst) Fn(std::move(*static_cast<Fn*>(src)));
+			static_cast<Fn*>(src)->~Fn();
+		},
+		[](void* fn) noexcept {
+			static_cast<Fn*>(fn)->~Fn();
+		},
+	};
+
+	void MoveFrom_(InplaceFunction& other) noexcept
+	{
+		if (other.m_ops)
+		{
+			other.m_ops->move(m_storage, other.m_storage);
+			m_ops = other.m_ops;
+			other.m_ops = nullptr;
+		}
+	}
+
+private:
+	alignas(std::max_align_t) std::byte m_storage[Capacity];
+	const Ops* m_ops {nullptr};
+};
+
+} // namespace ncc
@@ -0,0 +1,193 @@
+#include <core/JsonWriter.h>
+
+#include <charconv>
+#include <cmath>
+
+namespace ncc
+{
+
+JsonWriter::JsonWriter()
+{
+	constexpr std::size_t initialCapacity {256};
+	m_buffer.reserve(initialCapacity);
+}
+
+JsonWriter& JsonWriter::ThreadLocal()
+{
+	thread_local JsonWriter writer;
+	writer.Clear();
+	return writer;
+}
+
+void JsonWriter::Clear()
+{
+	m_buffer.clear(); // Keeps capacity.
+	m_hasValue.fill(false);
+	m_depth = 0;
+	m_afterKey = false;
+}
+
+JsonWriter& JsonWriter::BeginObject()
+{
+	Open_('{');
+	return *this;
+}
+
+JsonWriter& JsonWriter::EndObject()
+{
+	Close_('}');
+	return *this;
+}
+
+JsonWriter& JsonWriter::BeginArray()
+{
+	Open_('[');
+	return *this;
+}
+
+JsonWriter& JsonWriter::EndArray()
+{
+	Close_(']');
+	return *this;
+}
+
+JsonWriter& JsonWriter::Key(std::string_view key)
+{
+	Separator_();
+	AppendString_(key);
+	m_buffer.push_back(':');
+	m_afterKey = true;
+	return *this;
+}
+
+JsonWriter& JsonWriter::Value(bool value)
+{
+	Separator_();
+	m_buffer.append(value ? "true" : "false");
+	return *this;
+}
+
+JsonWriter& JsonWriter::Value(std::string_view value)
+{
+	Separator_();
+	AppendString_(value);
+	return *this;
+}
+
+JsonWriter& JsonWriter::Null()
+{
+	Separator_();
+	m_buffer.append("null");
+	return *this;
+}
+
+// Writes the ',' between elements. Values following a key don't need one.
+void JsonWriter::Separator_()
+{
+	if (m_afterKey)
+	{
+		m_afterKey = false;
+		return;
+	}
+	if (m_hasValue[m_depth])
+	{
+		m_buffer.push_back(',');
+	}
+	m_hasValue[m_depth] = true;
+}
+
+void JsonWriter::Open_(char c)
+{
+	Separator_();
+	m_buffer.push_back(c);
+	if (m_depth + 1 < MaxDepth)
+	{
+		++m_depth;
+	}
+	m_hasValue[m_depth] = false;
+}
+
+void JsonWriter::Close_(char c)
+{
+	m_buffer.push_back(c);
+	if (m_depth > 0)
+	{
+		--m_depth;
+	}
+}
+
+void JsonWriter::AppendString_(std::string_view str)
+{
+	constexpr char hex[] = "0123456789abcdef";
+
+	m_buffer.push_back('"');
+	for (char c : str)
+	{
+		switch (c)
+		{
+		case '"':  m_buffer.append("\\\""); break;
+		case '\\': m_buffer.append("\\\\"); break;
+		case '\b': m_buffer.append("\\b"); break;
+		case '\f': m_buffer.append("\\f"); break;
+		case '\n': m_buffer.append("\\n"); break;
+		case '\r': m_buffer.append("\\r"); break;
+		case '\t': m_buffer.append("\\t"); break;
+		default:
+			if (static_cast<unsigned char>(c) < 0x20)
+			{
+				m_buffer.append("\\u00");
+				m_buffer.push_back(hex[(c >> 4) & 0xf]);
+				m_buffer.push_back(hex[c & 0xf]);
+			}
+			else
+			{
+				m_buffer.push_back(c);
+			}
+			break;
+		}
+	}
+	m_buffer.push_back('"');
+}
+
+void JsonWriter::AppendNumber_(long long value)
+{
+	char buf[24];
+	auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), value);
+	m_buffer.append(buf, end);
+}
+
+void JsonWriter::AppendNumber_(unsigned long long value)
+{
+	char buf[24];
+	auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), value);
+	m_buffer.append(buf, end);
+}
+
+void JsonWriter::AppendNumber_(double value)
+{
+	// JSON has no representation for NaN or infinity.
+	if (!std::isfinite(value))
+	{
+		m_buffer.append("null");
+		return;
+	}
+	char buf[32];
+	auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), value);
+	m_buffer.append(buf, end);
+}
+
+void JsonWriter::AppendNumber_(float value)
+{
+	if (!std::isfinite(value))
+	{
+		m_buffer.append("null");
+		return;
+	}
+	// Shortest representation that round-trips as a float (i.e. 21.5, not
+	// 21.5000000000).
+	char buf[32];
+	auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), value);
+	m_buffer.append(buf, end);
+}
+
+} // namespace ncc
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace ncc
+{
+
+// JsonWriter formats JSON directly into a reusable text buffer without
+// building a DOM. The buffer keeps its capacity across Clear(), so once it
+// has grown to the size of the largest message, writing doesn't allocate.
+//
+// Commas and colons are inserted automatically:
+//
+//   auto& writer = JsonWriter::ThreadLocal();
+//   writer.BeginObject().Field("heater", 1).Field("enabled", true).EndObject();
+//   mqtt.Publish(topic, writer.Bytes());
+//
+// NOTE: The writer doesn't validate the document structure beyond tracking
+// the nesting depth (up to MaxDepth levels).
+class JsonWriter
+{
+public:
+	static constexpr std::size_t MaxDepth {16};
+
+	JsonWriter();
+
+	// Returns the calling thread's writer, cleared and ready for a new document.
+	static JsonWriter& ThreadLocal();
+
+	void Clear();
+
+	JsonWriter& BeginObject();
+	JsonWriter& EndObject();
+	JsonWriter& BeginArray();
+	JsonWriter& EndArray();
+
+	JsonWriter& Key(std::string_view key);
+
+	JsonWriter& Value(bool value);
+	JsonWriter& Value(std::string_view value);
+	JsonWriter& Value(const char* value) { return Value(std::string_view(value)); }
+	JsonWriter& Null();
+
+	template <std::integral T>
+		requires (!std::same_as<T, bool>)
+	JsonWriter& Value(T value)
+	{
+		Separator_();
+		AppendNumber_(value);
+		return *this;
+	}
+
+	template <std::floating_point T>
+	JsonWriter& Value(T value)
+	{
+		Separator_();
+		AppendNumber_(value);
+		return *this;
+	}
+
+	template <typename T>
+	JsonWriter& Field(std::string_view key, const T& value)
+	{
+		return Key(key).Value(value);
+	}
+
+	std::string_view View() const { return m_buffer; }
+	std::span<const std::byte> Bytes() const { return std::as_bytes(std::span(m_buffer)); }
+
+private:
+	void Separator_();
+	void Open_(char c);
+	void Close_(char c);
+	void AppendString_(std::string_view str);
+	void AppendNumber_(long long value);
+	void AppendNumber_(unsigned long long value);
+	void AppendNumber_(double value);
+	void AppendNumber_(float value);
+
+	template <std::integral T>
+	void AppendNumber_(T value)
+	{
+		if constexpr (std::is_signed_v<T>)
+			AppendNumber_(static_cast<long long>(value));
+		else
+			AppendNumber_(static_cast<unsigned long long>(value));
+	}
+
+private:
+	std::string m_buffer;
+	std::array<bool, MaxDepth> m_hasValue {}; // Per level: has an element been written?
+	std::size_t m_depth {0};
+	bool m_afterKey {false};
+};
+
+} // namespace ncc
@@ -0,0 +1,118 @@
+#include <core/LatencyMonitor.h>
+
+namespace ncc
+{
+
+LatencyMonitor::LatencyMonitor(const LatencyConfig& config)
+	: m_config(config)
+{
+	for (const auto& filter : m_config.topics)
+	{
+		m_filters.Insert(filter)->values.push_back(true);
+	}
+}
+
+bool LatencyMonitor::Matches(std::string_view topic) const
+{
+	if (!m_config.enabled)
+	{
+		return false;
+	}
+	bool match {m_filters.Empty()};
+	if (!match)
+	{
+		m_filters.Match(topic, [&match](const auto&) { match = true; });
+	}
+	return match;
+}
+
+bool LatencyMonitor::Track(std::string_view topic)
+{
+	if (!Matches(topic))
+	{
+		return false;
+	}
+
+	for (int attempt = 0; attempt < 2; ++attempt)
+	{
+		{
+			auto topics = m_topics.Read();
+			if (topics->find(topic) != topics->end())
+			{
+				return true;
+			}
+			if (topics->size() >= m_config.maxTopics)
+			{
+				break;
+			}
+		}
+		Insert_(topic);
+	}
+	m_untracked.fetch_add(1, std::memory_order_relaxed);
+	return false;
+}
+
+template <typename Fn>
+void LatencyMonitor::Find_(std::string_view topic, Fn&& fn) const
+{
+	// The snapshot keeps the entry alive while it is being recorded to, so no
+	// reference count is touched on this path.
+	auto topics = m_topics.Read();
+	auto it = topics->find(topic);
+	if (it != topics->end())
+	{
+		fn(*it->second);
+	}
+}
+
+// Negative when the publisher's clock is ahead; Histogram::Record() clamps
+// to zero.
+void LatencyMonitor::RecordDelivery(std::string_view topic, std::int64_t sent, std::int64_t delivered)
+{
+	Find_(topic, [&](Topic& entry) {
+		entry.delivery.Record(std::chrono::nanoseconds(delivered - sent));
+	});
+}
+
+void LatencyMonitor::RecordHandled(std::string_view topic, std::int64_t sent, std::int64_t handled)
+{
+	Find_(topic, [&](Topic& entry) {
+		entry.handled.Record(std::chrono::nanoseconds(handled - sent));
+	});
+}
+
+std::map<std::string, LatencyStats> LatencyMonitor::Stats() const
+{
+	std::map<std::string, LatencyStats> stats;
+	auto topics = m_topics.Read();
+	for (const auto& [topic, entry] : *topics)
+	{
+		stats[topic] = {entry->delivery.Summary(), entry->handled.Summary()};
+	}
+	return stats;
+}
+
+void LatencyMonitor::Reset()
+{
+	auto topics = m_topics.Read();
+	for (const auto& [topic, entry] : *topics)
+	{
+		entry->delivery.Reset();
+		entry->handled.Reset();
+	}
+	m_untracked.store(0, std::memory_order_relaxed);
+}
+
+void LatencyMonitor::Insert_(std::string_view topic)
+{
+	// Entries are shared between snapshots, so the copy made by Update() only
+	// copies pointers and recorders keep using the same histograms.
+	m_topics.Update([&](Topics& topics) {
+		if (topics.size() < m_config.maxTopics && topics.find(topic) == topics.end())
+		{
+			topics.emplace(std::string(topic), std::make_shared<Topic>());
+		}
+	});
+}
+
+} // namespace ncc
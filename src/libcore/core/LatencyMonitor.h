@@ -0,0 +1,112 @@
+#pragma once
+
+#include <core/Histogram.h>
+#include <core/Rcu.h>
+#include <core/TopicTrie.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ncc
+{
+
+struct LatencyConfig
+{
+	// Stamp every publish with its send time (an MQTT v5 user property, so
+	// this switches the client to MQTT v5) and measure per topic how long
+	// messages take to reach the subscribers, whether they come through the
+	// broker or are delivered locally.
+	bool enabled {false};
+
+	// Topic filters to measure; empty measures every topic. Only publishes
+	// on these topics are stamped, and only messages on them have their
+	// properties read.
+	std::vector<std::string> topics;
+
+	// Histograms are kept for at most this many topics; messages on further
+	// topics are only counted.
+	std::size_t maxTopics {1024};
+};
+
+// End-to-end latencies of one topic, in nanoseconds from the publisher's
+// send time. "delivery" ends when the message is dispatched. "handled" ends
+// once per dispatch when the subscribers called on the dispatching thread
+// have returned, and once per mailbox subscriber when its handler has
+// returned.
+struct LatencyStats
+{
+	HistogramSummary delivery;
+	HistogramSummary handled;
+};
+
+// LatencyMonitor keeps a pair of histograms per topic. Recording looks the
+// topic up in an Rcu snapshot and increments atomics, so dispatch never takes
+// a lock once a topic has been seen; only the first message on a new topic
+// updates the map.
+//
+// Times are wall clock (system_clock) nanoseconds so that they can be compared
+// between processes. Between hosts they are only as good as the clock sync.
+class LatencyMonitor
+{
+public:
+	explicit LatencyMonitor(const LatencyConfig& config);
+
+	static std::int64_t Now()
+	{
+		using namespace std::chrono;
+		return duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count();
+	}
+
+	bool Enabled() const { return m_config.enabled; }
+
+	// Whether publishes on "topic" are stamped: enabled and matching
+	// LatencyConfig::topics.
+	bool Matches(std::string_view topic) const;
+
+	// Whether messages received on "topic" are measured: it matches and has
+	// histograms, which are added while there is room. Otherwise a matching
+	// message is counted as untracked.
+	bool Track(std::string_view topic);
+
+	// Record nothing for a topic that isn't tracked.
+	void RecordDelivery(std::string_view topic, std::int64_t sent, std::int64_t delivered);
+	void RecordHandled(std::string_view topic, std::int64_t sent, std::int64_t handled);
+
+	std::map<std::string, LatencyStats> Stats() const;
+
+	// Messages on topics beyond LatencyConfig::maxTopics.
+	std::uint64_t Untracked() const { return m_untracked.load(std::memory_order_relaxed); }
+
+	// Clears every histogram. Topics stay registered.
+	void Reset();
+
+private:
+	struct Topic
+	{
+		Histogram delivery;
+		Histogram handled;
+	};
+
+	using Topics = std::map<std::string, std::shared_ptr<Topic>, std::less<>>;
+
+	void Insert_(std::string_view topic);
+
+	// Calls fn(Topic&) if "topic" is tracked.
+	template <typename Fn>
+	void Find_(std::string_view topic, Fn&& fn) const;
+
+private:
+	const LatencyConfig m_config;
+	TopicTrie<bool> m_filters;
+	Rcu<Topics> m_topics;
+	std::atomic<std::uint64_t> m_untracked {0};
+};
+
+} // namespace ncc
@@ -1,6 +1,16 @@
 #include <core/Logger.h>
+#include <core/Metrics.h>
 
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include <spdlog/async.h>
+#include <spdlog/async_logger.h>
 #include <spdlog/details/synchronous_factory.h>
+#include <spdlog/details/thread_pool.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/sinks/basic_file_sink.h>
 #include <spdlog/sinks/udp_sink.h>
@@ -10,14 +20,94 @@
 namespace ncc
 {
 
+namespace
+{
+
+std::mutex g_mutex;
 std::shared_ptr<spdlog::logger> g_logger;
+std::shared_ptr<spdlog::details::thread_pool> g_threadPool; // Only while asynchronous
+
+// Read by logger() without the lock.
+std::atomic<spdlog::logger*> g_current {nullptr};
+
+// Loggers that were replaced. Other threads may still be using them, so
+// they are never destroyed.
+std::vector<std::shared_ptr<spdlog::logger>> g_retired;
+
+// Dropped by thread pools that were shut down.
+std::uint64_t g_dropped {0};
+
+std::uint64_t Dropped(spdlog::details::thread_pool& threadPool)
+{
+	return threadPool.overrun_counter() + threadPool.discard_counter();
+}
+
+spdlog::async_overflow_policy SpdlogPolicy(LogOverflowPolicy policy)
+{
+	switch (policy)
+	{
+	case LogOverflowPolicy::Block:
+		return spdlog::async_overflow_policy::block;
+	case LogOverflowPolicy::DropNewest:
+		return spdlog::async_overflow_policy::discard_new;
+	case LogOverflowPolicy::DropOldest:
+	default:
+		return spdlog::async_overflow_policy::overrun_oldest;
+	}
+}
+
+// With g_mutex held.
+void SetLogger(std::shared_ptr<spdlog::logger> logger)
+{
+	if (g_logger)
+	{
+		g_retired.push_back(g_logger);
+	}
+	g_logger = std::move(logger);
+	g_current.store(g_logger.get(), std::memory_order_release);
+}
+
+// With g_mutex held, once the pool's logger was replaced.
+void StopThreadPool(std::shared_ptr<spdlog::details::thread_pool> threadPool)
+{
+	if (!threadPool)
+	{
+		return;
+	}
+	g_dropped += Dropped(*threadPool);
+
+	// The pool writes out its queue before its threads exit. Queued messages
+	// keep their logger alive, not the pool.
+	threadPool.reset();
+}
+
+void RegisterMetrics()
+{
+	// The registry calls these with its lock held; g_mutex is never held
+	// while calling into the registry.
+	static auto callbacks = new std::vector<MetricsCallback>;
+	callbacks->push_back(metrics().AddCallback(MetricType::Gauge, "log_queue_depth",
+		"Log messages waiting for the logging thread", {},
+		[]() { return static_cast<double>(GetLoggerStats().queued); }));
+	callbacks->push_back(metrics().AddCallback(MetricType::Counter, "log_messages_dropped_total",
+		"Log messages dropped because the logging queue was full", {},
+		[]() { return static_cast<double>(GetLoggerStats().dropped); }));
+}
+
+} // namespace
 
 void InitializeLogger(
 	const std::string& name,
 	bool truncateLog,
 	const std::set<std::string>& sinkTypes,
-	spdlog::level::level_enum level)
+	spdlog::level::level_enum level,
+	const AsyncLogConfig& async)
 {
+	if (async.enabled && (async.queueSize == 0 || async.threads == 0))
+	{
+		throw std::invalid_argument("InitializeLogger(): the queue size and thread count must not be zero");
+	}
+
 	std::vector<std::shared_ptr<spdlog::sinks::sink>> sinks;
 
 //	if (sinkTypes.contains("stdout")) // C++20
@@ -46,17 +136,85 @@ void InitializeLogger(
 		sinks.push_back(file_sink);
 	}
 
-	g_logger = std::make_shared<spdlog::logger>(name, sinks.begin(), sinks.end());
-	g_logger->set_level(level);
+	static std::once_flag once;
+	std::call_once(once, []() {
+		RegisterMetrics();
+		std::atexit(ShutdownLogger);
+	});
+
+	std::lock_guard lock(g_mutex);
+	auto previous = g_logger;
+	auto previousThreadPool = std::move(g_threadPool);
+
+	std::shared_ptr<spdlog::logger> logger;
+	if (async.enabled)
+	{
+		g_threadPool = std::make_shared<spdlog::details::thread_pool>(async.queueSize, async.threads);
+		logger = std::make_shared<spdlog::async_logger>(
+			name, sinks.begin(), sinks.end(), g_threadPool, SpdlogPolicy(async.overflow));
+	}
+	else
+	{
+		logger = std::make_shared<spdlog::logger>(name, sinks.begin(), sinks.end());
+	}
+	logger->set_level(level);
+	SetLogger(std::move(logger));
+
+	// Write out what the previous logger queued. It is never destroyed, so
+	// its sinks must be flushed here (flush() would need the stopped pool).
+	StopThreadPool(std::move(previousThreadPool));
+	if (previous)
+	{
+		for (const auto& sink : previous->sinks())
+		{
+			sink->flush();
+		}
+	}
 }
 
-spdlog::logger* logger()
+void ShutdownLogger()
 {
+	std::lock_guard lock(g_mutex);
 	if (!g_logger)
+	{
+		return;
+	}
+
+	if (g_threadPool)
+	{
+		// Messages from threads that are still running are written
+		// synchronously from now on.
+		auto logger = std::make_shared<spdlog::logger>(g_logger->name(), g_logger->sinks().begin(), g_logger->sinks().end());
+		logger->set_level(g_logger->level());
+		SetLogger(std::move(logger));
+
+		StopThreadPool(std::move(g_threadPool));
+	}
+
+	g_logger->flush();
+}
+
+LoggerStats GetLoggerStats()
+{
+	std::lock_guard lock(g_mutex);
+
+	LoggerStats stats {.dropped = g_dropped};
+	if (g_threadPool)
+	{
+		stats.queued = g_threadPool->queue_size();
+		stats.dropped += Dropped(*g_threadPool);
+	}
+	return stats;
+}
+
+spdlog::logger* logger()
+{
+	auto current = g_current.load(std::memory_order_acquire);
+	if (!current)
 	{
 		throw std::runtime_error("InitializeLogger() must be called before calling logger()!");
 	}
-	return g_logger.get();
+	return current;
 }
 
 } // namespace ncc
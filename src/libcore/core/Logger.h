@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <set>
 #include <string>
 
@@ -8,19 +10,74 @@
 namespace ncc
 {
 
+enum class LogOverflowPolicy
+{
+	Block,      // Wait for room in the queue.
+	DropOldest, // Discard the oldest queued message to make room.
+	DropNewest, // Discard the message being logged.
+};
+
+struct AsyncLogConfig
+{
+	// Write to the sinks on the calling thread if false.
+	bool enabled {false};
+
+	// Messages waiting to be written. Each takes a few hundred bytes.
+	std::size_t queueSize {8192};
+
+	// Threads writing to the sinks. With more than one, messages may be
+	// written out of order.
+	std::size_t threads {1};
+
+	LogOverflowPolicy overflow {LogOverflowPolicy::DropOldest};
+};
+
+struct LoggerStats
+{
+	// Messages waiting to be written.
+	std::size_t queued {0};
+
+	// Messages dropped because the queue was full.
+	std::uint64_t dropped {0};
+};
+
 /**
  * Creates an "spdlog" logger that outputs to zero or more sinks.
  *
+ * With "async" enabled, logging formats the message and queues it; it is
+ * written to the sinks by a pool of logging threads, so a slow sink doesn't
+ * hold up the caller (i.e. the MQTT network thread). The queue is written
+ * out at exit (see ShutdownLogger()).
+ *
  * @param name is display at the start of all log messages
  * @param truncateLog is used to append logs to an existing file or start anew
  * @param sinkTypes set of desired sinks options: { stdout, udp, file }
  * @param level maximum spdlog level to show
+ * @param async asynchronous mode; synchronous by default
  */
 void InitializeLogger(
 	const std::string& name,
 	bool truncateLog = false,
 	const std::set<std::string>& sinkTypes = { "file", "udp" },
-	spdlog::level::level_enum level = spdlog::level::warn);
+	spdlog::level::level_enum level = spdlog::level::warn,
+	const AsyncLogConfig& async = {});
+
+/**
+ * Writes out the queued messages of an asynchronous logger, stops its
+ * threads and flushes the sinks. Messages logged afterwards are written on
+ * the calling thread.
+ *
+ * Called at exit; call it earlier to be sure everything was written, i.e.
+ * before a fork() or an abort().
+ */
+void ShutdownLogger();
+
+/**
+ * Returns the asynchronous logger's queue depth and dropped message count.
+ * Also exported as the log_queue_depth and log_messages_dropped_total
+ * metrics.
+ */
+LoggerStats GetLoggerStats();
 
 /**
  * Returns a pointer to the sdplog logger.
@@ -0,0 +1,175 @@
+#include <core/IMqttSubscriber.h>
+#include <core/LatencyMonitor.h>
+#include <core/Logger.h>
+#include <core/Mailbox.h>
+#include <core/MqttMessage.h>
+#include <core/WorkerPool.h>
+
+#include <thread>
+
+namespace ncc
+{
+
+namespace
+{
+
+// Messages handled per pool task before the mailbox yields the thread to
+// other mailboxes.
+constexpr std::size_t poolBatchSize {64};
+
+void UpdateMax(std::atomic<std::int64_t>& max, std::int64_t value)
+{
+	auto current = max.load(std::memory_order_relaxed);
+	while (value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed))
+	{
+	}
+}
+
+} // namespace
+
+Mailbox::Mailbox(IMqttSubscriber& target, MailboxConfig config)
+	: m_target(target)
+	, m_config(std::move(config))
+	, m_ring(m_config.capacity)
+{
+}
+
+Mailbox::~Mailbox()
+{
+	// Wait for outstanding pool tasks; they refer to this mailbox.
+	while (m_poolTasks.load(std::memory_order_acquire) != 0)
+	{
+		std::this_thread::yield();
+	}
+}
+
+bool Mailbox::Post(const MqttMessage& msg, LatencyMonitor* latency, std::int64_t sent)
+{
+	bool pushed = m_ring.TryPush([&](Message& slot) {
+		// assign() reuses the slot's existing capacity.
+		slot.topic.assign(msg.Topic());
+		slot.payload.assign(msg.Payload().begin(), msg.Payload().end());
+		slot.posted = std::chrono::steady_clock::now();
+		slot.latency = latency;
+		slot.sent = sent;
+	});
+
+	if (!pushed)
+	{
+		m_dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	m_posted.fetch_add(1, std::memory_order_relaxed);
+	Schedule_();
+	return true;
+}
+
+std::size_t Mailbox::Drain(std::size_t max)
+{
+	if (m_draining.test_and_set(std::memory_order_acquire))
+	{
+		return 0; // Another thread is draining; it will deliver in order.
+	}
+
+	// Clear before draining so a message posted from now on schedules
+	// another wakeup instead of being left behind.
+	if (!m_config.pool)
+	{
+		m_scheduled.store(false, std::memory_order_release);
+	}
+
+	std::size_t count {0};
+	while (count < max && m_ring.TryPop([this](Message& msg) { Deliver_(msg); }))
+	{
+		++count;
+	}
+
+	m_draining.clear(std::memory_order_release);
+	return count;
+}
+
+MailboxStats Mailbox::Stats() const
+{
+	MailboxStats stats;
+	stats.depth = m_ring.Size();
+	stats.capacity = m_ring.Capacity();
+	stats.posted = m_posted.load(std::memory_order_relaxed);
+	stats.delivered = m_delivered.load(std::memory_order_relaxed);
+	stats.dropped = m_dropped.load(std::memory_order_relaxed);
+	if (stats.delivered > 0)
+	{
+		auto delivered = static_cast<std::int64_t>(stats.delivered);
+		stats.meanQueueLatency = std::chrono::nanoseconds(m_queueNsTotal.load(std::memory_order_relaxed) / delivered);
+		stats.meanHandlerLatency = std::chrono::nanoseconds(m_handlerNsTotal.load(std::memory_order_relaxed) / delivered);
+	}
+	stats.maxQueueLatency = std::chrono::nanoseconds(m_queueNsMax.load(std::memory_order_relaxed));
+	stats.maxHandlerLatency = std::chrono::nanoseconds(m_handlerNsMax.load(std::memory_order_relaxed));
+	return stats;
+}
+
+void Mailbox::Schedule_()
+{
+	if (m_scheduled.exchange(true, std::memory_order_acq_rel))
+	{
+		return; // Already scheduled.
+	}
+
+	if (m_config.pool)
+	{
+		m_poolTasks.fetch_add(1, std::memory_order_relaxed);
+		m_config.pool->Post([this]() {
+			RunOnPool_();
+			m_poolTasks.fetch_sub(1, std::memory_order_release);
+		});
+	}
+	else if (m_config.wakeup)
+	{
+		m_config.wakeup();
+	}
+}
+
+void Mailbox::RunOnPool_()
+{
+	Drain(poolBatchSize);
+
+	m_scheduled.store(false, std::memory_order_release);
+
+	// Reschedule if messages remain (or arrived after the last pop), keeping
+	// at most one task per mailbox in the pool.
+	if (!m_ring.Empty())
+	{
+		Schedule_();
+	}
+}
+
+void Mailbox::Deliver_(Message& msg)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	MqttMessage message(msg.topic, msg.payload);
+	try
+	{
+		m_target.OnRawMessage(message);
+	}
+	catch (const std::exception& e)
+	{
+		logger()->error("Mailbox({})::Drain(topic=\"{}\"): caught: {}", m_config.name, msg.topic, e.what());
+	}
+	if (msg.latency)
+	{
+		msg.latency->RecordHandled(msg.topic, msg.sent, LatencyMonitor::Now());
+	}
+
+	auto end = std::chrono::steady_clock::now();
+	auto queueNs = std::chrono::duration_cast<std::chrono::nanoseconds>(start - msg.posted).count();
+	auto handlerNs = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+	m_delivered.fetch_add(1, std::memory_order_relaxed);
+	m_queueNsTotal.fetch_add(queueNs, std::memory_order_relaxed);
+	m_handlerNsTotal.fetch_add(handlerNs, std::memory_order_relaxed);
+	UpdateMax(m_queueNsMax, queueNs);
+	UpdateMax(m_handlerNsMax, handlerNs);
+}
+
+} // namespace ncc
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <core/InplaceFunction.h>
+#include <core/MpmcRing.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ncc
+{
+
+class IMqttSubscriber;
+class LatencyMonitor;
+class MqttMessage;
+class WorkerPool;
+
+struct MailboxConfig
+{
+	std::string name;
+	std::size_t capacity {256};
+
+	// The mailbox is drained either on "pool" or by its owner's thread, in
+	// which case "wakeup" is called when a message arrives in an empty
+	// mailbox. With neither set, the owner polls Drain().
+	WorkerPool* pool {nullptr};
+	InplaceFunction<void()> wakeup;
+};
+
+struct MailboxStats
+{
+	std::size_t depth {0};
+	std::size_t capacity {0};
+	std::uint64_t posted {0};
+	std::uint64_t delivered {0};
+	std::uint64_t dropped {0};
+	std::chrono::nanoseconds meanQueueLatency {0};
+	std::chrono::nanoseconds maxQueueLatency {0};
+	std::chrono::nanoseconds meanHandlerLatency {0};
+	std::chrono::nanoseconds maxHandlerLatency {0};
+};
+
+// Mailbox lets a subscriber handle its messages on its own thread (or on a
+// shared WorkerPool) instead of on the mosquitto network thread, so one slow
+// handler can't delay keepalives or the other subscribers.
+//
+// Post() copies the message into a bounded lock-free ring and never blocks;
+// a full mailbox drops the new message. Only one thread drains a mailbox at a
+// time, so messages are handled in the order they arrived, which preserves
+// per-topic ordering.
+//
+// A subscriber opts in by returning its mailbox from
+// IMqttSubscriber::GetMailbox(). It must unregister from the MqttClient
+// before its mailbox is destroyed.
+class Mailbox
+{
+public:
+	Mailbox(IMqttSubscriber& target, MailboxConfig config);
+	~Mailbox();
+
+	Mailbox(const Mailbox&) = delete;
+	Mailbox& operator=(const Mailbox&) = delete;
+
+	// Called by the dispatching thread. Returns false if the message was
+	// dropped because the mailbox is full. With "latency", the time from
+	// "sent" (see LatencyMonitor) until the handler returns is recorded;
+	// "latency" must then outlive the mailbox.
+	bool Post(const MqttMessage& msg, LatencyMonitor* latency = nullptr, std::int64_t sent = 0);
+
+	// Delivers up to "max" queued messages to the subscriber. Returns the
+	// number delivered.
+	std::size_t Drain(std::size_t max = SIZE_MAX);
+
+	bool Empty() const { return m_ring.Empty(); }
+	const std::string& Name() const { return m_config.name; }
+	MailboxStats Stats() const;
+
+private:
+	struct Message
+	{
+		std::string topic;
+		std::vector<std::byte> payload;
+		std::chrono::steady_clock::time_point posted;
+		LatencyMonitor* latency {nullptr};
+		std::int64_t sent {0};
+	};
+
+	void Schedule_();
+	void RunOnPool_();
+	void Deliver_(Message& msg);
+
+private:
+	IMqttSubscriber& m_target;
+	MailboxConfig m_config;
+	MpmcRing<Message> m_ring;
+
+	// Set while a wakeup or pool task is outstanding.
+	std::atomic_bool m_scheduled {false};
+	std::atomic_flag m_draining;
+	std::atomic<int> m_poolTasks {0};
+
+	std::atomic<std::uint64_t> m_posted {0};
+	std::atomic<std::uint64_t> m_delivered {0};
+	std::atomic<std::uint64_t> m_dropped {0};
+	std::atomic<std::int64_t> m_queueNsTotal {0};
+	std::atomic<std::int64_t> m_queueNsMax {0};
+	std::atomic<std::int64_t> m_handlerNsTotal {0};
+	std::atomic<std::int64_t> m_handlerNsMax {0};
+};
+
+} // namespace ncc
@@ -0,0 +1,277 @@
+#include <core/Metrics.h>
+
+#include <stdexcept>
+
+#include <fmt/format.h>
+
+namespace ncc
+{
+
+namespace
+{
+
+const char* TypeName(MetricType type)
+{
+	switch (type)
+	{
+	case MetricType::Counter:
+		return "counter";
+	case MetricType::Gauge:
+		return "gauge";
+	case MetricType::Summary:
+		return "summary";
+	}
+	return "untyped";
+}
+
+// Escapes label values and help text as required by the text format.
+void AppendEscaped(std::string& out, const std::string& text, bool quotes)
+{
+	for (char c : text)
+	{
+		if (c == '\\')
+		{
+			out += "\\\\";
+		}
+		else if (c == '\n')
+		{
+			out += "\\n";
+		}
+		else if (c == '"' && quotes)
+		{
+			out += "\\\"";
+		}
+		else
+		{
+			out += c;
+		}
+	}
+}
+
+// Adds "extra" (i.e. quantile="0.5") to a formatted label set.
+std::string WithLabel(const std::string& labels, const std::string& extra)
+{
+	if (labels.empty())
+	{
+		return "{" + extra + "}";
+	}
+	return labels.substr(0, labels.size() - 1) + "," + extra + "}";
+}
+
+} // namespace
+
+std::uint64_t CounterMetric::Value() const
+{
+	std::uint64_t value {0};
+	for (const auto& shard : m_shards)
+	{
+		value += shard.value.load(std::memory_order_relaxed);
+	}
+	return value;
+}
+
+MetricsCallback::~MetricsCallback()
+{
+	Reset();
+}
+
+MetricsCallback::MetricsCallback(MetricsCallback&& other) noexcept
+	: m_registry(std::exchange(other.m_registry, nullptr))
+	, m_id(std::exchange(other.m_id, 0))
+{
+}
+
+MetricsCallback& MetricsCallback::operator=(MetricsCallback&& other) noexcept
+{
+	if (&other != this)
+	{
+		Reset();
+		m_registry = std::exchange(other.m_registry, nullptr);
+		m_id = std::exchange(other.m_id, 0);
+	}
+	return *this;
+}
+
+void MetricsCallback::Reset()
+{
+	if (m_registry)
+	{
+		m_registry->RemoveCallback_(m_id);
+		m_registry = nullptr;
+	}
+}
+
+CounterMetric& MetricsRegistry::Counter(const std::string& name, const std::string& help, const MetricLabels& labels)
+{
+	std::unique_lock lock(m_mutex);
+	auto& series = Series_(MetricType::Counter, name, help, labels);
+	if (!series.counter)
+	{
+		series.counter = std::make_unique<CounterMetric>();
+	}
+	return *series.counter;
+}
+
+GaugeMetric& MetricsRegistry::Gauge(const std::string& name, const std::string& help, const MetricLabels& labels)
+{
+	std::unique_lock lock(m_mutex);
+	auto& series = Series_(MetricType::Gauge, name, help, labels);
+	if (!series.gauge)
+	{
+		series.gauge = std::make_unique<GaugeMetric>();
+	}
+	return *series.gauge;
+}
+
+Histogram& MetricsRegistry::Summary(const std::string& name, const std::string& help, const MetricLabels& labels)
+{
+	std::unique_lock lock(m_mutex);
+	auto& series = Series_(MetricType::Summary, name, help, labels);
+	if (!series.histogram)
+	{
+		series.histogram = std::make_unique<Histogram>();
+	}
+	return *series.histogram;
+}
+
+MetricsCallback MetricsRegistry::AddCallback(
+	MetricType type,
+	const std::string& name,
+	const std::string& help,
+	const MetricLabels& labels,
+	Callback callback)
+{
+	if (type == MetricType::Summary)
+	{
+		throw std::invalid_argument("MetricsRegistry::AddCallback(): summaries can't be callbacks");
+	}
+
+	std::unique_lock lock(m_mutex);
+	auto& series = Series_(type, name, help, labels);
+	auto id = m_nextCallback++;
+	series.callbacks.emplace(id, std::move(callback));
+	m_callbacks.emplace(id, &series);
+	return MetricsCallback(this, id);
+}
+
+std::string MetricsRegistry::Render() const
+{
+	std::string out;
+	out.reserve(16 * 1024);
+	auto append = std::back_inserter(out);
+
+	std::unique_lock lock(m_mutex);
+	for (const auto& [name, family] : m_families)
+	{
+		out += "# HELP ";
+		out += name;
+		out += ' ';
+		AppendEscaped(out, family.help, false);
+		fmt::format_to(append, "\n# TYPE {} {}\n", name, TypeName(family.type));
+
+		for (const auto& [labels, series] : family.series)
+		{
+			if (series.histogram)
+			{
+				auto summary = series.histogram->Summary();
+				constexpr double scale {1e-9};
+				const std::pair<const char*, std::uint64_t> quantiles[] {
+					{"0.5", summary.p50},
+					{"0.9", summary.p90},
+					{"0.99", summary.p99},
+					{"0.999", summary.p999},
+				};
+				for (const auto& [quantile, value] : quantiles)
+				{
+					fmt::format_to(append, "{}{} {}\n",
+						name, WithLabel(labels, fmt::format("quantile=\"{}\"", quantile)), value * scale);
+				}
+				fmt::format_to(append, "{}_sum{} {}\n", name, labels, series.histogram->Sum() * scale);
+				fmt::format_to(append, "{}_count{} {}\n", name, labels, summary.count);
+				continue;
+			}
+
+			double value {0};
+			if (series.counter)
+			{
+				value += static_cast<double>(series.counter->Value());
+			}
+			if (series.gauge)
+			{
+				value += static_cast<double>(series.gauge->Value());
+			}
+			for (const auto& [id, callback] : series.callbacks)
+			{
+				value += callback();
+			}
+			fmt::format_to(append, "{}{} {}\n", name, labels, value);
+		}
+	}
+	return out;
+}
+
+MetricsRegistry::Series& MetricsRegistry::Series_(
+	MetricType type,
+	const std::string& name,
+	const std::string& help,
+	const MetricLabels& labels)
+{
+	auto [it, inserted] = m_families.try_emplace(name);
+	auto& family = it->second;
+	if (inserted)
+	{
+		family.type = type;
+		family.help = help;
+	}
+	else if (family.type != type)
+	{
+		throw std::invalid_argument(fmt::format(
+			"MetricsRegistry: \"{}\" is a {}, not a {}", name, TypeName(family.type), TypeName(type)));
+	}
+	// std::map nodes don't move, so references to the series stay valid.
+	return family.series[FormatLabels_(labels)];
+}
+
+void MetricsRegistry::RemoveCallback_(std::uint64_t id)
+{
+	std::unique_lock lock(m_mutex);
+	auto it = m_callbacks.find(id);
+	if (it != m_callbacks.end())
+	{
+		it->second->callbacks.erase(id);
+		m_callbacks.erase(it);
+	}
+}
+
+std::string MetricsRegistry::FormatLabels_(const MetricLabels& labels)
+{
+	if (labels.empty())
+	{
+		return {};
+	}
+
+	std::string out {"{"};
+	for (const auto& [name, value] : labels)
+	{
+		if (out.size() > 1)
+		{
+			out += ',';
+		}
+		out += name;
+		out += "=\"";
+		AppendEscaped(out, value, true);
+		out += '"';
+	}
+	out += '}';
+	return out;
+}
+
+MetricsRegistry& metrics()
+{
+	// Never destroyed, so components can still update their metrics while
+	// static objects are being torn down.
+	static auto registry = new MetricsRegistry;
+	return *registry;
+}
+
+} // namespace ncc
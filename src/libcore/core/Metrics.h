@@ -0,0 +1,182 @@
+#pragma once
+
+#include <core/Histogram.h>
+#include <core/InplaceFunction.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ncc
+{
+
+// Process-wide metrics in the Prometheus data model. Components look their
+// metrics up once (typically in the constructor) and keep the reference:
+//
+//    auto& received = metrics().Counter("mqtt_messages_received_total", "...", {{"client", name}});
+//    ...
+//    received.Add();
+//
+// Metrics are never removed, so references stay valid for the lifetime of the
+// process. Values owned by an object (queue depths, connection state) are
+// reported through callbacks instead, which are removed with their handle.
+// See MetricsServer for scraping.
+
+using MetricLabels = std::vector<std::pair<std::string, std::string>>;
+
+enum class MetricType
+{
+	Counter,
+	Gauge,
+	Summary,
+};
+
+// Monotonic counter sharded per thread: Add() is one relaxed fetch_add on a
+// cache line that is normally used by a single thread, so concurrent updates
+// don't contend. Value() sums the shards.
+class CounterMetric
+{
+public:
+	void Add(std::uint64_t n = 1)
+	{
+		m_shards[Shard_()].value.fetch_add(n, std::memory_order_relaxed);
+	}
+
+	std::uint64_t Value() const;
+
+private:
+	static constexpr std::size_t shardCount {16};
+
+	static std::size_t Shard_()
+	{
+		static std::atomic<std::size_t> next {0};
+		thread_local const std::size_t shard {next.fetch_add(1, std::memory_order_relaxed) % shardCount};
+		return shard;
+	}
+
+	struct alignas(64) Shard
+	{
+		std::atomic<std::uint64_t> value {0};
+	};
+
+	std::array<Shard, shardCount> m_shards {};
+};
+
+// Value that goes up and down.
+class GaugeMetric
+{
+public:
+	void Set(std::int64_t value) { m_value.store(value, std::memory_order_relaxed); }
+	void Add(std::int64_t n = 1) { m_value.fetch_add(n, std::memory_order_relaxed); }
+	void Sub(std::int64_t n = 1) { m_value.fetch_sub(n, std::memory_order_relaxed); }
+	std::int64_t Value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<std::int64_t> m_value {0};
+};
+
+class MetricsRegistry;
+
+// Keeps a callback registered; removes it when destroyed. Move-only.
+class MetricsCallback
+{
+public:
+	MetricsCallback() = default;
+	~MetricsCallback();
+
+	MetricsCallback(MetricsCallback&& other) noexcept;
+	MetricsCallback& operator=(MetricsCallback&& other) noexcept;
+
+	MetricsCallback(const MetricsCallback&) = delete;
+	MetricsCallback& operator=(const MetricsCallback&) = delete;
+
+	void Reset();
+
+private:
+	friend class MetricsRegistry;
+
+	MetricsCallback(MetricsRegistry* registry, std::uint64_t id)
+		: m_registry(registry)
+		, m_id(id)
+	{
+	}
+
+	MetricsRegistry* m_registry {nullptr};
+	std::uint64_t m_id {0};
+};
+
+class MetricsRegistry
+{
+public:
+	using Callback = InplaceFunction<double()>;
+
+	MetricsRegistry() = default;
+
+	MetricsRegistry(const MetricsRegistry&) = delete;
+	MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+	// Returns the metric "name" with "labels", creating it on first use. A
+	// name can only be used with one type; anything else is a programming
+	// error and throws std::invalid_argument.
+	CounterMetric& Counter(const std::string& name, const std::string& help, const MetricLabels& labels = {});
+	GaugeMetric& Gauge(const std::string& name, const std::string& help, const MetricLabels& labels = {});
+
+	// Exported as a Prometheus summary (p50, p90, p99, p999, sum and count).
+	// Values are recorded in nanoseconds and reported in seconds, so "name"
+	// should end in "_seconds".
+	Histogram& Summary(const std::string& name, const std::string& help, const MetricLabels& labels = {});
+
+	// Calls "callback" for the value at every scrape, with the registry locked.
+	// When several callbacks are registered for the same name and labels
+	// (i.e. two clients with the same name) their values are added up.
+	[[nodiscard]] MetricsCallback AddCallback(
+		MetricType type,
+		const std::string& name,
+		const std::string& help,
+		const MetricLabels& labels,
+		Callback callback);
+
+	// All metrics in the Prometheus text exposition format (version 0.0.4).
+	std::string Render() const;
+
+private:
+	friend class MetricsCallback;
+
+	struct Series
+	{
+		std::unique_ptr<CounterMetric> counter;
+		std::unique_ptr<GaugeMetric> gauge;
+		std::unique_ptr<Histogram> histogram;
+		std::map<std::uint64_t, Callback> callbacks;
+	};
+
+	struct Family
+	{
+		MetricType type {MetricType::Counter};
+		std::string help;
+		std::map<std::string, Series> series; // Keyed by formatted labels
+	};
+
+	Series& Series_(MetricType type, const std::string& name, const std::string& help, const MetricLabels& labels);
+	void RemoveCallback_(std::uint64_t id);
+
+	static std::string FormatLabels_(const MetricLabels& labels);
+
+private:
+	mutable std::mutex m_mutex;
+	std::map<std::string, Family> m_families;
+	std::map<std::uint64_t, Series*> m_callbacks; // Callback id => series
+	std::uint64_t m_nextCallback {1};
+};
+
+// Returns the process-wide registry.
+MetricsRegistry& metrics();
+
+} // namespace ncc
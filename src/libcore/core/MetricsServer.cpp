@@ -0,0 +1,158 @@
+#include <core/Logger.h>
+#include <core/MetricsServer.h>
+
+#include <cerrno>
+#include <string_view>
+#include <system_error>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace ncc
+{
+
+namespace
+{
+
+void SendAll(int fd, std::string_view data)
+{
+	while (!data.empty())
+	{
+		auto sent = ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+		if (sent < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (sent <= 0)
+		{
+			return;
+		}
+		data.remove_prefix(static_cast<std::size_t>(sent));
+	}
+}
+
+std::string Response(std::string_view status, std::string_view contentType, std::string_view body)
+{
+	std::string response;
+	response.reserve(body.size() + 128);
+	response += "HTTP/1.0 ";
+	response += status;
+	response += "\r\nContent-Type: ";
+	response += contentType;
+	response += "\r\nContent-Length: ";
+	response += std::to_string(body.size());
+	response += "\r\nConnection: close\r\n\r\n";
+	response += body;
+	return response;
+}
+
+} // namespace
+
+MetricsServer::MetricsServer(MetricsRegistry& registry, int port, const std::string& address)
+	: m_registry(registry)
+{
+	m_listenFd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (m_listenFd < 0)
+	{
+		throw std::system_error(errno, std::generic_category(), "MetricsServer: socket()");
+	}
+
+	int reuse {1};
+	::setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+	sockaddr_in addr {};
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(static_cast<std::uint16_t>(port));
+	if (::inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1)
+	{
+		::close(m_listenFd);
+		throw std::system_error(EINVAL, std::generic_category(), "MetricsServer: invalid address " + address);
+	}
+
+	if (::bind(m_listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0
+		|| ::listen(m_listenFd, 8) < 0)
+	{
+		int err = errno;
+		::close(m_listenFd);
+		throw std::system_error(err, std::generic_category(), "MetricsServer: bind() " + address + ":" + std::to_string(port));
+	}
+
+	socklen_t len = sizeof(addr);
+	::getsockname(m_listenFd, reinterpret_cast<sockaddr*>(&addr), &len);
+	m_port = ntohs(addr.sin_port);
+
+	logger()->info("MetricsServer: serving http://{}:{}/metrics", address, m_port);
+	m_thread = std::thread(&MetricsServer::Run_, this);
+}
+
+MetricsServer::~MetricsServer()
+{
+	m_stopping = true;
+	m_thread.join();
+	::close(m_listenFd);
+}
+
+void MetricsServer::Run_()
+{
+	while (!m_stopping)
+	{
+		// The timeout only bounds how long a stop request can go unnoticed.
+		constexpr int pollTimeoutMs {250};
+		pollfd pfd {m_listenFd, POLLIN, 0};
+		int rc = ::poll(&pfd, 1, pollTimeoutMs);
+		if (rc <= 0)
+		{
+			continue;
+		}
+
+		int fd = ::accept4(m_listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+		if (fd < 0)
+		{
+			continue;
+		}
+		Serve_(fd);
+		::close(fd);
+	}
+}
+
+void MetricsServer::Serve_(int fd)
+{
+	// A client that connects and sends nothing must not stall the server.
+	timeval timeout {1, 0};
+	::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+	// Only the request line matters; headers are read and ignored.
+	std::string request;
+	char buffer[1024];
+	while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192)
+	{
+		auto n = ::recv(fd, buffer, sizeof(buffer), 0);
+		if (n <= 0)
+		{
+			break;
+		}
+		request.append(buffer, static_cast<std::size_t>(n));
+	}
+
+	std::string_view line(request);
+	line = line.substr(0, line.find("\r\n"));
+
+	if (line.starts_with("GET /metrics ") || line.starts_with("GET / "))
+	{
+		SendAll(fd, Response("200 OK", "text/plain; version=0.0.4; charset=utf-8", m_registry.Render()));
+	}
+	else if (line.starts_with("GET "))
+	{
+		SendAll(fd, Response("404 Not Found", "text/plain", "Not found\n"));
+	}
+	else
+	{
+		SendAll(fd, Response("405 Method Not Allowed", "text/plain", "Only GET is supported\n"));
+	}
+}
+
+} // namespace ncc
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <core/Metrics.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+namespace ncc
+{
+
+// Serves MetricsRegistry::Render() for Prometheus to scrape:
+//
+//    curl http://127.0.0.1:9464/metrics
+//
+// A minimal HTTP/1.0 server on its own thread: one request per connection,
+// handled one at a time. It binds to the loopback address by default, so the
+// metrics are only visible on this host. Throws std::system_error if the
+// address can't be bound.
+class MetricsServer
+{
+public:
+	MetricsServer(MetricsRegistry& registry, int port, const std::string& address = "127.0.0.1");
+	~MetricsServer();
+
+	MetricsServer(const MetricsServer&) = delete;
+	MetricsServer& operator=(const MetricsServer&) = delete;
+
+	// The bound port; useful when constructed with port 0.
+	int Port() const { return m_port; }
+
+private:
+	void Run_();
+	void Serve_(int fd);
+
+private:
+	MetricsRegistry& m_registry;
+	int m_listenFd {-1};
+	int m_port {0};
+	std::atomic_bool m_stopping {false};
+	std::thread m_thread;
+};
+
+} // namespace ncc
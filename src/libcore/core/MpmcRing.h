@@ -0,0 +1,135 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+
+namespace ncc
+{
+
+// MpmcRing is a bounded, lock-free, multi-producer/multi-consumer queue
+// (Dmitry Vyukov's sequence-numbered ring).
+//
+// Elements are never constructed or destroyed after the ring is created.
+// Producers fill a slot in place and consumers read it in place, so element
+// types that own buffers (i.e. std::string) keep their capacity and the ring
+// doesn't allocate in steady state.
+template <typename T>
+class MpmcRing
+{
+public:
+	// "capacity" is rounded up to the next power of two.
+	explicit MpmcRing(std::size_t capacity)
+	{
+		std::size_t size {2};
+		while (size < capacity)
+		{
+			size <<= 1;
+		}
+		m_mask = size - 1;
+		m_cells = std::make_unique<Cell[]>(size);
+		for (std::size_t i = 0; i < size; ++i)
+		{
+			m_cells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	MpmcRing(const MpmcRing&) = delete;
+	MpmcRing& operator=(const MpmcRing&) = delete;
+
+	// Claims a free slot and calls fill(T&) on it. Returns false if the ring
+	// is full.
+	template <typename Fn>
+	bool TryPush(Fn&& fill)
+	{
+		Cell* cell {nullptr};
+		std::size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			cell = &m_cells[pos & m_mask];
+			std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+			auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+			if (diff == 0)
+			{
+				if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if (diff < 0)
+			{
+				return false; // Full
+			}
+			else
+			{
+				pos = m_enqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+
+		fill(cell->value);
+		cell->sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Claims the oldest element and calls consume(T&) on it. Returns false if
+	// the ring is empty.
+	template <typename Fn>
+	bool TryPop(Fn&& consume)
+	{
+		Cell* cell {nullptr};
+		std::size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			cell = &m_cells[pos & m_mask];
+			std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+			auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1);
+			if (diff == 0)
+			{
+				if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if (diff < 0)
+			{
+				return false; // Empty
+			}
+			else
+			{
+				pos = m_dequeuePos.load(std::memory_order_relaxed);
+			}
+		}
+
+		consume(cell->value);
+		cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Approximate number of queued elements (exact when quiescent).
+	std::size_t Size() const
+	{
+		std::size_t deq = m_dequeuePos.load(std::memory_order_acquire);
+		std::size_t enq = m_enqueuePos.load(std::memory_order_acquire);
+		return (enq > deq ? enq - deq : 0);
+	}
+
+	bool Empty() const { return Size() == 0; }
+	std::size_t Capacity() const { return m_mask + 1; }
+
+private:
+	struct alignas(64) Cell
+	{
+		std::atomic<std::size_t> sequence {0};
+		T value {};
+	};
+
+	std::unique_ptr<Cell[]> m_cells;
+	std::size_t m_mask {0};
+
+	alignas(64) std::atomic<std::size_t> m_enqueuePos {0};
+	alignas(64) std::atomic<std::size_t> m_dequeuePos {0};
+};
+
+} // namespace ncc
@@ -1,88 +1,220 @@
 #include <core/Logger.h>
+#include <core/Mailbox.h>
 #include <core/MqttClient.h>
 
 #include <mosquitto.h>
 
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <tuple>
+
 namespace ncc
 {
 
+namespace
+{
+
+// Set on the thread that runs the mosquitto callbacks. Publishing from that
+// thread must never block.
+thread_local bool t_networkThread {false};
+
+// Subscribers unregistered from within a dispatch on this thread (and their
+// client), which the rest of that dispatch skips; see UnregisterSub().
+thread_local int t_dispatchDepth {0};
+thread_local std::vector<std::pair<const void*, IMqttSubscriber*>> t_unregistered;
+
+// MQTT v5 user property carrying the publisher's LatencyMonitor::Now().
+constexpr const char* timestampProperty {"ts"};
+
+std::int64_t ReadTimestamp(const mosquitto_property* props)
+{
+	std::int64_t sent {0};
+	char* name {nullptr};
+	char* value {nullptr};
+	auto prop = mosquitto_property_read_string_pair(props, MQTT_PROP_USER_PROPERTY, &name, &value, false);
+	while (prop)
+	{
+		bool found = (std::string_view(name) == timestampProperty);
+		if (found)
+		{
+			std::from_chars(value, value + std::strlen(value), sent);
+		}
+		std::free(name);
+		std::free(value);
+		if (found)
+		{
+			break;
+		}
+		prop = mosquitto_property_read_string_pair(prop, MQTT_PROP_USER_PROPERTY, &name, &value, true);
+	}
+	return sent;
+}
+
+} // namespace
+
 MqttClient::MqttClient(
 		const std::string& name,
 		const std::string& host,
-		int port)
+		int port,
+		const OutboxConfig& outbox,
+		const LocalDeliveryConfig& local,
+		const ReconnectConfig& reconnect,
+		const InFlightConfig& inFlight,
+		const LatencyConfig& latency,
+		const CacheConfig& cache)
 	: m_name(name)
 	, m_host(host)
 	, m_port(port)
+	, m_reconnect(reconnect)
+	, m_random(std::random_device{}())
+	, m_disconnectedAt(std::chrono::steady_clock::now())
+	, m_local(local)
+	, m_tracker(inFlight)
+	, m_latency(latency)
+	, m_metrics {
+		metrics().Counter("mqtt_messages_received_total", "Messages received from the broker", {{"client", name}}),
+		metrics().Counter("mqtt_received_bytes_total", "Payload bytes received from the broker", {{"client", name}}),
+		metrics().Counter("mqtt_messages_sent_total", "Messages sent to the broker", {{"client", name}}),
+		metrics().Counter("mqtt_sent_bytes_total", "Payload bytes sent to the broker", {{"client", name}}),
+		metrics().Counter("mqtt_send_failed_total", "Messages mosquitto_publish() refused", {{"client", name}}),
+		metrics().Counter("mqtt_messages_delivered_locally_total", "Messages delivered to subscribers in this process", {{"client", name}}),
+		metrics().Summary("mqtt_dispatch_seconds", "Time spent calling the subscribers of one message", {{"client", name}}),
+	}
 {
+	if (outbox.capacity > 0)
+	{
+		m_outbox = std::make_unique<Outbox>(outbox);
+	}
+
+	for (const auto& filter : cache.topics)
+	{
+		m_cacheFilters.Insert(filter)->values.push_back(true);
+	}
+
 	Setup_();
 
 	constexpr bool cleanSession {true};
 	m_mosq = mosquitto_new(name.c_str(), cleanSession, this);
 
-	if (m_mosq)
+	if (!m_mosq)
+	{
+		throw std::runtime_error("Failed to create MQTT client.");
+	}
+
 	{
 		mosquitto_connect_callback_set(m_mosq, MqttClient::OnConnect);
 		mosquitto_disconnect_callback_set(m_mosq, MqttClient::OnDisconnect);
 
 		mosquitto_subscribe_callback_set(m_mosq, &MqttClient::OnSubscribe);
 		mosquitto_unsubscribe_callback_set(m_mosq, &MqttClient::OnUnsubscribe);
-//		mosquitto_publish_callback_set(m_mosq, &MqttClient::OnPublish);
+		mosquitto_publish_callback_set(m_mosq, &MqttClient::OnPublish);
 
-		mosquitto_message_callback_set(m_mosq, MqttClient::OnMessage);
+		if (m_latency.Enabled())
+		{
+			mosquitto_message_v5_callback_set(m_mosq, MqttClient::OnMessageV5);
+		}
+		else
+		{
+			mosquitto_message_callback_set(m_mosq, MqttClient::OnMessage);
+		}
 
 		mosquitto_log_callback_set(m_mosq, &MqttClient::OnLog);
 
-		// Creates one thread here and share it with multiple pubs and subs.
-		int rc = mosquitto_loop_start(m_mosq);
-		if (rc != MOSQ_ERR_SUCCESS)
+		// "No local" subscriptions, which keep the broker from echoing our
+		// own publishes back, and the timestamp property need MQTT v5.
+		if (m_local.enabled || m_latency.Enabled())
 		{
-			logger()->error("mosquitto_loop_start() failed: rc={}", rc);
-			mosquitto_disconnect(m_mosq);
-			mosquitto_destroy(m_mosq);
-			m_mosq = nullptr;
-//			Cleanup_(); // XXX: Need to test throwing an exception in ctor to see if this is needed.
-			throw std::runtime_error("Failed to start MQTT thread.");
+			mosquitto_int_option(m_mosq, MOSQ_OPT_PROTOCOL_VERSION, MQTT_PROTOCOL_V5);
 		}
 
-//		rc = mosquitto_connect(m_mosq, m_host.c_str(), m_port, 60);
+		// The connection is serviced by our own thread (see Run_()) rather
+		// than mosquitto_loop_start(), so that reconnecting is under our
+		// control. Other threads still publish and subscribe concurrently.
+		mosquitto_threaded_set(m_mosq, true);
 	}
-	Connect_();
+
+	AddMetrics_();
+
+	// One thread is shared by all the pubs and subs.
+	m_thread = std::thread(&MqttClient::Run_, this);
 }
 
 MqttClient::~MqttClient()
 {
+	m_metricCallbacks.clear();
+
+	{
+		std::unique_lock lock(m_mutex);
+		m_stopping = true;
+	}
+	m_cv.notify_all();
+
+	// Run_() keeps servicing the connection until the DISCONNECT is sent.
 	mosquitto_disconnect(m_mosq);
-	mosquitto_loop_stop(m_mosq, false);
+	m_thread.join();
 	mosquitto_destroy(m_mosq);
 
 	Cleanup_();
 }
 
-void MqttClient::RegisterSub(const std::string& topic, IMqttSubscriber* sub)
+void MqttClient::RegisterSub(const std::string& topic, IMqttSubscriber* sub, bool replay)
 {
 	logger()->trace("MqttClient::RegisterSub()");
 
-	m_subs.insert(sub);
-
-	auto topicIt = m_topicSubs.find(topic);
-	if (topicIt == m_topicSubs.end())
+	// The gate must be open before "sub" can be dispatched to.
+	replay = replay && !m_cacheFilters.Empty();
+	if (replay)
 	{
-		auto it = m_topicSubs.insert({topic, {}});
-		topicIt = it.first;
+		std::unique_lock lock(m_replayMutex);
+		auto& gate = m_replayGates[sub];
+		if (!gate)
+		{
+			gate = std::make_shared<ReplayGate>();
+			m_replaying.fetch_add(1, std::memory_order_seq_cst);
+		}
+		++gate->replays;
 	}
 
-	auto& subList = topicIt->second;
-	auto subIt = std::find(subList.begin(), subList.end(), sub);
-	if (subIt != subList.end())
+	// Builds a new snapshot; the network thread keeps dispatching with the
+	// current one until it is replaced.
+	bool added {false};
+	m_subscriptions.Update([&](Subscriptions& subscriptions) {
+		auto node = subscriptions.topics.Insert(topic);
+
+		auto& subList = node->values;
+		auto subIt = std::find(subList.begin(), subList.end(), sub);
+		if (subIt != subList.end())
+		{
+			return; // Already in list
+		}
+		subList.push_back(sub);
+		m_filters[sub].push_back(topic);
+		m_subscriberCount.store(m_filters.size(), std::memory_order_relaxed);
+		added = true;
+	});
+
+	// If we are already attached to the broker, send subscription now. Only
+	// once the snapshot is published: OnConnect_() sets m_connected before
+	// it subscribes to the snapshot's filters, so either it sees this
+	// filter or this sees the connection (or both, which is harmless).
+	if (added && m_connected)
 	{
-		return; // Already in list
+		Subscribe_(topic);
 	}
-	subList.push_back(sub);
 
-	// If we are already attached to the broker, send subscription now.
-	if (m_connected)
+	if (replay)
 	{
-		Subscribe_(topic);
+		Replay_(topic, sub);
+
+		std::unique_lock lock(m_replayMutex);
+		auto it = m_replayGates.find(sub);
+		if (--it->second->replays == 0)
+		{
+			m_replayGates.erase(it);
+			m_replaying.fetch_sub(1, std::memory_order_relaxed);
+		}
 	}
 }
 
@@ -90,33 +222,64 @@ void MqttClient::UnregisterSub(IMqttSubscriber* sub)
 {
 	logger()->trace("MqttClient::UnregisterSub()");
 
-	m_subs.erase(sub);
-
-	// A subscriber may have registered with multiple topics.
-	// While loop used to allow iterator to be deleted.
-	auto topicIt = m_topicSubs.begin();
-	while (topicIt != m_topicSubs.end())
+	// Once Update() returns, no dispatch can still be using a snapshot that
+	// contains "sub", so the caller may destroy it. Except from within a
+	// subscriber's callback: Update() can't wait for the dispatch it is
+	// called from, so dispatches already under way on other threads may
+	// still deliver to "sub". The rest of this thread's dispatch skips it.
+	if (t_dispatchDepth > 0)
 	{
-		auto& subList = topicIt->second;
-		subList.erase(
-			std::remove_if(subList.begin(), subList.end(),
-				[sub](IMqttSubscriber* s) { return s == sub; }),
-			subList.end());
+		t_unregistered.emplace_back(this, sub);
+	}
 
-		if (subList.empty())
+	m_subscriptions.Update([&](Subscriptions& subscriptions) {
+		auto it = m_filters.find(sub);
+		if (it == m_filters.end())
 		{
-			Unsubscribe_(topicIt->first);
-			topicIt = m_topicSubs.erase(topicIt);
+			return;
 		}
-		else
+
+		// A subscriber may have registered with multiple topics; only the
+		// paths to those are copied.
+		for (const auto& filter : it->second)
 		{
-			++topicIt;
+			auto node = subscriptions.topics.Find(filter);
+			if (!node)
+			{
+				continue;
+			}
+			auto& subList = node->values;
+			subList.erase(
+				std::remove(subList.begin(), subList.end(), sub),
+				subList.end());
+
+			if (subList.empty())
+			{
+				Unsubscribe_(filter);
+				subscriptions.topics.Prune(filter);
+			}
 		}
-	}
+		m_filters.erase(it);
+		m_subscriberCount.store(m_filters.size(), std::memory_order_relaxed);
+	});
+}
+
+std::vector<IMqttSubscriber*> MqttClient::Subscribers_() const
+{
+	// Only on (re)connect, so the walk doesn't matter.
+	std::vector<IMqttSubscriber*> subs;
+	auto subscriptions = m_subscriptions.Read();
+	subscriptions->topics.ForEach([&subs](const auto& node) {
+		subs.insert(subs.end(), node.values.begin(), node.values.end());
+	});
+	std::sort(subs.begin(), subs.end());
+	subs.erase(std::unique(subs.begin(), subs.end()), subs.end());
+	return subs;
 }
 
 void MqttClient::OnConnect(mosquitto*, void* obj, int rc)
 {
+	t_networkThread = true;
 	if (rc == MOSQ_ERR_SUCCESS)
 	{
 		logger()->debug("MqttClient::OnConnect(): connection established");
@@ -132,6 +295,7 @@ void MqttClient::OnConnect(mosquitto*, void* obj, int rc)
 
 void MqttClient::OnDisconnect(mosquitto*, void* obj, int rc)
 {
+	t_networkThread = true;
 	if (rc == MOSQ_ERR_SUCCESS)
 	{
 		logger()->debug("MqttClient::OnDisconnect(): connection closed");
@@ -147,6 +311,7 @@ void MqttClient::OnDisconnect(mosquitto*, void* obj, int rc)
 
 void MqttClient::OnSubscribe(mosquitto*, void* obj, int mid, int qosCount, const int* grantedQos)
 {
+	t_networkThread = true;
 	logger()->trace("MqttClient::OnSubscribe()");
 
 	auto self = reinterpret_cast<MqttClient*>(obj);
@@ -155,6 +320,7 @@ void MqttClient::OnSubscribe(mosquitto*, void* obj, int mid, int qosCount, const
 
 void MqttClient::OnUnsubscribe(mosquitto*, void* obj, int mid)
 {
+	t_networkThread = true;
 	logger()->trace("MqttClient::OnUnsubscribe()");
 
 	auto self = reinterpret_cast<MqttClient*>(obj);
@@ -163,6 +329,7 @@ void MqttClient::OnUnsubscribe(mosquitto*, void* obj, int mid)
 
 void MqttClient::OnPublish(mosquitto*, void* obj, int mid)
 {
+	t_networkThread = true;
 	logger()->trace("MqttClient::OnPublish(mid={})", mid);
 
 	auto self = reinterpret_cast<MqttClient*>(obj);
@@ -171,12 +338,21 @@ void MqttClient::OnPublish(mosquitto*, void* obj, int mid)
 
 void MqttClient::OnMessage(mosquitto*, void* obj, const mosquitto_message* msg)
 {
+	t_networkThread = true;
 //	logger()->trace("MqttClient::OnMessage()");
 
 	auto self = reinterpret_cast<MqttClient*>(obj);
 	self->OnMessage_(msg);
 }
 
+void MqttClient::OnMessageV5(mosquitto*, void* obj, const mosquitto_message* msg, const mosquitto_property* props)
+{
+	t_networkThread = true;
+
+	auto self = reinterpret_cast<MqttClient*>(obj);
+	self->OnMessage_(msg, props);
+}
+
 void MqttClient::OnLog(mosquitto*, void* obj, int level, const char* str)
 {
 #if 0
@@ -198,9 +374,30 @@ bool MqttClient::Publish(
 	int qos, // QoS: 0 => at most once, 1 => at least once, 2 => exactly once
 	bool retain,
 	const std::chrono::duration<long, std::ratio<1, 1>>& delay)
+{
+	std::string jsonstr = json.dump();
+	return Publish(topic, std::as_bytes(std::span(jsonstr)), qos, retain, delay);
+}
+
+bool MqttClient::Publish(
+	const std::string& topic,
+	std::span<const std::byte> payload,
+	int qos,
+	bool retain,
+	const std::chrono::duration<long, std::ratio<1, 1>>& delay)
 {
 //	logger()->trace("MqttClient::Publish(topic=\"{}\")", topic);
 
+	if (PublishLocal_(topic, payload))
+	{
+		return true;
+	}
+
+	if (m_outbox)
+	{
+		return PublishAsync_(topic, payload, qos, retain);
+	}
+
 	if (!m_connected)
 	{
 		std::unique_lock lock(m_mutex);
@@ -208,7 +405,7 @@ bool MqttClient::Publish(
 		if (!m_connected)
 		{
 			logger()->debug("MqttClient::Publish(): waiting to connect...");
-			if (!m_cv.wait_for(lock, delay, [this]() {return m_connected; }))
+			if (!m_cv.wait_for(lock, delay, [this]() {return m_connected.load(); }))
 			{
 				logger()->debug("MqttClient::Publish() timed out.");
 				return false;
@@ -217,16 +414,209 @@ bool MqttClient::Publish(
 	}
 
 //	logger()->debug("MqttClient::Publish(): Sending message...");
-	std::string jsonstr = json.dump();
-	int rc = mosquitto_publish(m_mosq, nullptr, topic.c_str(), jsonstr.size(), jsonstr.c_str(), qos, retain);
+	return Send_(topic, payload, qos, retain);
+}
+
+PublishToken MqttClient::PublishTracked(
+	const std::string& topic,
+	std::span<const std::byte> payload,
+	int qos,
+	bool retain)
+{
+	if (PublishLocal_(topic, payload))
+	{
+		return {};
+	}
+
+	if (!m_connected)
+	{
+		logger()->debug("MqttClient::PublishTracked(topic=\"{}\"): not connected", topic);
+		return {};
+	}
+
+	return m_tracker.Publish([&](int* mid) {
+		return Send_(topic, payload, qos, retain, mid);
+	}, !t_networkThread);
+}
+
+OutboxStats MqttClient::GetOutboxStats() const
+{
+	return (m_outbox ? m_outbox->Stats() : OutboxStats{});
+}
+
+PublishStats MqttClient::GetPublishStats() const
+{
+	return m_tracker.Stats();
+}
+
+bool MqttClient::PublishLocal_(const std::string& topic, std::span<const std::byte> payload)
+{
+	auto seq = Cache_(topic, payload);
+
+	if (!m_local.enabled)
+	{
+		return false;
+	}
+
+	// Local subscribers share this view of the caller's buffer. Mailbox
+	// subscribers take a copy; the rest are called on this thread.
+	MqttMessage message(topic, payload);
+	Dispatch_(message, m_latency.Track(topic) ? LatencyMonitor::Now() : 0, seq);
+	m_metrics.deliveredLocally.Add();
+
+	return IsLocalOnly_(topic);
+}
+
+bool MqttClient::PublishAsync_(
+	const std::string& topic,
+	std::span<const std::byte> payload,
+	int qos,
+	bool retain)
+{
+	// Send directly while connected unless older messages are still queued,
+	// so messages leave in the order they were published. A failed send
+	// (e.g. the connection dropped before OnDisconnect_() ran) is queued
+	// like any other message published while disconnected.
+	if (m_connected && m_outbox->Empty() && Send_(topic, payload, qos, retain))
+	{
+		return true;
+	}
+
+	bool queued = m_outbox->Push(topic, payload, qos, retain, !t_networkThread);
+
+	// Pairs with the fence in OnConnect_(): either this thread sees the
+	// connection and drains, or OnConnect_() sees the queued message.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (m_connected)
+	{
+		DrainOutbox_();
+	}
+	return queued;
+}
+
+bool MqttClient::Send_(
+	const std::string& topic,
+	std::span<const std::byte> payload,
+	int qos,
+	bool retain,
+	int* mid)
+{
+	int rc {MOSQ_ERR_SUCCESS};
+	if (m_latency.Matches(topic))
+	{
+		// Stamped when sent, so time spent in the outbox isn't included.
+		char sent[24] {};
+		std::to_chars(sent, sent + sizeof(sent) - 1, LatencyMonitor::Now());
+
+		mosquitto_property* props {nullptr};
+		mosquitto_property_add_string_pair(&props, MQTT_PROP_USER_PROPERTY, timestampProperty, sent);
+		rc = mosquitto_publish_v5(m_mosq, mid, topic.c_str(), payload.size(), payload.data(), qos, retain, props);
+		mosquitto_property_free_all(&props);
+	}
+	else
+	{
+		rc = mosquitto_publish(m_mosq, mid, topic.c_str(), payload.size(), payload.data(), qos, retain);
+	}
 	if (rc != MOSQ_ERR_SUCCESS)
 	{
+		m_metrics.sendFailed.Add();
 		logger()->error("MqttClient::Publish() failed: rc={}", rc);
+		return false;
 	}
-	return (rc == MOSQ_ERR_SUCCESS);
+	m_metrics.sent.Add();
+	m_metrics.sentBytes.Add(payload.size());
+	return true;
+}
+
+void MqttClient::DrainOutbox_()
+{
+	auto count = m_outbox->Drain([this](const Outbox::Message& msg) {
+		return Send_(msg.topic, msg.payload, msg.qos, msg.retain);
+	});
+	if (count > 0)
+	{
+		logger()->debug("MqttClient::DrainOutbox_(): sent {} queued message(s)", count);
+	}
+}
+
+ConnectionStats MqttClient::GetConnectionStats() const
+{
+	ConnectionStats stats;
+	stats.connected = m_connected;
+	stats.connects = m_connects.load(std::memory_order_relaxed);
+	stats.disconnects = m_disconnects.load(std::memory_order_relaxed);
+	stats.reconnectAttempts = m_reconnectAttempts.load(std::memory_order_relaxed);
+	stats.lastTimeToReconnect = std::chrono::microseconds(m_lastTimeToReconnectUs.load(std::memory_order_relaxed));
+	stats.maxTimeToReconnect = std::chrono::microseconds(m_maxTimeToReconnectUs.load(std::memory_order_relaxed));
+	stats.lastTimeToFirstMessage = std::chrono::microseconds(m_lastTimeToFirstMessageUs.load(std::memory_order_relaxed));
+	return stats;
+}
+
+std::map<std::string, LatencyStats> MqttClient::GetLatencyStats() const
+{
+	return m_latency.Stats();
 }
 
-void MqttClient::Connect_()
+void MqttClient::ResetLatencyStats()
+{
+	m_latency.Reset();
+}
+
+void MqttClient::Run_()
+{
+	t_networkThread = true;
+
+	// The first attempt is immediate; mosquitto_reconnect() reuses the host
+	// and port even if it failed.
+	bool socketOpen = Connect_();
+
+	for (;;)
+	{
+		if (m_stopping && !m_connected)
+		{
+			break;
+		}
+
+		if (!socketOpen)
+		{
+			auto delay = Backoff_();
+			std::unique_lock lock(m_mutex);
+			if (m_cv.wait_for(lock, delay, [this]() { return m_stopping.load(); }))
+			{
+				break;
+			}
+			lock.unlock();
+
+			m_reconnectAttempts.fetch_add(1, std::memory_order_relaxed);
+			int rc = mosquitto_reconnect(m_mosq);
+			if (rc != MOSQ_ERR_SUCCESS)
+			{
+				logger()->debug("MqttClient::Run_(): mosquitto_reconnect() failed: rc={}", rc);
+				continue;
+			}
+			socketOpen = true;
+		}
+
+		// Publishes and subscribes from other threads wake the loop, so the
+		// timeout only bounds how long a stop request can go unnoticed.
+		constexpr int loopTimeoutMs {1000};
+		int rc = mosquitto_loop(m_mosq, loopTimeoutMs, 1);
+		if (rc != MOSQ_ERR_SUCCESS)
+		{
+			if (!m_stopping)
+			{
+				logger()->warn("MqttClient::Run_(): connection lost: rc={}", rc);
+			}
+			socketOpen = false;
+			if (m_stopping)
+			{
+				break;
+			}
+		}
+	}
+}
+
+bool MqttClient::Connect_()
 {
 	constexpr const int keepalive = 60;
 
@@ -239,23 +629,65 @@ void MqttClient::Connect_()
 	{
 		logger()->error("MqttClient::mosquitto_connect() failed: rc={}", rc);
 	}
+	return (rc == MOSQ_ERR_SUCCESS);
+}
+
+std::chrono::milliseconds MqttClient::Backoff_()
+{
+	// Exponential backoff, capped, with up to half of the delay removed at
+	// random ("equal jitter").
+	auto delay = m_reconnect.initialDelay;
+	for (int i = 0; i < m_attempt && delay < m_reconnect.maxDelay; ++i)
+	{
+		delay *= 2;
+	}
+	delay = std::min(delay, m_reconnect.maxDelay);
+	++m_attempt;
+
+	std::uniform_int_distribution<long> jitter(0, delay.count() / 2);
+	return delay - std::chrono::milliseconds(jitter(m_random));
 }
 
-// TODO: Support connection disconnections and reconnections
 void MqttClient::OnConnect_(int rc)
 {
 	logger()->trace("MqttClient::OnConnect_()");
 	if (rc == MOSQ_ERR_SUCCESS)
 	{
+		auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now() - m_disconnectedAt).count();
+		m_lastTimeToReconnectUs.store(elapsed, std::memory_order_relaxed);
+		if (elapsed > m_maxTimeToReconnectUs.load(std::memory_order_relaxed))
+		{
+			m_maxTimeToReconnectUs.store(elapsed, std::memory_order_relaxed);
+		}
+		m_connects.fetch_add(1, std::memory_order_relaxed);
+		if (m_everConnected)
+		{
+			logger()->info("MqttClient::OnConnect_(): reconnected after {} attempt(s) in {} ms", m_attempt, elapsed / 1000);
+		}
+		m_everConnected = true;
+		m_attempt = 0;
+		m_awaitingFirstMessage = true;
+
+		// Unacknowledged messages are resent on the new connection.
+		m_tracker.Rearm();
+
 		m_connected = true;
+		std::atomic_thread_fence(std::memory_order_seq_cst);
 
 		Subscribe_();
 
-		for (auto sub : m_subs)
+		for (auto sub : Subscribers_())
 		{
 			sub->OnConnect(rc);
 		}
 
+		// Send whatever was published while disconnected.
+		if (m_outbox)
+		{
+			DrainOutbox_();
+		}
+
 		// Notify publishers that they can send messages.
 		m_cv.notify_all();
 	}
@@ -264,13 +696,18 @@ void MqttClient::OnConnect_(int rc)
 void MqttClient::OnDisconnect_(int rc)
 {
 	logger()->trace("MqttClient::OnDisconnect_()");
-	if (rc == MOSQ_ERR_SUCCESS)
+
+	// rc is zero when we asked to disconnect; otherwise the connection was
+	// lost and Run_() reconnects.
+	if (m_connected)
 	{
 		m_connected = false;
+		m_disconnectedAt = std::chrono::steady_clock::now();
+		m_disconnects.fetch_add(1, std::memory_order_relaxed);
 
-//		Unsubscribe_(); // ???
+		// Subscriptions are resent by OnConnect_() (clean session).
 
-		for (auto sub : m_subs)
+		for (auto sub : Subscribers_())
 		{
 			sub->OnDisconnect(rc);
 		}
@@ -292,24 +729,51 @@ void MqttClient::OnUnsubscribe_(int mid)
 
 void MqttClient::OnPublish_(int mid)
 {
-	logger()->trace("MqttClient::OnPublish_(mid={})", mid);
+	m_tracker.OnAck(mid);
 }
 
 void MqttClient::Subscribe_()
 {
 	logger()->trace("MqttClient::Subscribe_()");
 
-	for (auto [topic, subs] : m_topicSubs)
+	// Resubscribe with as few SUBSCRIBE packets as possible. The filters
+	// point into the snapshot, which stays alive until we return.
+	auto subscriptions = m_subscriptions.Read();
+	std::vector<char*> filters;
+	subscriptions->topics.ForEach([&filters](const auto& node) {
+		filters.push_back(const_cast<char*>(node.filter.c_str()));
+	});
+
+	// Keeps each packet well below the broker's default size limits.
+	constexpr std::size_t batchSize {256};
+	constexpr int qos {0};
+	int options = (m_local.enabled ? MQTT_SUB_OPT_NO_LOCAL : 0);
+	for (std::size_t i = 0; i < filters.size(); i += batchSize)
 	{
-		Subscribe_(topic);
+		int count = static_cast<int>(std::min(batchSize, filters.size() - i));
+		int rc = mosquitto_subscribe_multiple(m_mosq, nullptr, count, filters.data() + i, qos, options, nullptr);
+		if (rc != MOSQ_ERR_SUCCESS)
+		{
+			logger()->error("MqttClient::Subscribe_(): mosquitto_subscribe_multiple() failed: rc={}", rc);
+		}
 	}
+	logger()->debug("MqttClient::Subscribe_(): subscribed to {} topic(s)", filters.size());
 }
 
 void MqttClient::Subscribe_(const std::string& topic, int qos)
 {
 	logger()->trace("MqttClient::Subscribe_(\"{}\")", topic);
 
-	int rc = mosquitto_subscribe(m_mosq, nullptr, topic.c_str(), qos);
+	int rc {MOSQ_ERR_SUCCESS};
+	if (m_local.enabled)
+	{
+		// Messages published by this client were already delivered locally.
+		rc = mosquitto_subscribe_v5(m_mosq, nullptr, topic.c_str(), qos, MQTT_SUB_OPT_NO_LOCAL, nullptr);
+	}
+	else
+	{
+		rc = mosquitto_subscribe(m_mosq, nullptr, topic.c_str(), qos);
+	}
 	if (rc != MOSQ_ERR_SUCCESS)
 	{
 		logger()->error("MqttClient::Subscribe_(): mosquitto_subscribe() failed: rc={}", rc);
@@ -327,34 +791,235 @@ void MqttClient::Unsubscribe_(const std::string& topic)
 	}
 }
 
-void MqttClient::OnMessage_(const mosquitto_message* msg)
+void MqttClient::OnMessage_(const mosquitto_message* msg, const mosquitto_property* props)
 {
 //	logger()->trace("MqttClient::OnMessage_()");
 	if (msg)
 	{
-		std::string jsonstr(reinterpret_cast<char*>(msg->payload), msg->payloadlen);
-		auto json = nlohmann::json::parse(jsonstr);
+		// The payload is only parsed if a subscriber asks for the JSON.
+		MqttMessage message(
+			msg->topic,
+			{static_cast<const std::byte*>(msg->payload), static_cast<std::size_t>(msg->payloadlen)});
+
+//		logger()->debug("MqttClient::OnMessage_(topic=\"{}\", payload=\"{}\")", message.Topic(), message.PayloadString());
+
+		if (m_awaitingFirstMessage)
+		{
+			m_awaitingFirstMessage = false;
+			auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+				std::chrono::steady_clock::now() - m_disconnectedAt).count();
+			m_lastTimeToFirstMessageUs.store(elapsed, std::memory_order_relaxed);
+		}
+
+		m_metrics.received.Add();
+		m_metrics.receivedBytes.Add(message.Payload().size());
+
+		auto seq = Cache_(message.Topic(), message.Payload());
+
+		// The property list is only walked for topics being measured.
+		std::int64_t sent {0};
+		if (props && m_latency.Track(message.Topic()))
+		{
+			sent = ReadTimestamp(props);
+		}
+		Dispatch_(message, sent, seq);
+	}
+}
+
+void MqttClient::Dispatch_(const MqttMessage& message, std::int64_t sent, std::uint64_t seq)
+{
+	auto delivered = (sent != 0 ? LatencyMonitor::Now() : 0);
+	auto start = std::chrono::steady_clock::now();
+
+	// Lock-free snapshot of the subscriptions; writers never modify it.
+	auto subscriptions = m_subscriptions.Read();
+
+	// Handlers may publish, i.e. dispatch again on this thread.
+	struct Depth
+	{
+		Depth() { ++t_dispatchDepth; }
+		~Depth()
+		{
+			if (--t_dispatchDepth == 0)
+			{
+				t_unregistered.clear();
+			}
+		}
+	} depth;
 
-//		logger()->debug("MqttClient::OnMessage_(topic=\"{}\", json=\"{}\")", msg->topic, jsonstr);
+	// Mailbox subscribers record "handled" themselves, once their handler
+	// has returned.
+	bool calledDirectly {false};
 
-//		int msgSentCount {0};
-		for (auto [topic, subs] : m_topicSubs)
+//	int msgSentCount {0};
+	subscriptions->topics.Match(message.Topic(), [&](const auto& node) {
+		for (auto sub : node.values)
 		{
-			bool match {false};
-			int rc = mosquitto_topic_matches_sub(topic.c_str(), msg->topic, &match);
-			if (rc == MOSQ_ERR_SUCCESS && match)
+			if (!t_unregistered.empty() &&
+				std::find(t_unregistered.begin(), t_unregistered.end(), std::pair<const void*, IMqttSubscriber*> {this, sub}) != t_unregistered.end())
 			{
-				for (auto subIt = subs.begin(); subIt != subs.end(); ++subIt)
-				{
-					(*subIt)->OnMessage(msg->topic, json);
-//					++msgSentCount;
-				}
+				continue; // Unregistered by an earlier handler
 			}
+
+			calledDirectly |= Deliver_(sub, message, seq, sent);
+//			++msgSentCount;
+		}
+	});
+//	logger()->debug("MqttClient()::Dispatch_(): Sub::OnMessage() called {} time(s)", msgSentCount);
+
+	m_metrics.dispatchTime.Record(std::chrono::steady_clock::now() - start);
+	if (sent != 0)
+	{
+		m_latency.RecordDelivery(message.Topic(), sent, delivered);
+		if (calledDirectly)
+		{
+			m_latency.RecordHandled(message.Topic(), sent, LatencyMonitor::Now());
 		}
-//		logger()->debug("MqttClient()::OnMessage_(): Sub::OnMessage() called {} time(s)", msgSentCount);
 	}
 }
 
+bool MqttClient::GetLatest(const std::string& topic, std::vector<std::byte>& payload) const
+{
+	std::unique_lock lock(m_cacheMutex);
+	auto it = m_cache.find(topic);
+	if (it == m_cache.end())
+	{
+		return false;
+	}
+	payload.assign(it->second.payload.begin(), it->second.payload.end());
+	return true;
+}
+
+bool MqttClient::Deliver_(IMqttSubscriber* sub, const MqttMessage& message, std::uint64_t seq, std::int64_t sent)
+{
+	std::shared_ptr<ReplayGate> gate;
+	if (seq != 0 && m_replaying.load(std::memory_order_seq_cst) > 0)
+	{
+		std::unique_lock lock(m_replayMutex);
+		if (auto it = m_replayGates.find(sub); it != m_replayGates.end())
+		{
+			gate = it->second;
+		}
+	}
+
+	std::unique_lock<std::mutex> gateLock;
+	if (gate)
+	{
+		gateLock = std::unique_lock(gate->mutex);
+		auto it = gate->delivered.find(message.Topic());
+		if (it == gate->delivered.end())
+		{
+			it = gate->delivered.emplace(std::string(message.Topic()), 0).first;
+		}
+		if (it->second >= seq)
+		{
+			return false; // It already got this message or a newer one.
+		}
+		it->second = seq;
+	}
+
+	if (auto mailbox = sub->GetMailbox())
+	{
+		if (!mailbox->Post(message, sent != 0 ? &m_latency : nullptr, sent))
+		{
+			logger()->warn("MqttClient::Deliver_(topic=\"{}\"): mailbox \"{}\" is full, message dropped", message.Topic(), mailbox->Name());
+		}
+		return false;
+	}
+	if (gateLock)
+	{
+		gateLock.unlock();
+	}
+
+	// Exceptions must not escape into the mosquitto callback or the
+	// publisher.
+	try
+	{
+		sub->OnRawMessage(message);
+	}
+	catch (const std::exception& e)
+	{
+		logger()->error("MqttClient::Deliver_(topic=\"{}\"): caught: {}", message.Topic(), e.what());
+	}
+	return true;
+}
+
+bool MqttClient::IsCached_(std::string_view topic) const
+{
+	bool match {false};
+	if (!m_cacheFilters.Empty())
+	{
+		m_cacheFilters.Match(topic, [&match](const auto&) { match = true; });
+	}
+	return match;
+}
+
+std::uint64_t MqttClient::Cache_(std::string_view topic, std::span<const std::byte> payload)
+{
+	if (!IsCached_(topic))
+	{
+		return 0;
+	}
+
+	std::unique_lock lock(m_cacheMutex);
+	auto seq = ++m_cacheSeq;
+	auto it = m_cache.find(topic);
+	if (payload.empty())
+	{
+		if (it != m_cache.end())
+		{
+			m_cache.erase(it);
+		}
+		return seq;
+	}
+
+	if (it == m_cache.end())
+	{
+		it = m_cache.emplace(std::string(topic), CacheEntry {}).first;
+	}
+	// assign() reuses the entry's capacity, so steady state doesn't allocate.
+	it->second.payload.assign(payload.begin(), payload.end());
+	it->second.seq = seq;
+	return seq;
+}
+
+void MqttClient::Replay_(const std::string& filter, IMqttSubscriber* sub)
+{
+	// "sub" is already registered, so its publisher may deliver a newer
+	// message while this replays. Both go through the subscriber's gate (see
+	// ReplayGate), which drops whichever is older, so the replay never
+	// overtakes a live message. Nothing is locked while a handler runs.
+	std::vector<std::tuple<std::string, std::vector<std::byte>, std::uint64_t>> entries;
+	{
+		std::unique_lock lock(m_cacheMutex);
+		for (const auto& [topic, entry] : m_cache)
+		{
+			if (IsTopicMatch(filter, topic))
+			{
+				entries.emplace_back(topic, entry.payload, entry.seq);
+			}
+		}
+	}
+
+	for (const auto& [topic, payload, seq] : entries)
+	{
+		Deliver_(sub, MqttMessage(topic, payload), seq, 0);
+	}
+}
+
+bool MqttClient::IsLocalOnly_(const std::string& topic) const
+{
+	for (const auto& filter : m_local.localOnly)
+	{
+		bool match {false};
+		if (mosquitto_topic_matches_sub(filter.c_str(), topic.c_str(), &match) == MOSQ_ERR_SUCCESS && match)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
 void MqttClient::OnLog_(int level, const char* str)
 {
 	switch (level)
@@ -375,18 +1040,6 @@ void MqttClient::OnLog_(int level, const char* str)
 	}
 }
 
-#if 0
-void MqttClient::Run_()
-{
-	int m_running {true};
-
-	while (m_running)
-	{
-		int rc = mosquitto_loop(m_mosq, -1, 1);
-	}
-}
-#endif
-
 bool MqttClient::IsTopicMatch(const std::string& sub, const std::string& topic)
 {
 	bool match {false};
@@ -394,6 +1047,41 @@ bool MqttClient::IsTopicMatch(const std::string& sub, const std::string& topic)
 	return (rc == MOSQ_ERR_SUCCESS && match);
 }
 
+void MqttClient::AddMetrics_()
+{
+	auto& registry = metrics();
+	const MetricLabels labels {{"client", m_name}};
+	auto add = [&](MetricType type, const std::string& name, const std::string& help, MetricsRegistry::Callback fn) {
+		m_metricCallbacks.push_back(registry.AddCallback(type, name, help, labels, std::move(fn)));
+	};
+
+	add(MetricType::Gauge, "mqtt_connected", "1 while connected to the broker",
+		[this]() { return m_connected ? 1.0 : 0.0; });
+	add(MetricType::Counter, "mqtt_connects_total", "Connections accepted by the broker",
+		[this]() { return static_cast<double>(m_connects.load(std::memory_order_relaxed)); });
+	add(MetricType::Counter, "mqtt_disconnects_total", "Connections lost or closed",
+		[this]() { return static_cast<double>(m_disconnects.load(std::memory_order_relaxed)); });
+	add(MetricType::Counter, "mqtt_reconnect_attempts_total", "Reconnect attempts",
+		[this]() { return static_cast<double>(m_reconnectAttempts.load(std::memory_order_relaxed)); });
+	add(MetricType::Gauge, "mqtt_subscribers", "Registered subscribers",
+		[this]() { return static_cast<double>(m_subscriberCount.load(std::memory_order_relaxed)); });
+	add(MetricType::Gauge, "mqtt_publish_in_flight", "Tracked publishes waiting for their ack",
+		[this]() { return static_cast<double>(m_tracker.Stats().inFlight); });
+	add(MetricType::Counter, "mqtt_publish_expired_total", "Tracked publishes given up on without an ack",
+		[this]() { return static_cast<double>(m_tracker.Stats().expired); });
+
+	if (m_outbox)
+	{
+		add(MetricType::Gauge, "mqtt_outbox_depth", "Messages queued in the outbox",
+			[this]() { return static_cast<double>(m_outbox->Stats().depth); });
+		add(MetricType::Counter, "mqtt_outbox_dropped_total", "Messages dropped by the outbox",
+			[this]() {
+				auto stats = m_outbox->Stats();
+				return static_cast<double>(stats.droppedOldest + stats.droppedNewest + stats.timedOut + stats.sendFailed);
+			});
+	}
+}
+
 void MqttClient::Setup_()
 {
 	logger()->debug("MqttClient::Setup_(): count={}", Counter<MqttClient>::HowMany());
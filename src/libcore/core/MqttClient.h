@@ -3,10 +3,23 @@
 #include <core/Counter.h>
 #include <core/IMqttSubscriber.h>
 #include <core/IMqttClient.h>
+#include <core/LatencyMonitor.h>
+#include <core/Metrics.h>
+#include <core/Outbox.h>
+#include <core/PublishTracker.h>
+#include <core/Rcu.h>
+#include <core/TopicTrie.h>
 
+#include <atomic>
 #include <condition_variable>
-#include <set>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include <mosquitto.h>
 #include <nlohmann/json.hpp>
@@ -16,6 +29,36 @@ using namespace std::chrono_literals;
 namespace ncc
 {
 
+struct LocalDeliveryConfig
+{
+	// Deliver messages published by this client directly to the subscribers
+	// in this process, without the round trip through the broker. The broker
+	// is asked not to echo them back (MQTT v5 "no local"), so each subscriber
+	// still receives a message once.
+	bool enabled {false};
+
+	// Topic filters whose messages only have subscribers in this process.
+	// They are delivered locally and never sent to the broker.
+	std::vector<std::string> localOnly;
+};
+
+struct CacheConfig
+{
+	// Topic filters whose newest payload is kept for GetLatest() and for
+	// replay to new subscribers (see RegisterSub()). Messages on other topics
+	// aren't copied.
+	std::vector<std::string> topics;
+};
+
+struct ReconnectConfig
+{
+	// The delay before each reconnect attempt doubles from "initialDelay" up
+	// to "maxDelay". A random jitter of up to half the delay is subtracted so
+	// that many clients don't hit a restarted broker at the same time.
+	std::chrono::milliseconds initialDelay {10ms};
+	std::chrono::milliseconds maxDelay {5000ms};
+};
+
 class MqttClient
 	: private Counter<MqttClient>	// Initialize mosquitto library only once
 	, public IMqttClient
@@ -24,16 +67,24 @@ public:
 	MqttClient(
 		const std::string& name,
 		const std::string& host = "localhost",
-		int port = 1883);
+		int port = 1883,
+		const OutboxConfig& outbox = {},
+		const LocalDeliveryConfig& local = {},
+		const ReconnectConfig& reconnect = {},
+		const InFlightConfig& inFlight = {},
+		const LatencyConfig& latency = {},
+		const CacheConfig& cache = {});
 
 	~MqttClient();
 
-	void RegisterSub(const std::string& topic, IMqttSubscriber* sub) override;
+	void RegisterSub(const std::string& topic, IMqttSubscriber* sub, bool replay = false) override;
 	void UnregisterSub(IMqttSubscriber* sub) override;
 	bool IsConnected() const override;
 
 	bool IsTopicMatch(const std::string& sub, const std::string& topic) override;
 
+	using IMqttClient::Publish;
+
 	bool Publish(
 		const std::string& topic,
 		const nlohmann::json& json,
@@ -41,6 +92,27 @@ public:
 		bool retain = false,
 		const std::chrono::duration<long, std::ratio<1, 1>>& delay = 5s) override;
 
+	bool Publish(
+		const std::string& topic,
+		std::span<const std::byte> payload,
+		int qos = 0,
+		bool retain = false,
+		const std::chrono::duration<long, std::ratio<1, 1>>& delay = 5s) override;
+
+	PublishToken PublishTracked(
+		const std::string& topic,
+		std::span<const std::byte> payload,
+		int qos = 1,
+		bool retain = false) override;
+
+	OutboxStats GetOutboxStats() const override;
+	PublishStats GetPublishStats() const override;
+	ConnectionStats GetConnectionStats() const override;
+	std::map<std::string, LatencyStats> GetLatencyStats() const override;
+	void ResetLatencyStats() override;
+
+	bool GetLatest(const std::string& topic, std::vector<std::byte>& payload) const override;
+
 public:
 	static void OnConnect(mosquitto*, void* obj, int rc);
 	static void OnDisconnect(mosquitto*, void* obj, int rc);
@@ -48,12 +120,19 @@ public:
 	static void OnUnsubscribe(mosquitto*, void* obj, int mid);
 	static void OnPublish(mosquitto*, void* obj, int mid);
 	static void OnMessage(mosquitto*, void* obj, const mosquitto_message* msg);
+	static void OnMessageV5(mosquitto*, void* obj, const mosquitto_message* msg, const mosquitto_property* props);
 	static void OnLog(mosquitto*, void* obj, int level, const char* str);
 
 private:
-	void Connect_();
+	// Services the connection: runs the mosquitto loop while connected and
+	// reconnects with backoff when the connection is lost.
+	void Run_();
+	bool Connect_();
+	std::chrono::milliseconds Backoff_();
+
+	// Every registered subscriber once, from the current snapshot.
+	std::vector<IMqttSubscriber*> Subscribers_() const;
 
-	// TODO: Support connection disconnections and reconnections
 	void OnConnect_(int rc);
 	void OnDisconnect_(int rc);
 
@@ -63,12 +142,35 @@ private:
 	void Subscribe_();
 	void Subscribe_(const std::string& topic, int qos = 0);
 	void Unsubscribe_(const std::string& topic);
-	void OnMessage_(const mosquitto_message* msg);
+	void OnMessage_(const mosquitto_message* msg, const mosquitto_property* props = nullptr);
 	void OnLog_(int level, const char* str);
 
+	// Calls every subscriber whose filter matches the message's topic.
+	// "sent" is the publisher's timestamp (see LatencyMonitor), 0 if unknown.
+	// "seq" is the message's cache sequence number, 0 if it isn't cached.
+	void Dispatch_(const MqttMessage& message, std::int64_t sent = 0, std::uint64_t seq = 0);
+	bool IsLocalOnly_(const std::string& topic) const;
+
+	// Posts "message" to the subscriber's mailbox, or calls it. Returns true
+	// if it was called. While it is being replayed to, a cached message
+	// that isn't newer than one it already got is dropped.
+	bool Deliver_(IMqttSubscriber* sub, const MqttMessage& message, std::uint64_t seq, std::int64_t sent);
+
+	bool IsCached_(std::string_view topic) const;
+	// Returns the message's sequence number, 0 if the topic isn't cached.
+	std::uint64_t Cache_(std::string_view topic, std::span<const std::byte> payload);
+	void Replay_(const std::string& filter, IMqttSubscriber* sub);
+
+	// Caches the message and delivers it to local subscribers. Returns true
+	// if it must not be sent to the broker.
+	bool PublishLocal_(const std::string& topic, std::span<const std::byte> payload);
+	bool PublishAsync_(const std::string& topic, std::span<const std::byte> payload, int qos, bool retain);
+	bool Send_(const std::string& topic, std::span<const std::byte> payload, int qos, bool retain, int* mid = nullptr);
+	void DrainOutbox_();
+
 private:
-	// May want to use our own thread to service mosquitto messages.
-//	void Run_();
+	// Registers the client's metrics, labelled with its name.
+	void AddMetrics_();
 
 	// Uses Counter class to call moquitto library setup and cleanup functions
 	// only once.
@@ -84,10 +186,94 @@ private:
 
 	std::mutex m_mutex;
 	std::condition_variable m_cv;
-	bool m_connected {false}; // TODO: add support for connection reconnections
+	std::atomic_bool m_connected {false};
+	std::atomic_bool m_stopping {false};
+
+	// Network thread state.
+	std::thread m_thread;
+	const ReconnectConfig m_reconnect;
+	std::minstd_rand m_random;
+	int m_attempt {0};
+	bool m_everConnected {false};
+	bool m_awaitingFirstMessage {true};
+	std::chrono::steady_clock::time_point m_disconnectedAt;
+
+	std::atomic<std::uint64_t> m_connects {0};
+	std::atomic<std::uint64_t> m_disconnects {0};
+	std::atomic<std::uint64_t> m_reconnectAttempts {0};
+	std::atomic<std::int64_t> m_lastTimeToReconnectUs {0};
+	std::atomic<std::int64_t> m_maxTimeToReconnectUs {0};
+	std::atomic<std::int64_t> m_lastTimeToFirstMessageUs {0};
+
+	// Set when OutboxConfig::capacity > 0. Publish() then never waits for the
+	// connection; messages are queued here until they can be sent.
+	std::unique_ptr<Outbox> m_outbox;
+
+	const LocalDeliveryConfig m_local;
+
+	PublishTracker m_tracker;
+	LatencyMonitor m_latency;
+
+	// Last-value cache: the newest payload of every topic matching one of
+	// CacheConfig::topics, published or received. Entries are overwritten in
+	// place and removed by an empty payload, like retained messages. Every
+	// cached message gets the next sequence number.
+	struct CacheEntry
+	{
+		std::vector<std::byte> payload;
+		std::uint64_t seq {0};
+	};
+	TopicTrie<bool> m_cacheFilters;
+	mutable std::mutex m_cacheMutex;
+	std::map<std::string, CacheEntry, std::less<>> m_cache;
+	std::uint64_t m_cacheSeq {0};
+
+	// Subscribers being replayed to. Every message on a cached topic is
+	// delivered to them through their gate, which remembers the newest
+	// sequence number each topic delivered, so that a replayed message and a
+	// live one are never delivered out of order. The gate is only locked to
+	// decide and to post to a mailbox, never while a handler runs.
+	struct ReplayGate
+	{
+		std::mutex mutex;
+		std::map<std::string, std::uint64_t, std::less<>> delivered;
+		int replays {0}; // Guarded by m_replayMutex
+	};
+	std::mutex m_replayMutex;
+	std::unordered_map<IMqttSubscriber*, std::shared_ptr<ReplayGate>> m_replayGates;
+	std::atomic<std::size_t> m_replaying {0};
+
+	// Subscription state is read by the network thread while plugin and UI
+	// threads add and remove subscribers. Each change publishes a new
+	// immutable snapshot (see Rcu). The trie shares its unchanged nodes with
+	// the previous snapshot, so a change costs the depth of its filter, not
+	// the number of subscriptions.
+	struct Subscriptions
+	{
+		TopicTrie<IMqttSubscriber*> topics;
+	};
+	Rcu<Subscriptions> m_subscriptions;
+
+	// Each subscriber's filters, so that UnregisterSub() only visits those.
+	// Only used by the Update() functions, which are serialized.
+	std::unordered_map<IMqttSubscriber*, std::vector<std::string>> m_filters;
+	std::atomic<std::size_t> m_subscriberCount {0};
+
+	// Hot path metrics; see AddMetrics_() for the rest.
+	struct Metrics
+	{
+		CounterMetric& received;
+		CounterMetric& receivedBytes;
+		CounterMetric& sent;
+		CounterMetric& sentBytes;
+		CounterMetric& sendFailed;
+		CounterMetric& deliveredLocally;
+		Histogram& dispatchTime;
+	};
+	Metrics m_metrics;
 
-	std::set<IMqttSubscriber*> m_subs;
-	std::map<std::string, std::vector<IMqttSubscriber*>> m_topicSubs;
+	// Callbacks read the members above, so they are removed first.
+	std::vector<MetricsCallback> m_metricCallbacks;
 };
 
 } // namespace ncc
@@ -0,0 +1,56 @@
+#include <core/Logger.h>
+#include <core/Metrics.h>
+#include <core/MqttMessage.h>
+
+#include <chrono>
+
+namespace ncc
+{
+
+MqttMessage::MqttMessage(std::string_view topic, std::span<const std::byte> payload)
+	: m_topic(topic)
+	, m_payload(payload)
+{
+}
+
+std::string_view MqttMessage::PayloadString() const
+{
+	return {reinterpret_cast<const char*>(m_payload.data()), m_payload.size()};
+}
+
+const std::string& MqttMessage::TopicString() const
+{
+	if (!m_topicString)
+	{
+		m_topicString.emplace(m_topic);
+	}
+	return *m_topicString;
+}
+
+const nlohmann::json* MqttMessage::Json() const
+{
+	if (!m_parsed)
+	{
+		m_parsed = true;
+
+		static auto& parseTime = metrics().Summary(
+			"mqtt_json_parse_seconds", "Time spent parsing MQTT payloads as JSON");
+		auto start = std::chrono::steady_clock::now();
+
+		auto payload = PayloadString();
+		constexpr bool allowExceptions {false};
+		auto json = nlohmann::json::parse(payload.begin(), payload.end(), nullptr, allowExceptions);
+		parseTime.Record(std::chrono::steady_clock::now() - start);
+		if (json.is_discarded())
+		{
+			logger()->debug("MqttMessage::Json(): topic=\"{}\": payload is not valid JSON", m_topic);
+		}
+		else
+		{
+			m_json.emplace(std::move(json));
+		}
+	}
+	return (m_json ? &*m_json : nullptr);
+}
+
+} // namespace ncc
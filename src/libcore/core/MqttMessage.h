@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include <nlohmann/json.hpp>
+
+namespace ncc
+{
+
+// MqttMessage is a read-only view of an incoming message that is shared by
+// every subscriber the message is dispatched to.
+//
+// Nothing is copied when the message is created. The topic string and the
+// JSON document are only built the first time a subscriber asks for them and
+// are then reused by the remaining subscribers, so subscribers that only look
+// at the topic or the raw payload pay nothing for parsing.
+//
+// The message (and the views it returns) are only valid for the duration of
+// the OnRawMessage() call.
+class MqttMessage
+{
+public:
+	MqttMessage(std::string_view topic, std::span<const std::byte> payload);
+
+	MqttMessage(const MqttMessage&) = delete;
+	MqttMessage& operator=(const MqttMessage&) = delete;
+
+	std::string_view Topic() const { return m_topic; }
+	std::span<const std::byte> Payload() const { return m_payload; }
+	std::string_view PayloadString() const;
+
+	// Topic as a std::string for APIs that need one. Built at most once.
+	const std::string& TopicString() const;
+
+	// Parses the payload the first time it is called. Returns nullptr if the
+	// payload isn't valid JSON; parse errors never throw.
+	const nlohmann::json* Json() const;
+
+private:
+	std::string_view m_topic;
+	std::span<const std::byte> m_payload;
+
+	mutable std::optional<std::string> m_topicString;
+	mutable std::optional<nlohmann::json> m_json;
+	mutable bool m_parsed {false};
+};
+
+} // namespace ncc
@@ -1,106 +1,201 @@
 #include <core/Logger.h>
+#include <core/Metrics.h>
 #include <core/Notifier.h>
 
-#include <mosquitto.h>
-
 namespace ncc
 {
 
-bool Notifier::Add(const std::string& topic, MethodHandle callback)
+INotifier::Token Notifier::Add(const std::string& topic, MethodHandle callback)
 {
-	// Find "topic" and create it if it doesn't yet exist.
-	auto itTopic = m_topicHandlers.find(topic);
-	if (itTopic == m_topicHandlers.end())
+	std::uint32_t index {0};
+	if (!m_freeSlots.empty())
 	{
-		auto it = m_topicHandlers.insert({topic, {}});
-		itTopic = it.first;
+		index = m_freeSlots.back();
+		m_freeSlots.pop_back();
+	}
+	else
+	{
+		index = static_cast<std::uint32_t>(m_slots.size());
+		m_slots.emplace_back();
 	}
 
-	// Check to see if callback already in list.
-	auto& methods = itTopic->second;
+	// Find "topic" and create it if it doesn't yet exist.
+	auto node = m_topicHandlers.Insert(topic);
 
-	auto it = find_if(methods.begin(), methods.end(), [&](const MethodHandle& f) {
-		return f.target<decltype(callback)>() == &callback;
-	});
-	if (it != methods.end())
+	Slot& slot = m_slots[index];
+	slot.callback = std::move(callback);
+	slot.node = node;
+	slot.pos = static_cast<std::uint32_t>(node->values.size());
+	node->values.push_back(index);
+
+	return (static_cast<Token>(slot.generation) << 32) | index;
+}
+
+bool Notifier::Remove(const std::string& topic)
+{
+	auto node = m_topicHandlers.Find(topic);
+	if (!node || node->values.empty())
 	{
 		return false;
 	}
 
-	methods.push_back(std::move(callback));
-	return true;
+	// Release_() swaps the last value into the removed position, so always
+	// release from the back.
+	bool removed {false};
+	for (auto i = node->values.size(); i > 0; --i)
+	{
+		std::uint32_t index = node->values[i - 1];
+		Slot& slot = m_slots[index];
+		if (slot.removed)
+		{
+			continue;
+		}
+		removed = true;
+		if (m_notifyDepth > 0)
+		{
+			slot.removed = true;
+			m_deferred.push_back(index);
+		}
+		else
+		{
+			Release_(index);
+		}
+	}
+	return removed;
 }
 
-bool Notifier::Remove(const std::string& topic)
+bool Notifier::Remove(Token token)
 {
-	return m_topicHandlers.erase(topic) == 1;
+	Slot* slot = FindSlot_(token);
+	if (!slot || slot->removed)
+	{
+		return false;
+	}
+
+	auto index = static_cast<std::uint32_t>(token & 0xffffffff);
+	if (m_notifyDepth > 0)
+	{
+		slot->removed = true;
+		m_deferred.push_back(index);
+	}
+	else
+	{
+		Release_(index);
+	}
+	return true;
 }
 
-bool Notifier::Remove(const std::string& topic, MethodHandle callback)
+void Notifier::Notify(const std::string& topic, const nlohmann::json& json)
 {
-	auto itTopic = m_topicHandlers.find(topic);
-	if (itTopic != m_topicHandlers.end())
-	{
-		auto& methods = itTopic->second;
+	static auto& notifications = metrics().Counter("notifier_notifications_total", "Calls to Notifier::Notify()");
+	static auto& calls = metrics().Counter("notifier_callbacks_total", "Callbacks called by Notifier::Notify()");
+	static auto& errors = metrics().Counter("notifier_callback_errors_total", "Exceptions thrown by Notifier callbacks");
+	notifications.Add();
+
+	++m_notifyDepth;
 
-		auto it = find_if(methods.begin(), methods.end(), [&](const MethodHandle& f) {
-			return f.target<decltype(callback)>() == &callback;
-		});
-		if (it != methods.end())
+	// Every matching filter is notified. Values are read by index because a
+	// callback may add another callback to the same filter.
+	m_topicHandlers.Match(topic, [&](const Trie::Node& node) {
+		for (std::size_t i = 0; i < node.values.size(); ++i)
 		{
-			methods.erase(it);
-			// Remove topic if all methods erased.
-			if (methods.empty())
+			const Slot& slot = m_slots[node.values[i]];
+			if (slot.removed)
+			{
+				continue;
+			}
+
+			calls.Add();
+			try
+			{
+				slot.callback(topic, json);
+			}
+			catch (const std::exception& e)
 			{
-				m_topicHandlers.erase(itTopic);
+				errors.Add();
+				logger()->error("Exception caught: {}", e.what());
 			}
-			return true;
 		}
+	});
+
+	if (--m_notifyDepth == 0)
+	{
+		ReleaseDeferred_();
 	}
-	return false;
 }
 
-void Notifier::Notify(const std::string& topic, const nlohmann::json& json)
+std::vector<std::string> Notifier::GetTopics()
+{
+	std::vector<std::string> topics;
+
+	m_topicHandlers.ForEach([&topics](const Trie::Node& node) {
+		topics.push_back(node.filter);
+	});
+	return topics;
+}
+
+Notifier::Slot* Notifier::FindSlot_(Token token)
 {
-	auto list = GetMethodListForTopic_(topic);
+	auto index = static_cast<std::uint32_t>(token & 0xffffffff);
+	auto generation = static_cast<std::uint32_t>(token >> 32);
 
-	for (auto cb : list)
+	if (index >= m_slots.size())
 	{
-		try
-		{
-			cb(topic, json);
-		}
-		catch (const std::exception& e)
-		{
-			logger()->error("Exception caught: {}", e.what());
-		}
+		return nullptr;
 	}
+
+	Slot& slot = m_slots[index];
+	if (!slot.node || slot.generation != generation)
+	{
+		return nullptr;
+	}
+	return &slot;
 }
 
-std::vector<Notifier::MethodHandle>
-Notifier::GetMethodListForTopic_(const std::string& topic)
+void Notifier::Release_(std::uint32_t index)
 {
-	for (auto& [key, value] : m_topicHandlers)
+	Slot& slot = m_slots[index];
+	auto node = slot.node;
+
+	// Swap the last value into this slot's position to erase in O(1).
+	auto& values = node->values;
+	std::uint32_t moved = values.back();
+	values[slot.pos] = moved;
+	m_slots[moved].pos = slot.pos;
+	values.pop_back();
+
+	if (values.empty())
 	{
-		bool result;
-		int rc = mosquitto_topic_matches_sub(key.c_str(), topic.c_str(), &result);
-		if (rc == MOSQ_ERR_SUCCESS && result)
-		{
-			return value;
-		}
+		// Remove topic if all methods erased.
+		m_topicHandlers.Prune(node);
 	}
-	return {};
+
+	slot.callback.Reset();
+	slot.node = nullptr;
+	slot.removed = false;
+	++slot.generation;
+	if (slot.generation == 0)
+	{
+		slot.generation = 1; // Keep tokens non-zero.
+	}
+	m_freeSlots.push_back(index);
 }
 
-std::vector<std::string> Notifier::GetTopics()
+void Notifier::ReleaseDeferred_()
 {
-	std::vector<std::string> topics;
-
-	for (auto& [key, value] : m_topicHandlers)
+	// Releasing callbacks may run destructors that call back into Notifier,
+	// so swap the list out first.
+	std::vector<std::uint32_t> deferred;
+	deferred.swap(m_deferred);
+	for (auto index : deferred)
 	{
-		topics.push_back(key);
+		Release_(index);
+	}
+	if (m_deferred.empty())
+	{
+		m_deferred.swap(deferred);
+		m_deferred.clear();
 	}
-	return topics;
 }
 
 } // namespace ncc
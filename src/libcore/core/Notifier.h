@@ -1,31 +1,59 @@
 #pragma once
 
 #include <core/INotifier.h>
+#include <core/TopicTrie.h>
 
+#include <cstdint>
+#include <deque>
 #include <vector>
 
 namespace ncc
 {
 
+// Notifier keeps its callbacks in a slot table and indexes the slots by topic
+// filter in a TopicTrie. A Token encodes the slot index and the slot's
+// generation, so Remove(Token) finds its callback directly and a stale token
+// can't remove a callback that later reused the same slot.
+//
+// Callbacks may call Add() or Remove() while they are being notified. Removals
+// made during Notify() are deferred until the outermost Notify() returns.
 class Notifier : public INotifier
 {
 public:
 	~Notifier() override = default;
 
-	bool Add(const std::string& topic, MethodHandle callback) override;
+	Token Add(const std::string& topic, MethodHandle callback) override;
 	bool Remove(const std::string& topic) override;
-	bool Remove(const std::string& topic, MethodHandle callback) override;
+	bool Remove(Token token) override;
 
 	void Notify(const std::string& topic, const nlohmann::json& json) override;
 
 	std::vector<std::string> GetTopics();
 
 private:
-	std::vector<MethodHandle> GetMethodListForTopic_(const std::string& topic);
+	using Trie = TopicTrie<std::uint32_t>;
+
+	struct Slot
+	{
+		MethodHandle callback;
+		Trie::Node* node {nullptr};     // nullptr => slot is free
+		std::uint32_t pos {0};          // Index of this slot in node->values
+		std::uint32_t generation {1};
+		bool removed {false};           // Removal deferred until Notify() returns
+	};
+
+	Slot* FindSlot_(Token token);
+	void Release_(std::uint32_t index);
+	void ReleaseDeferred_();
 
 private:
-	std::map<std::string, std::vector<MethodHandle>> m_topicHandlers;
+	Trie m_topicHandlers;
 
+	// std::deque keeps slots in place when a callback adds another callback.
+	std::deque<Slot> m_slots;
+	std::vector<std::uint32_t> m_freeSlots;
+	std::vector<std::uint32_t> m_deferred;
+	int m_notifyDepth {0};
 };
 
 } // namespace ncc
@@ -0,0 +1,212 @@
+#include <core/Outbox.h>
+
+#include <algorithm>
+#include <thread>
+
+namespace ncc
+{
+
+Outbox::Outbox(const OutboxConfig& config)
+	: m_config(config)
+	, m_ring(config.capacity)
+{
+	for (const auto& filter : m_config.conflate)
+	{
+		m_conflateFilters.Insert(filter)->values.push_back(true);
+	}
+}
+
+bool Outbox::Push(
+	const std::string& topic,
+	std::span<const std::byte> payload,
+	int qos,
+	bool retain,
+	bool mayBlock)
+{
+	if (IsConflated_(topic))
+	{
+		PushConflated_(topic, payload, qos, retain);
+		return true;
+	}
+
+	if (TryPush_(topic, payload, qos, retain))
+	{
+		return true;
+	}
+
+	auto policy = m_config.policy;
+	if (policy == OverflowPolicy::BlockWithDeadline && !mayBlock)
+	{
+		policy = OverflowPolicy::DropNewest;
+	}
+
+	switch (policy)
+	{
+	case OverflowPolicy::DropOldest:
+		// Another producer may take the freed slot, so keep evicting until
+		// this message fits.
+		for (;;)
+		{
+			if (m_ring.TryPop([](Message&) {}))
+			{
+				m_droppedOldest.fetch_add(1, std::memory_order_relaxed);
+			}
+			if (TryPush_(topic, payload, qos, retain))
+			{
+				return true;
+			}
+		}
+
+	case OverflowPolicy::DropNewest:
+		m_droppedNewest.fetch_add(1, std::memory_order_relaxed);
+		return false;
+
+	case OverflowPolicy::BlockWithDeadline:
+	{
+		auto deadline = std::chrono::steady_clock::now() + m_config.deadline;
+		auto backoff = 50us;
+		while (std::chrono::steady_clock::now() < deadline)
+		{
+			std::this_thread::sleep_for(backoff);
+			if (TryPush_(topic, payload, qos, retain))
+			{
+				return true;
+			}
+			backoff = std::min<std::chrono::microseconds>(backoff * 2, 5ms);
+		}
+		m_timedOut.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	}
+	return false;
+}
+
+OutboxStats Outbox::Stats() const
+{
+	OutboxStats stats;
+	stats.depth = m_ring.Size() + (m_retrying.load(std::memory_order_relaxed) ? 1 : 0);
+	stats.capacity = m_ring.Capacity();
+	stats.enqueued = m_enqueued.load(std::memory_order_relaxed);
+	stats.sent = m_sent.load(std::memory_order_relaxed);
+	stats.droppedOldest = m_droppedOldest.load(std::memory_order_relaxed);
+	stats.droppedNewest = m_droppedNewest.load(std::memory_order_relaxed);
+	stats.timedOut = m_timedOut.load(std::memory_order_relaxed);
+	stats.sendRetried = m_sendRetried.load(std::memory_order_relaxed);
+	stats.sendFailed = m_sendFailed.load(std::memory_order_relaxed);
+	stats.conflatedDepth = m_conflatedDepth.load(std::memory_order_relaxed);
+	stats.conflated = m_conflatedCount.load(std::memory_order_relaxed);
+	return stats;
+}
+
+bool Outbox::TryPush_(const std::string& topic, std::span<const std::byte> payload, int qos, bool retain)
+{
+	bool pushed = m_ring.TryPush([&](Message& msg) {
+		// assign() reuses the slot's existing capacity.
+		msg.topic.assign(topic);
+		msg.payload.assign(payload.begin(), payload.end());
+		msg.qos = qos;
+		msg.retain = retain;
+	});
+	if (pushed)
+	{
+		m_enqueued.fetch_add(1, std::memory_order_relaxed);
+	}
+	return pushed;
+}
+
+bool Outbox::IsConflated_(const std::string& topic) const
+{
+	bool match {false};
+	if (!m_conflateFilters.Empty())
+	{
+		m_conflateFilters.Match(topic, [&match](const auto&) { match = true; });
+	}
+	return match;
+}
+
+void Outbox::PushConflated_(const std::string& topic, std::span<const std::byte> payload, int qos, bool retain)
+{
+	std::unique_lock lock(m_conflatedMutex);
+
+	auto it = m_conflated.find(topic);
+	if (it == m_conflated.end())
+	{
+		it = m_conflated.emplace(topic, Conflated{}).first;
+		it->second.msg.topic = topic;
+	}
+
+	// Overwrite the pending value in place; assign() reuses its capacity.
+	auto& entry = it->second;
+	entry.msg.payload.assign(payload.begin(), payload.end());
+	entry.msg.qos = qos;
+	entry.msg.retain = retain;
+	m_enqueued.fetch_add(1, std::memory_order_relaxed);
+
+	if (entry.queued)
+	{
+		m_conflatedCount.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	entry.queued = true;
+	m_conflatedQueue.push_back(&entry);
+	m_conflatedDepth.fetch_add(1, std::memory_order_release);
+}
+
+const Outbox::Message* Outbox::PopConflated_()
+{
+	if (m_conflatedDepth.load(std::memory_order_acquire) == 0)
+	{
+		return nullptr;
+	}
+
+	std::unique_lock lock(m_conflatedMutex);
+	if (m_conflatedQueue.empty())
+	{
+		return nullptr;
+	}
+
+	auto entry = m_conflatedQueue.front();
+	m_conflatedQueue.pop_front();
+	entry->queued = false;
+	m_conflatedDepth.fetch_sub(1, std::memory_order_release);
+
+	// Swapping hands the payload to the drainer without copying; the entry
+	// gets the scratch buffer's capacity in return.
+	std::swap(entry->msg.payload, m_conflatedScratch.payload);
+	m_conflatedScratch.topic.assign(entry->msg.topic);
+	m_conflatedScratch.qos = entry->msg.qos;
+	m_conflatedScratch.retain = entry->msg.retain;
+	m_conflatedSource = entry;
+	return &m_conflatedScratch;
+}
+
+void Outbox::Retry_()
+{
+	if (++m_retryAttempts >= m_config.maxSendAttempts)
+	{
+		m_retrying.store(false, std::memory_order_release);
+		m_sendFailed.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	m_retrying.store(true, std::memory_order_release);
+	m_sendRetried.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Outbox::RequeueConflated_()
+{
+	std::unique_lock lock(m_conflatedMutex);
+	auto entry = m_conflatedSource;
+	if (!entry || entry->queued)
+	{
+		return; // Superseded by a newer value.
+	}
+
+	std::swap(entry->msg.payload, m_conflatedScratch.payload);
+	entry->msg.qos = m_conflatedScratch.qos;
+	entry->msg.retain = m_conflatedScratch.retain;
+	entry->queued = true;
+	m_conflatedQueue.push_front(entry);
+	m_conflatedDepth.fetch_add(1, std::memory_order_release);
+}
+
+} // namespace ncc
@@ -0,0 +1,250 @@
+#pragma once
+
+#include <core/MpmcRing.h>
+#include <core/TopicTrie.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace ncc
+{
+
+// What Outbox::Push() does when the outbox is full.
+enum class OverflowPolicy
+{
+	DropOldest,        // Discard the oldest queued message to make room.
+	DropNewest,        // Discard the message being published.
+	BlockWithDeadline, // Wait up to OutboxConfig::deadline for room, then drop.
+};
+
+struct OutboxConfig
+{
+	// Maximum number of queued messages. Zero disables the outbox, in which
+	// case Publish() waits for the connection instead.
+	std::size_t capacity {0};
+	OverflowPolicy policy {OverflowPolicy::DropOldest};
+	std::chrono::milliseconds deadline {100ms};
+
+	// Drains in a row in which sending a message may fail before it is
+	// dropped (and counted in OutboxStats::sendFailed). Until then it is
+	// kept, and sent ahead of the rest by the next Drain().
+	std::size_t maxSendAttempts {8};
+
+	// Topic filters for state topics where only the newest value matters.
+	// At most one message per matching topic is queued; publishing again
+	// replaces it in place. These never count against "capacity". Messages
+	// sent directly (connected, nothing queued) are not conflated.
+	std::vector<std::string> conflate;
+};
+
+struct OutboxStats
+{
+	std::size_t depth {0};
+	std::size_t capacity {0};
+	std::uint64_t enqueued {0};
+	std::uint64_t sent {0};
+	std::uint64_t droppedOldest {0};
+	std::uint64_t droppedNewest {0};
+	std::uint64_t timedOut {0};
+
+	// Sends that failed; the message was kept for the next Drain(). Messages
+	// dropped after OutboxConfig::maxSendAttempts failures.
+	std::uint64_t sendRetried {0};
+	std::uint64_t sendFailed {0};
+
+	// Conflated topics with a message waiting, and messages replaced by a
+	// newer value before they were sent.
+	std::size_t conflatedDepth {0};
+	std::uint64_t conflated {0};
+};
+
+// Outbox holds messages published while the client can't send them (i.e.
+// while it is disconnected) in a fixed-capacity lock-free ring. Queued
+// messages are sent in order by Drain(), which the client calls once it is
+// connected.
+//
+// Messages on conflated topics (see OutboxConfig::conflate) are kept apart,
+// one per topic, so traffic after a reconnect is bounded by the number of
+// topics rather than the publish rate. Only queued messages are conflated:
+// while the client is connected and nothing is queued, it sends every
+// message directly.
+class Outbox
+{
+public:
+	struct Message
+	{
+		std::string topic;
+		std::vector<std::byte> payload;
+		int qos {0};
+		bool retain {false};
+	};
+
+	explicit Outbox(const OutboxConfig& config);
+
+	// Queues a copy of the message. Returns false if it was dropped. Callers
+	// that must never block (i.e. the network thread) pass mayBlock = false,
+	// which turns BlockWithDeadline into DropNewest.
+	bool Push(
+		const std::string& topic,
+		std::span<const std::byte> payload,
+		int qos,
+		bool retain,
+		bool mayBlock = true);
+
+	// Sends queued messages in order using send(const Message&), which
+	// returns false if the message couldn't be sent. Draining stops at the
+	// first failure, and that message is kept to be sent first next time.
+	// Only one thread drains at a time; concurrent calls return immediately.
+	// Returns the number of messages sent.
+	template <typename SendFn>
+	std::size_t Drain(SendFn&& send)
+	{
+		std::size_t count {0};
+		bool failed {false};
+		do
+		{
+			if (m_draining.test_and_set(std::memory_order_acquire))
+			{
+				break; // Another thread is draining.
+			}
+
+			auto sendOne = [&](const Message& msg) {
+				if (send(msg))
+				{
+					++count;
+					m_sent.fetch_add(1, std::memory_order_relaxed);
+					return true;
+				}
+				failed = true;
+				return false;
+			};
+
+			if (m_retrying.load(std::memory_order_acquire))
+			{
+				if (sendOne(m_retry))
+				{
+					m_retrying.store(false, std::memory_order_release);
+				}
+				else
+				{
+					Retry_();
+				}
+			}
+
+			while (!failed && m_ring.TryPop([&](Message& msg) {
+				if (!sendOne(msg))
+				{
+					// The slot's buffers go to m_retry, and its old ones back
+					// to the ring.
+					std::swap(m_retry, msg);
+					m_retryAttempts = 0;
+					Retry_();
+				}
+			}))
+			{
+			}
+
+			while (!failed)
+			{
+				auto msg = PopConflated_();
+				if (!msg)
+				{
+					break;
+				}
+				if (!sendOne(*msg))
+				{
+					m_sendRetried.fetch_add(1, std::memory_order_relaxed);
+					RequeueConflated_();
+				}
+			}
+
+			m_draining.clear(std::memory_order_release);
+
+			// A message pushed after the outbox looked empty but before the
+			// flag was cleared would otherwise wait for the next Drain().
+		} while (!failed && !Empty());
+
+		return count;
+	}
+
+	bool Empty() const
+	{
+		return m_ring.Empty()
+			&& m_conflatedDepth.load(std::memory_order_acquire) == 0
+			&& !m_retrying.load(std::memory_order_acquire);
+	}
+	std::size_t Size() const
+	{
+		return m_ring.Size()
+			+ m_conflatedDepth.load(std::memory_order_relaxed)
+			+ (m_retrying.load(std::memory_order_relaxed) ? 1 : 0);
+	}
+
+	OutboxStats Stats() const;
+
+private:
+	bool TryPush_(const std::string& topic, std::span<const std::byte> payload, int qos, bool retain);
+
+	bool IsConflated_(const std::string& topic) const;
+	void PushConflated_(const std::string& topic, std::span<const std::byte> payload, int qos, bool retain);
+
+	// Moves the oldest pending conflated message into m_conflatedScratch and
+	// returns it, or nullptr if there is none. Drainer only.
+	const Message* PopConflated_();
+
+	// Puts m_conflatedScratch back after a failed send unless a newer value
+	// has been published meanwhile.
+	void RequeueConflated_();
+
+	// Counts a failed send of m_retry, and keeps it for the next Drain()
+	// unless it failed too often. Drainer only.
+	void Retry_();
+
+private:
+	const OutboxConfig m_config;
+	MpmcRing<Message> m_ring;
+	std::atomic_flag m_draining;
+
+	// A message taken off the ring whose send failed. Drainer only, except
+	// m_retrying.
+	Message m_retry;
+	std::size_t m_retryAttempts {0};
+	std::atomic_bool m_retrying {false};
+
+	struct Conflated
+	{
+		Message msg;
+		bool queued {false};
+	};
+
+	TopicTrie<bool> m_conflateFilters;
+	std::mutex m_conflatedMutex;
+	// Entries are never erased, so their buffers are reused by later
+	// publishes and pointers to them stay valid.
+	std::map<std::string, Conflated, std::less<>> m_conflated;
+	std::deque<Conflated*> m_conflatedQueue;
+	std::atomic<std::size_t> m_conflatedDepth {0};
+	Message m_conflatedScratch;
+	Conflated* m_conflatedSource {nullptr};
+	std::atomic<std::uint64_t> m_conflatedCount {0};
+
+	std::atomic<std::uint64_t> m_enqueued {0};
+	std::atomic<std::uint64_t> m_sent {0};
+	std::atomic<std::uint64_t> m_droppedOldest {0};
+	std::atomic<std::uint64_t> m_droppedNewest {0};
+	std::atomic<std::uint64_t> m_timedOut {0};
+	std::atomic<std::uint64_t> m_sendRetried {0};
+	std::atomic<std::uint64_t> m_sendFailed {0};
+};
+
+} // namespace ncc
@@ -0,0 +1,113 @@
+#include <core/Logger.h>
+#include <core/PublishTracker.h>
+
+namespace ncc
+{
+
+PublishTracker::PublishTracker(const InFlightConfig& config)
+	: m_config(config)
+{
+}
+
+void PublishTracker::OnAck(int mid)
+{
+	auto now = std::chrono::steady_clock::now();
+	{
+		std::unique_lock lock(m_mutex);
+		auto it = m_inFlight.find(mid);
+		if (it == m_inFlight.end())
+		{
+			return;
+		}
+		m_latency.Record(now - it->second.sent);
+		m_inFlight.erase(it);
+		++m_acked;
+	}
+	m_cv.notify_all();
+}
+
+void PublishTracker::Rearm()
+{
+	auto deadline = std::chrono::steady_clock::now() + m_config.expiry;
+	std::unique_lock lock(m_mutex);
+	for (auto& [mid, inFlight] : m_inFlight)
+	{
+		inFlight.deadline = deadline;
+	}
+}
+
+bool PublishTracker::IsComplete(int mid, std::uint64_t seq) const
+{
+	std::unique_lock lock(m_mutex);
+	return IsCompleteLocked_(mid, seq);
+}
+
+bool PublishTracker::Wait(int mid, std::uint64_t seq, std::chrono::milliseconds timeout) const
+{
+	std::unique_lock lock(m_mutex);
+	return m_cv.wait_for(lock, timeout, [&]() { return IsCompleteLocked_(mid, seq); });
+}
+
+PublishStats PublishTracker::Stats() const
+{
+	PublishStats stats;
+	{
+		std::unique_lock lock(m_mutex);
+		stats.inFlight = m_inFlight.size();
+		stats.tracked = m_tracked;
+		stats.acked = m_acked;
+		stats.windowTimeouts = m_windowTimeouts;
+		stats.expired = m_expired;
+	}
+	stats.window = m_config.window;
+	stats.ackLatency = m_latency.Summary();
+	return stats;
+}
+
+bool PublishTracker::WaitForWindow_(std::unique_lock<std::mutex>& lock, bool mayBlock)
+{
+	auto hasRoom = [this]() {
+		if (m_inFlight.size() >= m_config.window)
+		{
+			Expire_();
+		}
+		return m_inFlight.size() < m_config.window;
+	};
+	if (hasRoom())
+	{
+		return true;
+	}
+
+	if (!mayBlock || !m_cv.wait_for(lock, m_config.timeout, hasRoom))
+	{
+		++m_windowTimeouts;
+		logger()->warn("PublishTracker::Publish(): {} message(s) in flight, window is full", m_inFlight.size());
+		return false;
+	}
+	return true;
+}
+
+void PublishTracker::Expire_()
+{
+	// Only called when the window is full, so this scan is rare.
+	auto now = std::chrono::steady_clock::now();
+	auto expired = std::erase_if(m_inFlight, [now](const auto& entry) { return entry.second.deadline <= now; });
+	if (expired)
+	{
+		m_expired += expired;
+		logger()->warn("PublishTracker::Publish(): gave up on {} unacknowledged message(s)", expired);
+
+		// Their tokens are complete now.
+		m_cv.notify_all();
+	}
+}
+
+bool PublishTracker::IsCompleteLocked_(int mid, std::uint64_t seq) const
+{
+	// Message ids are reused, so the entry only belongs to this token if the
+	// sequence number matches too.
+	auto it = m_inFlight.find(mid);
+	return (it == m_inFlight.end() || it->second.seq != seq);
+}
+
+} // namespace ncc
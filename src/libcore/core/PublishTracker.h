@@ -0,0 +1,164 @@
+#pragma once
+
+#include <core/Histogram.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+using namespace std::chrono_literals;
+
+namespace ncc
+{
+
+class PublishTracker;
+
+struct InFlightConfig
+{
+	// Maximum number of tracked publishes waiting for their ack. Further
+	// tracked publishes wait up to "timeout" for one to complete.
+	std::size_t window {64};
+	std::chrono::milliseconds timeout {1000ms};
+
+	// A tracked publish that isn't acknowledged within this (counted from the
+	// last (re)connect) is given up on, so that acks lost with a connection
+	// don't use up the window for good.
+	std::chrono::milliseconds expiry {30000ms};
+};
+
+struct PublishStats
+{
+	std::size_t inFlight {0};
+	std::size_t window {0};
+	std::uint64_t tracked {0};
+	std::uint64_t acked {0};
+	std::uint64_t windowTimeouts {0};
+	std::uint64_t expired {0};
+	HistogramSummary ackLatency; // Nanoseconds
+};
+
+// Identifies one tracked publish. A token is just the message id plus a
+// sequence number, so it is cheap to copy and never allocates. It must not
+// outlive the client that returned it.
+//
+// An invalid (default) token means the message wasn't sent.
+class PublishToken
+{
+public:
+	PublishToken() = default;
+
+	bool Valid() const { return m_tracker != nullptr; }
+	int Mid() const { return m_mid; }
+
+	// True once the broker acknowledged the message (PUBACK for QoS 1,
+	// PUBCOMP for QoS 2, or once written to the socket for QoS 0), or once it
+	// was given up on (see InFlightConfig::expiry).
+	bool IsComplete() const;
+
+	// Waits up to "timeout" for completion. Returns IsComplete().
+	bool Wait(std::chrono::milliseconds timeout) const;
+
+private:
+	friend class PublishTracker;
+
+	PublishToken(const PublishTracker* tracker, int mid, std::uint64_t seq)
+		: m_tracker(tracker)
+		, m_mid(mid)
+		, m_seq(seq)
+	{
+	}
+
+	const PublishTracker* m_tracker {nullptr};
+	int m_mid {0};
+	std::uint64_t m_seq {0};
+};
+
+// PublishTracker matches the broker's acks to tracked publishes by message
+// id, bounds how many are in flight and records the ack latency.
+class PublishTracker
+{
+public:
+	explicit PublishTracker(const InFlightConfig& config);
+
+	// Calls publish(int* mid), which sends the message and stores its message
+	// id, and starts tracking it. "mayBlock" is false on the network thread,
+	// where a full window fails immediately instead of waiting.
+	template <typename PublishFn>
+	PublishToken Publish(PublishFn&& publish, bool mayBlock)
+	{
+		std::unique_lock lock(m_mutex);
+		if (!WaitForWindow_(lock, mayBlock))
+		{
+			return {};
+		}
+
+		// The lock is held while sending so that an ack arriving on the
+		// network thread before publish() returns waits for the mid to be
+		// registered, rather than being mistaken for an untracked message.
+		int mid {0};
+		if (!publish(&mid))
+		{
+			return {};
+		}
+
+		auto seq = ++m_seq;
+		auto now = std::chrono::steady_clock::now();
+		m_inFlight[mid] = {seq, now, now + m_config.expiry};
+		++m_tracked;
+		return PublishToken(this, mid, seq);
+	}
+
+	// Called from the mosquitto publish callback. Acks for messages that
+	// aren't tracked are ignored.
+	void OnAck(int mid);
+
+	// Called on (re)connect: the client resends the unacknowledged QoS 1 and
+	// 2 messages, so their expiry starts again from now.
+	void Rearm();
+
+	bool IsComplete(int mid, std::uint64_t seq) const;
+	bool Wait(int mid, std::uint64_t seq, std::chrono::milliseconds timeout) const;
+
+	PublishStats Stats() const;
+
+private:
+	bool WaitForWindow_(std::unique_lock<std::mutex>& lock, bool mayBlock);
+	bool IsCompleteLocked_(int mid, std::uint64_t seq) const;
+	void Expire_();
+
+private:
+	struct InFlight
+	{
+		std::uint64_t seq {0};
+		std::chrono::steady_clock::time_point sent;
+		std::chrono::steady_clock::time_point deadline;
+	};
+
+	const InFlightConfig m_config;
+
+	mutable std::mutex m_mutex;
+	mutable std::condition_variable m_cv;
+	std::unordered_map<int, InFlight> m_inFlight;
+	std::uint64_t m_seq {0};
+	std::uint64_t m_tracked {0};
+	std::uint64_t m_acked {0};
+	std::uint64_t m_windowTimeouts {0};
+	std::uint64_t m_expired {0};
+
+	Histogram m_latency;
+};
+
+inline bool PublishToken::IsComplete() const
+{
+	return m_tracker && m_tracker->IsComplete(m_mid, m_seq);
+}
+
+inline bool PublishToken::Wait(std::chrono::milliseconds timeout) const
+{
+	return m_tracker && m_tracker->Wait(m_mid, m_seq, timeout);
+}
+
+} // namespace ncc
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ncc
+{
+
+// Rcu holds an immutable value that readers access with a single atomic load
+// and that writers replace copy-on-write (read-copy-update).
+//
+// Readers never block or take a lock. A reader registers itself in one of two
+// counters, selected by the current epoch, before loading the pointer. A writer
+// publishes the new value, flips the epoch and waits for the old epoch's
+// counter to drain. Readers that arrive after the flip count against the
+// other counter and can only see the new value, so the wait always ends.
+// Writers are serialized while they copy and publish, but wait for readers
+// after releasing that lock, so a reader that updates (see below) never
+// waits for a writer that is waiting for it. Once Update() returns, no
+// reader can still be using the old value, with one exception:
+//
+// If Update() is called by a thread that is itself inside a read section
+// (i.e. a subscriber unregistering from within its callback), waiting would
+// deadlock, so the old value is retired and freed by a later Update() instead.
+// Then Update() returns while readers, the caller included, may still be
+// using the old value; they see the new one in their next read section.
+template <typename T>
+class Rcu
+{
+public:
+	class ReadGuard
+	{
+	public:
+		ReadGuard(const Rcu& rcu)
+			: m_rcu(&rcu)
+		{
+			++t_readDepth;
+
+			// Retry if a writer flipped the epoch while registering, otherwise
+			// that writer might wait on the other counter.
+			for (;;)
+			{
+				unsigned epoch = rcu.m_epoch.load(std::memory_order_seq_cst);
+				m_epoch = epoch & 1;
+				rcu.m_readers[m_epoch].count.fetch_add(1, std::memory_order_seq_cst);
+				if (rcu.m_epoch.load(std::memory_order_seq_cst) == epoch)
+				{
+					break;
+				}
+				rcu.m_readers[m_epoch].count.fetch_sub(1, std::memory_order_release);
+			}
+			m_value = rcu.m_value.load(std::memory_order_seq_cst);
+		}
+
+		~ReadGuard()
+		{
+			m_rcu->m_readers[m_epoch].count.fetch_sub(1, std::memory_order_release);
+			--t_readDepth;
+		}
+
+		ReadGuard(const ReadGuard&) = delete;
+		ReadGuard& operator=(const ReadGuard&) = delete;
+
+		const T* operator->() const { return m_value; }
+		const T& operator*() const { return *m_value; }
+
+	private:
+		const Rcu* m_rcu {nullptr};
+		const T* m_value {nullptr};
+		unsigned m_epoch {0};
+	};
+
+	explicit Rcu(std::unique_ptr<T> value = std::make_unique<T>())
+		: m_value(value.release())
+	{
+	}
+
+	~Rcu()
+	{
+		delete m_value.load();
+	}
+
+	Rcu(const Rcu&) = delete;
+	Rcu& operator=(const Rcu&) = delete;
+
+	ReadGuard Read() const { return ReadGuard(*this); }
+
+	// Copies the current value, applies fn(T&) to the copy and publishes it.
+	// Writers are serialized, so fn always sees the latest value.
+	template <typename Fn>
+	void Update(Fn&& fn)
+	{
+		std::unique_ptr<const T> old;
+		std::vector<std::unique_ptr<const T>> retired;
+		{
+			std::unique_lock lock(m_writeMutex);
+			m_version.fetch_add(1, std::memory_order_release);
+
+			const T* current = m_value.load(std::memory_order_relaxed);
+			auto next = std::make_unique<T>(*current);
+			fn(*next);
+			m_value.store(next.release(), std::memory_order_seq_cst);
+			old.reset(current);
+
+			if (t_readDepth > 0)
+			{
+				m_retired.push_back(std::move(old));
+				return;
+			}
+			retired.swap(m_retired);
+		}
+
+		// Only one writer flips the epoch and waits at a time, so all readers
+		// are registered under the current epoch when it flips.
+		std::unique_lock lock(m_waitMutex);
+		WaitForReaders_();
+		old.reset();
+
+		// Readers of values retired from inside a read section may have
+		// registered under either epoch, so drain the other counter as well.
+		if (!retired.empty())
+		{
+			WaitForReaders_();
+			retired.clear();
+		}
+	}
+
+	// Version of the value, incremented by every Update().
+	std::uint64_t Version() const { return m_version.load(std::memory_order_acquire); }
+
+private:
+	// Flips the epoch and waits until every reader that registered under the
+	// previous epoch has left. New readers use the other counter.
+	void WaitForReaders_()
+	{
+		unsigned epoch = m_epoch.fetch_add(1, std::memory_order_seq_cst) & 1;
+		while (m_readers[epoch].count.load(std::memory_order_acquire) != 0)
+		{
+			std::this_thread::yield();
+		}
+	}
+
+private:
+	struct alignas(64) Counter
+	{
+		std::atomic<std::size_t> count {0};
+	};
+
+	std::atomic<const T*> m_value;
+	std::atomic<unsigned> m_epoch {0};
+	std::atomic<std::uint64_t> m_version {0};
+	mutable Counter m_readers[2];
+
+	std::mutex m_writeMutex;
+	std::vector<std::unique_ptr<const T>> m_retired; // Guarded by m_writeMutex
+
+	// Never taken inside a read section.
+	std::mutex m_waitMutex;
+
+	static thread_local int t_readDepth;
+};
+
+template <typename T>
+thread_local int Rcu<T>::t_readDepth {0};
+
+} // namespace ncc
@@ -0,0 +1,295 @@
+#include <core/Scheduler.h>
+#include <core/SimKernel.h>
+
+#include <algorithm>
+
+namespace ncc
+{
+
+namespace
+{
+
+// The timer whose callback is running on this thread, so that a callback can
+// cancel its own timer without waiting for itself.
+thread_local Scheduler::TimerId t_current {0};
+
+} // namespace
+
+Scheduler::Scheduler(const SchedulerConfig& config)
+	: m_config(config)
+	, m_epoch(Clock::now())
+	, m_pool(config.threads, config.name)
+{
+	// The kernel keeps the time of a simulated scheduler.
+	if (!m_config.kernel)
+	{
+		m_thread = std::thread(&Scheduler::Run_, this);
+	}
+}
+
+Scheduler::~Scheduler()
+{
+	if (m_config.kernel)
+	{
+		// Also waits for an event that is running.
+		m_config.kernel->CancelAll(this);
+	}
+
+	std::unique_lock lock(m_mutex);
+	m_stopping = true;
+	m_cv.notify_one();
+
+	// Callbacks on the pool still refer to this scheduler.
+	m_idle.wait(lock, [this]() { return m_running == 0; });
+	lock.unlock();
+
+	if (m_thread.joinable())
+	{
+		m_thread.join();
+	}
+}
+
+Scheduler::TimerId Scheduler::After(std::chrono::milliseconds delay, Callback fn)
+{
+	return Add_(delay, 0, std::move(fn));
+}
+
+Scheduler::TimerId Scheduler::Every(std::chrono::milliseconds period, Callback fn)
+{
+	return Add_(period, std::max<std::uint64_t>(Ticks_(period), 1), std::move(fn));
+}
+
+bool Scheduler::Cancel(TimerId id)
+{
+	std::unique_lock lock(m_mutex);
+	auto it = m_timers.find(id);
+	if (it == m_timers.end())
+	{
+		return false;
+	}
+	auto timer = std::move(it->second);
+	m_timers.erase(it);
+
+	// One that hasn't started never will (see Fire_()).
+	if (id != t_current && timer->started)
+	{
+		m_idle.wait(lock, [&timer]() { return !timer->running; });
+	}
+	return true;
+}
+
+bool Scheduler::Pending(TimerId id) const
+{
+	std::unique_lock lock(m_mutex);
+	return m_timers.contains(id);
+}
+
+void Scheduler::Post(Callback fn)
+{
+	if (m_config.kernel)
+	{
+		m_config.kernel->Post(std::move(fn), this);
+		return;
+	}
+	m_pool.Post(std::move(fn));
+}
+
+const SimClock& Scheduler::GetClock() const
+{
+	if (m_config.kernel)
+	{
+		return *m_config.kernel;
+	}
+	return realClock();
+}
+
+std::size_t Scheduler::Size() const
+{
+	std::unique_lock lock(m_mutex);
+	return m_timers.size();
+}
+
+Scheduler::TimerId Scheduler::Add_(std::chrono::milliseconds delay, std::uint64_t period, Callback fn)
+{
+	auto timer = std::make_shared<Timer>();
+	timer->period = period;
+	timer->fn = std::move(fn);
+
+	std::unique_lock lock(m_mutex);
+	auto id = m_nextId++;
+	if (m_config.kernel)
+	{
+		m_timers.emplace(id, std::move(timer));
+		lock.unlock();
+		Arm_(id, delay);
+		return id;
+	}
+
+	auto now = Now_();
+	if (m_wheel.Empty())
+	{
+		// The timekeeping thread doesn't keep the wheel's time while it has
+		// nothing to wait for; catch up before inserting.
+		m_wheel.Advance(now, [](TimerId, std::uint64_t) {});
+	}
+
+	m_timers.emplace(id, std::move(timer));
+	m_wheel.Insert(now + Ticks_(delay), id);
+	m_cv.notify_one();
+	return id;
+}
+
+std::uint64_t Scheduler::Ticks_(std::chrono::milliseconds duration) const
+{
+	// Round up, so a timer never fires early.
+	auto ticks = (duration + m_config.tick - 1ms) / m_config.tick;
+	return static_cast<std::uint64_t>(std::max<decltype(ticks)>(ticks, 0));
+}
+
+std::uint64_t Scheduler::Now_() const
+{
+	return static_cast<std::uint64_t>((Clock::now() - m_epoch) / m_config.tick);
+}
+
+void Scheduler::Run_()
+{
+	std::unique_lock lock(m_mutex);
+	while (!m_stopping)
+	{
+		auto now = Now_();
+		m_wheel.Advance(now, [this, now](TimerId id, std::uint64_t deadline) {
+			Expire_(id, deadline, now);
+		});
+
+		if (m_wheel.Empty())
+		{
+			m_cv.wait(lock);
+		}
+		else
+		{
+			m_cv.wait_until(lock, m_epoch + m_config.tick * m_wheel.NextTick());
+		}
+	}
+}
+
+void Scheduler::Expire_(TimerId id, std::uint64_t deadline, std::uint64_t now)
+{
+	auto it = m_timers.find(id);
+	if (it == m_timers.end())
+	{
+		return; // Cancelled
+	}
+	auto& timer = it->second;
+
+	if (!timer->running)
+	{
+		timer->running = true;
+		++m_running;
+		m_pool.Post([this, id, timer]() { Fire_(id, timer); });
+	}
+
+	if (timer->period)
+	{
+		// Keep to the original schedule unless a whole period was missed,
+		// i.e. after the system was suspended.
+		auto next = deadline + timer->period;
+		m_wheel.Insert(next > now ? next : now + timer->period, id);
+	}
+}
+
+void Scheduler::Fire_(TimerId id, const std::shared_ptr<Timer>& timer)
+{
+	// The pool catches and logs exceptions, but the timer must still be
+	// marked idle or Cancel() would wait forever.
+	struct Done
+	{
+		Scheduler& scheduler;
+		TimerId id;
+		Timer& timer;
+
+		~Done()
+		{
+			t_current = 0;
+
+			std::unique_lock lock(scheduler.m_mutex);
+			timer.running = false;
+			timer.started = false;
+			if (!timer.period)
+			{
+				auto it = scheduler.m_timers.find(id);
+				if (it != scheduler.m_timers.end() && it->second.get() == &timer)
+				{
+					scheduler.m_timers.erase(it);
+				}
+			}
+			--scheduler.m_running;
+			scheduler.m_idle.notify_all();
+		}
+	} done {*this, id, *timer};
+
+	{
+		std::unique_lock lock(m_mutex);
+		auto it = m_timers.find(id);
+		if (it == m_timers.end() || it->second != timer)
+		{
+			return; // Cancelled while queued
+		}
+		timer->started = true;
+	}
+
+	t_current = id;
+	timer->fn();
+}
+
+void Scheduler::Arm_(TimerId id, std::chrono::nanoseconds delay)
+{
+	// Like the wheel, the kernel keeps cancelled timers; they are skipped
+	// when they expire.
+	m_config.kernel->After(delay, [this, id]() { FireEvent_(id); }, this);
+}
+
+void Scheduler::FireEvent_(TimerId id)
+{
+	std::shared_ptr<Timer> timer;
+	{
+		std::unique_lock lock(m_mutex);
+		auto it = m_timers.find(id);
+		if (it == m_timers.end())
+		{
+			return; // Cancelled
+		}
+		timer = it->second;
+		timer->running = true;
+		++m_running;
+	}
+
+	// Runs on the kernel's thread, so a periodic timer can't overlap itself.
+	Fire_(id, timer);
+
+	if (timer->period)
+	{
+		std::unique_lock lock(m_mutex);
+		auto it = m_timers.find(id);
+		if (it == m_timers.end() || it->second != timer || m_stopping)
+		{
+			return;
+		}
+		lock.unlock();
+
+		// The kernel's clock is exactly at the deadline, so this keeps to the
+		// original schedule.
+		Arm_(id, timer->period * m_config.tick);
+	}
+}
+
+Scheduler& scheduler()
+{
+	// Never destroyed: tasks owned by static objects may still cancel their
+	// timers while those are torn down.
+	static auto instance = new Scheduler(SchedulerConfig {
+		.threads = std::clamp<std::size_t>(std::thread::hardware_concurrency(), 2, 4),
+	});
+	return *instance;
+}
+
+} // namespace ncc
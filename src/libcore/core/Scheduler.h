@@ -0,0 +1,144 @@
+#pragma once
+
+#include <core/InplaceFunction.h>
+#include <core/SimClock.h>
+#include <core/TimerWheel.h>
+#include <core/WorkerPool.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+namespace ncc
+{
+
+class SimKernel;
+
+struct SchedulerConfig
+{
+	std::string name {"Scheduler"};
+
+	// Threads running the callbacks (and mailboxes drained on Pool()).
+	std::size_t threads {4};
+
+	// Timer resolution.
+	std::chrono::milliseconds tick {1ms};
+
+	// Runs the timers in the kernel's virtual time instead of real time. See
+	// Scheduler.
+	SimKernel* kernel {nullptr};
+};
+
+// Scheduler runs the tasks' timers and message handlers on a small fixed
+// WorkerPool, so that a task needs no thread of its own and thousands of them
+// can share a handful of threads.
+//
+// Timers are kept in a TimerWheel by one timekeeping thread, which only wakes
+// when a timer may be due; their callbacks run on the pool. A periodic
+// callback never runs concurrently with itself: a tick that comes due while
+// the previous one is still running is skipped rather than queued.
+//
+// Message handlers run on Pool() by giving a Mailbox the pool (see
+// MailboxConfig::pool).
+//
+// Given a SimKernel, the timers and Post() are events of the kernel instead:
+// they run in its virtual time, one at a time on its thread, which makes the
+// tasks deterministic. Mailboxes drained on Pool() still run on the pool in
+// real time, so simulated tasks should use a CoExecutor instead.
+class Scheduler
+{
+public:
+	using Callback = InplaceFunction<void()>;
+	using TimerId = std::uint64_t;
+
+	explicit Scheduler(const SchedulerConfig& config = {});
+	~Scheduler();
+
+	Scheduler(const Scheduler&) = delete;
+	Scheduler& operator=(const Scheduler&) = delete;
+
+	// Calls "fn" once, "delay" from now.
+	TimerId After(std::chrono::milliseconds delay, Callback fn);
+
+	// Calls "fn" every "period", the first time one period from now.
+	TimerId Every(std::chrono::milliseconds period, Callback fn);
+
+	// Stops the timer. If its callback is running on another thread, waits
+	// for it to return, so whatever it refers to can be destroyed afterwards.
+	// A callback that is queued on the pool but hasn't started is skipped
+	// rather than waited for, so the pool's own threads can cancel without
+	// waiting on a task queued behind them. Returns false if there was no
+	// such timer (i.e. a one-shot that ran).
+	bool Cancel(TimerId id);
+
+	// True until a one-shot timer has run or a timer is cancelled.
+	bool Pending(TimerId id) const;
+
+	// Runs "fn" on the pool as soon as a thread is free.
+	void Post(Callback fn);
+
+	WorkerPool& Pool() { return m_pool; }
+
+	// The time the timers run on: the kernel's, or wall-clock time.
+	const SimClock& GetClock() const;
+
+	// Null unless the timers run on a SimKernel.
+	SimKernel* Kernel() const { return m_config.kernel; }
+
+	// Number of timers.
+	std::size_t Size() const;
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	struct Timer
+	{
+		std::uint64_t period {0}; // Ticks; 0 for a one-shot
+		Callback fn;
+		bool running {false};     // Queued or running; guarded by m_mutex
+		bool started {false};     // Running its callback; guarded by m_mutex
+	};
+
+	TimerId Add_(std::chrono::milliseconds delay, std::uint64_t period, Callback fn);
+	std::uint64_t Ticks_(std::chrono::milliseconds duration) const;
+	std::uint64_t Now_() const;
+	void Run_();
+	void Expire_(TimerId id, std::uint64_t deadline, std::uint64_t now);
+	void Fire_(TimerId id, const std::shared_ptr<Timer>& timer);
+	void Arm_(TimerId id, std::chrono::nanoseconds delay);
+	void FireEvent_(TimerId id);
+
+private:
+	const SchedulerConfig m_config;
+	const Clock::time_point m_epoch;
+
+	// Declared first so that it outlives the timekeeping thread.
+	WorkerPool m_pool;
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_cv;
+	std::condition_variable m_idle;
+	std::map<TimerId, std::shared_ptr<Timer>> m_timers;
+
+	// Cancelled timers are left in the wheel and skipped when they expire.
+	TimerWheel<TimerId> m_wheel;
+	TimerId m_nextId {1};
+	int m_running {0};
+	bool m_stopping {false};
+
+	std::thread m_thread;
+};
+
+// The process-wide scheduler used by tasks that aren't given one. Created on
+// first use.
+Scheduler& scheduler();
+
+} // namespace ncc
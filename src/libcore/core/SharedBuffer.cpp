@@ -0,0 +1,354 @@
+#include <core/Logger.h>
+#include <core/SharedBuffer.h>
+#include <core/ZcmMessage.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <random>
+#include <system_error>
+
+namespace ncc
+{
+
+namespace
+{
+
+// Start of the pool. The layout is:
+//    PoolHeader | SlotHeader[slotCount] | slotCount * slotSize bytes
+struct PoolHeader
+{
+	std::uint64_t magic;
+	std::uint64_t slotCount;
+	std::uint64_t slotSize;
+	std::uint64_t id; // Random; descriptors carry it as poolId
+};
+
+constexpr std::uint64_t poolMagic {0x6e63632d73686d31}; // "ncc-shm1"
+constexpr std::size_t cacheLine {64};
+
+constexpr std::size_t AlignUp(std::size_t n, std::size_t align)
+{
+	return (n + align - 1) / align * align;
+}
+
+// A slot's state packs the generation (high 32 bits) and the reference count
+// (low 32 bits) so both are updated with a single CAS.
+constexpr std::uint64_t MakeState(std::uint32_t generation, std::uint32_t refs)
+{
+	return (static_cast<std::uint64_t>(generation) << 32) | refs;
+}
+
+constexpr std::uint32_t Generation(std::uint64_t state) { return static_cast<std::uint32_t>(state >> 32); }
+constexpr std::uint32_t Refs(std::uint64_t state) { return static_cast<std::uint32_t>(state); }
+
+} // namespace
+
+// The pool's memory, mapped into this process.
+struct SharedBuffer::Mapping
+{
+	Mapping(int fd, std::size_t length, std::byte* base)
+		: fd(fd)
+		, length(length)
+		, base(base)
+	{
+	}
+
+	~Mapping()
+	{
+		munmap(base, length);
+		close(fd);
+	}
+
+	const PoolHeader& Header() const { return *reinterpret_cast<const PoolHeader*>(base); }
+
+	SlotHeader* Slot(std::size_t index) const;
+	std::byte* Data(std::size_t index) const;
+
+	int fd {-1};
+	std::size_t length {0};
+	std::byte* base {nullptr};
+};
+
+// Lives in shared memory; every process maps the same counters.
+struct alignas(cacheLine) SharedBuffer::SlotHeader
+{
+	std::atomic<std::uint64_t> state;
+	static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "Shared counters must be lock free.");
+};
+
+SharedBuffer::SlotHeader* SharedBuffer::Mapping::Slot(std::size_t index) const
+{
+	auto slots = base + AlignUp(sizeof(PoolHeader), cacheLine);
+	return reinterpret_cast<SlotHeader*>(slots) + index;
+}
+
+std::byte* SharedBuffer::Mapping::Data(std::size_t index) const
+{
+	const auto& header = Header();
+	auto data = base + AlignUp(sizeof(PoolHeader), cacheLine) + header.slotCount * sizeof(SlotHeader);
+	return data + index * header.slotSize;
+}
+
+SharedBuffer::SharedBuffer(
+		std::shared_ptr<Mapping> mapping,
+		SlotHeader* slot,
+		std::byte* data,
+		const Demo::shm_buffer_t& desc)
+	: m_mapping(std::move(mapping))
+	, m_slot(slot)
+	, m_data(data)
+	, m_size(static_cast<std::size_t>(desc.size))
+	, m_desc(desc)
+{
+}
+
+SharedBuffer::~SharedBuffer()
+{
+	Release();
+}
+
+SharedBuffer::SharedBuffer(SharedBuffer&& other) noexcept
+	: m_mapping(std::move(other.m_mapping))
+	, m_slot(std::exchange(other.m_slot, nullptr))
+	, m_data(std::exchange(other.m_data, nullptr))
+	, m_size(std::exchange(other.m_size, 0))
+	, m_desc(other.m_desc)
+{
+}
+
+SharedBuffer& SharedBuffer::operator=(SharedBuffer&& other) noexcept
+{
+	if (&other != this)
+	{
+		Release();
+		m_mapping = std::move(other.m_mapping);
+		m_slot = std::exchange(other.m_slot, nullptr);
+		m_data = std::exchange(other.m_data, nullptr);
+		m_size = std::exchange(other.m_size, 0);
+		m_desc = other.m_desc;
+	}
+	return *this;
+}
+
+void SharedBuffer::Release()
+{
+	if (m_slot)
+	{
+		// The slot is free once the count reaches zero; the generation stays
+		// until the next Allocate().
+		m_slot->state.fetch_sub(1, std::memory_order_acq_rel);
+		m_slot = nullptr;
+		m_data = nullptr;
+		m_size = 0;
+		m_mapping.reset();
+	}
+}
+
+SharedBufferPool::SharedBufferPool(const std::string& name, std::size_t slotCount, std::size_t slotSize)
+	: m_slotCount(slotCount)
+	, m_slotSize(AlignUp(slotSize, cacheLine))
+{
+	std::size_t length = AlignUp(sizeof(PoolHeader), cacheLine)
+		+ m_slotCount * sizeof(SharedBuffer::SlotHeader)
+		+ m_slotCount * m_slotSize;
+
+	int fd = memfd_create(name.c_str(), MFD_CLOEXEC);
+	if (fd < 0)
+	{
+		throw std::system_error(errno, std::generic_category(), "memfd_create() failed");
+	}
+	if (ftruncate(fd, static_cast<off_t>(length)) < 0)
+	{
+		int err = errno;
+		close(fd);
+		throw std::system_error(err, std::generic_category(), "ftruncate() failed");
+	}
+
+	void* base = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (base == MAP_FAILED)
+	{
+		int err = errno;
+		close(fd);
+		throw std::system_error(err, std::generic_category(), "mmap() failed");
+	}
+
+	// A new memfd is zero filled, so every slot starts free at generation 0.
+	// Generation 0 is never handed out.
+	m_mapping = std::make_shared<SharedBuffer::Mapping>(fd, length, static_cast<std::byte*>(base));
+	auto header = reinterpret_cast<PoolHeader*>(base);
+	header->slotCount = m_slotCount;
+	header->slotSize = m_slotSize;
+	header->id = (static_cast<std::uint64_t>(std::random_device {}()) << 32) | std::random_device {}();
+	header->magic = poolMagic;
+
+	logger()->debug("SharedBufferPool(\"{}\"): {} x {} bytes, fd={}", name, m_slotCount, m_slotSize, fd);
+}
+
+SharedBuffer SharedBufferPool::Allocate(std::size_t size)
+{
+	if (size > m_slotSize)
+	{
+		logger()->error("SharedBufferPool::Allocate(size={}): larger than slot size {}", size, m_slotSize);
+		return {};
+	}
+
+	// Round robin so a slot that was just released isn't reused right away,
+	// which leaves slow readers more time to acquire it.
+	std::size_t start = m_next.fetch_add(1, std::memory_order_relaxed);
+	for (std::size_t i = 0; i < m_slotCount; ++i)
+	{
+		std::size_t index = (start + i) % m_slotCount;
+		auto slot = m_mapping->Slot(index);
+
+		std::uint64_t state = slot->state.load(std::memory_order_acquire);
+		if (Refs(state) != 0)
+		{
+			continue;
+		}
+
+		std::uint32_t generation = Generation(state) + 1;
+		if (generation == 0)
+		{
+			generation = 1;
+		}
+		if (!slot->state.compare_exchange_strong(state, MakeState(generation, 1), std::memory_order_acq_rel))
+		{
+			continue; // Taken by another thread.
+		}
+
+		Demo::shm_buffer_t desc;
+		desc.utime = UtimeNow();
+		desc.pid = getpid();
+		desc.fd = m_mapping->fd;
+		desc.poolSize = static_cast<std::int64_t>(m_mapping->length);
+		desc.poolId = static_cast<std::int64_t>(m_mapping->Header().id);
+		desc.slot = static_cast<std::int32_t>(index);
+		desc.generation = static_cast<std::int32_t>(generation);
+		desc.size = static_cast<std::int64_t>(size);
+		return SharedBuffer(m_mapping, slot, m_mapping->Data(index), desc);
+	}
+
+	logger()->warn("SharedBufferPool::Allocate(size={}): all {} slots are in use", size, m_slotCount);
+	return {};
+}
+
+std::size_t SharedBufferPool::InUse() const
+{
+	std::size_t count {0};
+	for (std::size_t i = 0; i < m_slotCount; ++i)
+	{
+		if (Refs(m_mapping->Slot(i)->state.load(std::memory_order_relaxed)) != 0)
+		{
+			++count;
+		}
+	}
+	return count;
+}
+
+SharedBuffer SharedBufferReader::Acquire(const Demo::shm_buffer_t& desc)
+{
+	auto mapping = Map_(desc);
+	if (!mapping)
+	{
+		return {};
+	}
+
+	const auto& header = mapping->Header();
+	if (desc.slot < 0 || static_cast<std::uint64_t>(desc.slot) >= header.slotCount
+		|| desc.size < 0 || static_cast<std::uint64_t>(desc.size) > header.slotSize)
+	{
+		logger()->warn("SharedBufferReader::Acquire(): invalid descriptor (slot={}, size={})", desc.slot, desc.size);
+		return {};
+	}
+
+	// Only take a reference while the slot still holds the buffer described
+	// by "desc", i.e. it is referenced and hasn't been reallocated.
+	auto slot = mapping->Slot(desc.slot);
+	auto generation = static_cast<std::uint32_t>(desc.generation);
+	std::uint64_t state = slot->state.load(std::memory_order_acquire);
+	do
+	{
+		if (Generation(state) != generation || Refs(state) == 0)
+		{
+			return {};
+		}
+	} while (!slot->state.compare_exchange_weak(state, state + 1, std::memory_order_acq_rel));
+
+	return SharedBuffer(mapping, slot, mapping->Data(desc.slot), desc);
+}
+
+std::shared_ptr<SharedBuffer::Mapping> SharedBufferReader::Map_(const Demo::shm_buffer_t& desc)
+{
+	std::unique_lock lock(m_mutex);
+
+	if (desc.poolSize < static_cast<std::int64_t>(sizeof(PoolHeader)))
+	{
+		return nullptr;
+	}
+
+	// The publisher may have closed the pool and reused its fd (or its pid)
+	// for a new one, so the mapping only serves descriptors of the same pool.
+	// Buffers acquired from a stale mapping keep it alive.
+	auto key = std::make_pair(desc.pid, desc.fd);
+	auto it = m_mappings.find(key);
+	if (it != m_mappings.end())
+	{
+		if (it->second->Header().id == static_cast<std::uint64_t>(desc.poolId))
+		{
+			return it->second;
+		}
+		m_mappings.erase(it);
+	}
+
+	// Opening the descriptor through /proc creates a new reference to the
+	// publisher's memfd, even from another process.
+	std::string path = "/proc/" + std::to_string(desc.pid) + "/fd/" + std::to_string(desc.fd);
+	int fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+	if (fd < 0)
+	{
+		logger()->error("SharedBufferReader::Map_(): open(\"{}\") failed: errno={}", path, errno);
+		return nullptr;
+	}
+
+	// Touching a mapping beyond the end of the file raises SIGBUS, so don't
+	// trust the descriptor's size.
+	struct stat st {};
+	if (fstat(fd, &st) < 0 || st.st_size < desc.poolSize)
+	{
+		logger()->error("SharedBufferReader::Map_(): \"{}\" is smaller than {} bytes", path, desc.poolSize);
+		close(fd);
+		return nullptr;
+	}
+
+	auto length = static_cast<std::size_t>(desc.poolSize);
+	void* base = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (base == MAP_FAILED)
+	{
+		logger()->error("SharedBufferReader::Map_(): mmap(\"{}\") failed: errno={}", path, errno);
+		close(fd);
+		return nullptr;
+	}
+
+	auto mapping = std::make_shared<SharedBuffer::Mapping>(fd, length, static_cast<std::byte*>(base));
+	const auto& header = mapping->Header();
+	if (header.magic != poolMagic || length < AlignUp(sizeof(PoolHeader), cacheLine)
+		+ header.slotCount * (sizeof(SharedBuffer::SlotHeader) + header.slotSize))
+	{
+		logger()->error("SharedBufferReader::Map_(): \"{}\" is not a shared buffer pool", path);
+		return nullptr;
+	}
+	if (header.id != static_cast<std::uint64_t>(desc.poolId))
+	{
+		logger()->warn("SharedBufferReader::Map_(): \"{}\" is no longer the described pool", path);
+		return nullptr;
+	}
+
+	m_mappings.emplace(key, mapping);
+	return mapping;
+}
+
+} // namespace ncc
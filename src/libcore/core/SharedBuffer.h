@@ -0,0 +1,135 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <utility>
+
+#include <types/Demo/shm_buffer_t.hpp>
+
+namespace ncc
+{
+
+// Large payloads (snapshots, video frames, state dumps) don't go through the
+// broker. The publisher writes them into a SharedBufferPool and publishes the
+// small Demo::shm_buffer_t descriptor instead:
+//
+//    auto buffer = pool.Allocate(size);
+//    std::memcpy(buffer.Data().data(), frame, size);
+//    mqtt.Publish("/video/frame", buffer.Descriptor());
+//
+// Subscribers in any process on the same host map the pool once and read the
+// data in place:
+//
+//    auto buffer = reader.Acquire(desc);
+//    if (buffer) { Process(buffer.Data()); }
+//
+// Every SharedBuffer holds a reference on its slot and the slot is reused once
+// the last reference is released. Readers must acquire before the publisher
+// releases its own reference, so publishers typically keep a buffer until
+// they publish the next one. A descriptor for a slot that has since been
+// reused is detected by its generation and Acquire() fails.
+//
+// NOTE: Other processes open the pool through /proc/<pid>/fd/<fd>, which
+// requires them to run as the same user as the publisher.
+// NOTE: References are counted in the shared memory itself, so a reader that
+// crashes while holding a buffer leaks its slot until the pool is recreated.
+
+class SharedBufferReader;
+class SharedBufferPool;
+
+// A reference to one buffer in a shared memory pool. Move-only; the reference
+// is released when the object is destroyed.
+class SharedBuffer
+{
+public:
+	SharedBuffer() = default;
+	~SharedBuffer();
+
+	SharedBuffer(SharedBuffer&& other) noexcept;
+	SharedBuffer& operator=(SharedBuffer&& other) noexcept;
+
+	SharedBuffer(const SharedBuffer&) = delete;
+	SharedBuffer& operator=(const SharedBuffer&) = delete;
+
+	explicit operator bool() const { return m_slot != nullptr; }
+
+	// The used part of the buffer. Only the publisher may write to it, and
+	// only before publishing the descriptor.
+	std::span<std::byte> Data() { return {m_data, m_size}; }
+	std::span<const std::byte> Data() const { return {m_data, m_size}; }
+
+	std::size_t Size() const { return m_size; }
+	const Demo::shm_buffer_t& Descriptor() const { return m_desc; }
+
+	void Release();
+
+private:
+	friend class SharedBufferPool;
+	friend class SharedBufferReader;
+
+	struct Mapping;
+	struct SlotHeader;
+
+	SharedBuffer(std::shared_ptr<Mapping> mapping, SlotHeader* slot, std::byte* data, const Demo::shm_buffer_t& desc);
+
+private:
+	// Keeps the pool mapped while the buffer is referenced.
+	std::shared_ptr<Mapping> m_mapping;
+	SlotHeader* m_slot {nullptr};
+	std::byte* m_data {nullptr};
+	std::size_t m_size {0};
+	Demo::shm_buffer_t m_desc {};
+};
+
+// Fixed-size buffers in a memfd that is shared with other processes. Throws
+// std::system_error if the memory can't be created.
+class SharedBufferPool
+{
+public:
+	SharedBufferPool(const std::string& name, std::size_t slotCount, std::size_t slotSize);
+
+	SharedBufferPool(const SharedBufferPool&) = delete;
+	SharedBufferPool& operator=(const SharedBufferPool&) = delete;
+
+	// Returns a buffer of "size" bytes or an empty SharedBuffer if "size" is
+	// larger than a slot or every slot is still referenced.
+	SharedBuffer Allocate(std::size_t size);
+
+	std::size_t SlotCount() const { return m_slotCount; }
+	std::size_t SlotSize() const { return m_slotSize; }
+
+	// Number of slots currently referenced, by this or any other process.
+	std::size_t InUse() const;
+
+private:
+	std::shared_ptr<SharedBuffer::Mapping> m_mapping;
+	std::size_t m_slotCount {0};
+	std::size_t m_slotSize {0};
+	std::atomic<std::size_t> m_next {0};
+};
+
+// Maps the pools referenced by descriptors. Each pool is mapped once and kept
+// mapped for the lifetime of the reader, or until a descriptor shows that its
+// fd now holds another pool.
+class SharedBufferReader
+{
+public:
+	// Returns an empty SharedBuffer if the pool can't be mapped or the slot
+	// has already been released or reused.
+	SharedBuffer Acquire(const Demo::shm_buffer_t& desc);
+
+private:
+	std::shared_ptr<SharedBuffer::Mapping> Map_(const Demo::shm_buffer_t& desc);
+
+private:
+	std::mutex m_mutex;
+	std::map<std::pair<int, int>, std::shared_ptr<SharedBuffer::Mapping>> m_mappings;
+};
+
+} // namespace ncc
@@ -0,0 +1,32 @@
+#include <core/SimClock.h>
+#include <core/ZcmMessage.h>
+
+namespace ncc
+{
+
+namespace
+{
+
+class RealClock : public SimClock
+{
+public:
+	std::chrono::nanoseconds Now() const override
+	{
+		return std::chrono::steady_clock::now().time_since_epoch();
+	}
+
+	std::int64_t Utime() const override
+	{
+		return UtimeNow();
+	}
+};
+
+} // namespace
+
+const SimClock& realClock()
+{
+	static const RealClock instance;
+	return instance;
+}
+
+} // namespace ncc
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace ncc
+{
+
+// SimClock is the time the simulation runs on: wall-clock time by default
+// (see realClock()), or the virtual time of a SimKernel. Tasks get it from
+// their Scheduler, so the same code runs in real time or accelerated.
+class SimClock
+{
+public:
+	virtual ~SimClock() = default;
+
+	// Time since an arbitrary epoch. Never goes backward.
+	virtual std::chrono::nanoseconds Now() const = 0;
+
+	// Microseconds since the Unix epoch, for message timestamps (see
+	// UtimeNow()).
+	virtual std::int64_t Utime() const = 0;
+};
+
+// Wall-clock time.
+const SimClock& realClock();
+
+} // namespace ncc
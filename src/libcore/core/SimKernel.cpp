@@ -0,0 +1,220 @@
+#include <core/Logger.h>
+#include <core/SimKernel.h>
+
+#include <algorithm>
+#include <exception>
+
+namespace ncc
+{
+
+namespace
+{
+
+// The kernel whose event is running on this thread, so that an event can
+// cancel itself (or its owner's other events) without waiting for itself.
+thread_local const SimKernel* t_kernel {nullptr};
+
+struct Later
+{
+	template <typename T>
+	bool operator()(const T& a, const T& b) const
+	{
+		return a.time != b.time ? a.time > b.time : a.id > b.id;
+	}
+};
+
+} // namespace
+
+SimKernel::SimKernel(const SimKernelConfig& config)
+	: m_config(config)
+	, m_realBase(RealClock::now())
+	, m_thread(&SimKernel::Run_, this)
+{
+}
+
+SimKernel::~SimKernel()
+{
+	{
+		std::unique_lock lock(m_mutex);
+		m_stopping = true;
+		m_cv.notify_one();
+		m_idle.notify_all();
+	}
+	m_thread.join();
+}
+
+SimKernel::EventId SimKernel::After(std::chrono::nanoseconds delay, Callback fn, const void* owner)
+{
+	std::unique_lock lock(m_mutex);
+	auto id = m_nextId++;
+	auto time = std::chrono::nanoseconds(m_now.load(std::memory_order_relaxed)) + std::max(delay, std::chrono::nanoseconds::zero());
+	m_events.emplace(id, Event {std::move(fn), owner});
+	m_heap.push_back({time, id});
+	std::push_heap(m_heap.begin(), m_heap.end(), Later {});
+
+	// Only an event that is now the earliest can change what the kernel
+	// thread waits for.
+	if (m_heap.front().id == id)
+	{
+		if (time <= m_horizon)
+		{
+			m_waiting = false;
+		}
+		m_cv.notify_one();
+	}
+	return id;
+}
+
+bool SimKernel::Cancel(EventId id)
+{
+	std::unique_lock lock(m_mutex);
+	if (m_events.erase(id))
+	{
+		return true;
+	}
+	if (m_current == id && t_kernel != this)
+	{
+		m_idle.wait(lock, [this, id]() { return m_current != id; });
+	}
+	return false;
+}
+
+void SimKernel::CancelAll(const void* owner)
+{
+	std::unique_lock lock(m_mutex);
+	std::erase_if(m_events, [owner](const auto& event) { return event.second.owner == owner; });
+	if (t_kernel != this)
+	{
+		m_idle.wait(lock, [this, owner]() { return !m_current || m_currentOwner != owner; });
+	}
+}
+
+void SimKernel::RunFor(std::chrono::nanoseconds duration)
+{
+	std::unique_lock lock(m_mutex);
+	auto horizon = std::chrono::nanoseconds(m_now.load(std::memory_order_relaxed)) + duration;
+	SetHorizon_(horizon);
+	m_idle.wait(lock, [this, horizon]() {
+		return m_stopping || (m_waiting && m_now.load(std::memory_order_relaxed) >= horizon.count());
+	});
+}
+
+void SimKernel::Start()
+{
+	std::unique_lock lock(m_mutex);
+	SetHorizon_(forever);
+}
+
+std::chrono::nanoseconds SimKernel::Now() const
+{
+	return std::chrono::nanoseconds(m_now.load(std::memory_order_acquire));
+}
+
+std::int64_t SimKernel::Utime() const
+{
+	return m_config.startUtime + std::chrono::duration_cast<std::chrono::microseconds>(Now()).count();
+}
+
+std::uint64_t SimKernel::Executed() const
+{
+	return m_executed.load(std::memory_order_relaxed);
+}
+
+std::size_t SimKernel::Pending() const
+{
+	std::unique_lock lock(m_mutex);
+	return m_events.size();
+}
+
+void SimKernel::SetHorizon_(std::chrono::nanoseconds horizon)
+{
+	// Pace from here: the time spent paused doesn't count.
+	m_simBase = std::chrono::nanoseconds(m_now.load(std::memory_order_relaxed));
+	m_realBase = RealClock::now();
+	m_horizon = horizon;
+	m_waiting = false;
+	m_cv.notify_one();
+}
+
+SimKernel::RealClock::time_point SimKernel::RealTime_(std::chrono::nanoseconds time) const
+{
+	std::chrono::duration<double, std::nano> elapsed((time - m_simBase).count() / m_config.rate);
+	return m_realBase + std::chrono::duration_cast<RealClock::duration>(elapsed);
+}
+
+void SimKernel::Run_()
+{
+	const bool paced {m_config.rate > 0.0};
+
+	std::unique_lock lock(m_mutex);
+	while (!m_stopping)
+	{
+		while (!m_heap.empty() && !m_events.contains(m_heap.front().id))
+		{
+			std::pop_heap(m_heap.begin(), m_heap.end(), Later {});
+			m_heap.pop_back();
+		}
+
+		auto now = std::chrono::nanoseconds(m_now.load(std::memory_order_relaxed));
+		auto next = std::min(m_heap.empty() ? forever : m_heap.front().time, m_horizon);
+		if (next > now && paced && next != forever)
+		{
+			// Wait for the event (or the horizon) in real time; a new earlier
+			// event or horizon wakes us up to recompute.
+			auto due = RealTime_(next);
+			if (RealClock::now() < due)
+			{
+				m_cv.wait_until(lock, due);
+				continue;
+			}
+		}
+
+		if (m_heap.empty() || m_heap.front().time > m_horizon)
+		{
+			// Nothing to run before the horizon: the clock reaches it.
+			if (m_horizon != forever && now < m_horizon)
+			{
+				m_now.store(m_horizon.count(), std::memory_order_release);
+			}
+			m_waiting = true;
+			m_idle.notify_all();
+			m_cv.wait(lock);
+			continue;
+		}
+
+		auto entry = m_heap.front();
+		std::pop_heap(m_heap.begin(), m_heap.end(), Later {});
+		m_heap.pop_back();
+		auto it = m_events.find(entry.id);
+		auto event = std::move(it->second);
+		m_events.erase(it);
+
+		m_now.store(std::max(entry.time, now).count(), std::memory_order_release);
+		m_current = entry.id;
+		m_currentOwner = event.owner;
+		lock.unlock();
+
+		t_kernel = this;
+		try
+		{
+			event.fn();
+		}
+		catch (const std::exception& e)
+		{
+			logger()->error("SimKernel::Run_(): {}: event threw: {}", m_config.name, e.what());
+		}
+		t_kernel = nullptr;
+		m_executed.fetch_add(1, std::memory_order_relaxed);
+
+		// Destroy the callable (and what it captured) before reporting the
+		// event as done; Cancel() callers may be about to free it.
+		event.fn = nullptr;
+
+		lock.lock();
+		m_current = 0;
+		m_currentOwner = nullptr;
+		m_idle.notify_all();
+	}
+}
+
+} // namespace ncc
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <core/InplaceFunction.h>
+#include <core/SimClock.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace ncc
+{
+
+struct SimKernelConfig
+{
+	std::string name {"SimKernel"};
+
+	// Virtual seconds per real second, i.e. 60 runs an hour in a minute. 0
+	// runs as fast as possible.
+	double rate {0.0};
+
+	// Utime() at virtual time 0. A fixed value (not the wall clock) keeps the
+	// timestamps of a run reproducible.
+	std::int64_t startUtime {0};
+};
+
+// SimKernel is a discrete-event simulation kernel: a virtual clock and a
+// priority queue of events ordered by time, run one at a time on the
+// kernel's thread. Time only advances when the next event is due, so an hour
+// with an event a second takes 3600 events, not an hour.
+//
+// Events that come due at the same time run in the order they were added, so
+// as long as everything in the simulation happens in events (see
+// SchedulerConfig::kernel and SimMqttClient), a run is deterministic: it
+// gives the same results whatever the rate and however loaded the machine.
+//
+// The kernel starts paused at virtual time 0, so the simulation can be set up
+// before anything runs: until the first RunFor() or Start(), no event runs,
+// not even one due at time 0. RunFor() then lets it run up to a horizon,
+// either as fast as possible or paced at "rate" times real time. Events added
+// while it is paused after that still run if they are due at the current time
+// (i.e. Post()), so that tasks can be stopped. Before then, only tasks that
+// never ran can be destroyed (an idle CoExecutor stops without the kernel).
+class SimKernel : public SimClock
+{
+public:
+	using Callback = InplaceFunction<void()>;
+	using EventId = std::uint64_t;
+
+	explicit SimKernel(const SimKernelConfig& config = {});
+
+	// Pending events are dropped without running.
+	~SimKernel() override;
+
+	SimKernel(const SimKernel&) = delete;
+	SimKernel& operator=(const SimKernel&) = delete;
+
+	// Calls "fn" "delay" from now (virtual time). Events added by "owner" can
+	// all be cancelled with CancelAll().
+	EventId After(std::chrono::nanoseconds delay, Callback fn, const void* owner = nullptr);
+
+	// Calls "fn" at the current time, after the events already due.
+	EventId Post(Callback fn, const void* owner = nullptr) { return After({}, std::move(fn), owner); }
+
+	// Removes the event. If it is running on another thread, waits for it to
+	// return. Returns false if there was no such event (i.e. it ran).
+	bool Cancel(EventId id);
+
+	// Cancel() for every event added by "owner".
+	void CancelAll(const void* owner);
+
+	// Runs the events due in the next "duration" of virtual time and returns
+	// once the clock has advanced that far (or the kernel is destroyed).
+	void RunFor(std::chrono::nanoseconds duration);
+
+	// Runs without a horizon, until the kernel is destroyed. Doesn't block.
+	void Start();
+
+	std::chrono::nanoseconds Now() const override;
+	std::int64_t Utime() const override;
+
+	// Events run so far and still pending.
+	std::uint64_t Executed() const;
+	std::size_t Pending() const;
+
+	const SimKernelConfig& Config() const { return m_config; }
+
+private:
+	using RealClock = std::chrono::steady_clock;
+
+	static constexpr std::chrono::nanoseconds forever {std::numeric_limits<std::chrono::nanoseconds::rep>::max()};
+
+	struct Entry
+	{
+		std::chrono::nanoseconds time;
+		EventId id; // Also the order among events due at the same time
+	};
+
+	struct Event
+	{
+		Callback fn;
+		const void* owner {nullptr};
+	};
+
+	void Run_();
+	void SetHorizon_(std::chrono::nanoseconds horizon);
+	RealClock::time_point RealTime_(std::chrono::nanoseconds time) const;
+
+private:
+	const SimKernelConfig m_config;
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_cv;   // Wakes the kernel thread
+	std::condition_variable m_idle; // Signals the end of an event or a RunFor()
+
+	// Min-heap on (time, id). Cancelled events are left in it and skipped.
+	std::vector<Entry> m_heap;
+	std::unordered_map<EventId, Event> m_events;
+	EventId m_nextId {1};
+
+	std::atomic<std::int64_t> m_now {0}; // Nanoseconds
+	std::chrono::nanoseconds m_horizon {-1};
+	bool m_waiting {true}; // Nothing to run before the horizon
+	bool m_stopping {false};
+	std::atomic<std::uint64_t> m_executed {0};
+
+	EventId m_current {0};
+	const void* m_currentOwner {nullptr};
+
+	// Pacing: virtual time m_simBase was reached at real time m_realBase.
+	std::chrono::nanoseconds m_simBase {0};
+	RealClock::time_point m_realBase;
+
+	std::thread m_thread;
+};
+
+} // namespace ncc
@@ -0,0 +1,227 @@
+#include <core/Logger.h>
+#include <core/Mailbox.h>
+#include <core/MqttMessage.h>
+#include <core/SimMqttClient.h>
+
+#include <algorithm>
+#include <exception>
+
+#include <nlohmann/json.hpp>
+
+namespace ncc
+{
+
+namespace
+{
+
+// FNV-1a
+constexpr std::uint64_t fnvOffset {14695981039346656037ull};
+constexpr std::uint64_t fnvPrime {1099511628211ull};
+
+std::uint64_t Hash(std::uint64_t hash, std::span<const std::byte> bytes)
+{
+	for (auto b : bytes)
+	{
+		hash = (hash ^ static_cast<std::uint64_t>(b)) * fnvPrime;
+	}
+	return hash;
+}
+
+} // namespace
+
+SimMqttClient::SimMqttClient(SimKernel& kernel, const SimMqttConfig& config)
+	: m_kernel(kernel)
+	, m_config(config)
+	, m_digest(fnvOffset)
+{
+}
+
+SimMqttClient::~SimMqttClient()
+{
+	m_kernel.CancelAll(this);
+}
+
+void SimMqttClient::RegisterSub(const std::string& topic, IMqttSubscriber* sub, bool replay)
+{
+	std::unique_lock lock(m_mutex);
+	m_subs.insert(sub);
+	auto& subs = m_topics.Insert(topic)->values;
+	if (std::find(subs.begin(), subs.end(), sub) == subs.end())
+	{
+		subs.push_back(sub);
+	}
+
+	if (!replay)
+	{
+		return;
+	}
+	TopicTrie<bool> filter;
+	filter.Insert(topic)->values.push_back(true);
+	for (const auto& [retainedTopic, payload] : m_retained)
+	{
+		bool match {false};
+		filter.Match(retainedTopic, [&match](const auto&) { match = true; });
+		if (match)
+		{
+			auto seq = m_nextDelivery++;
+			m_deliveries.emplace(seq, Delivery {retainedTopic, payload, sub});
+			m_kernel.Post([this, seq]() { Deliver_(seq); }, this);
+		}
+	}
+}
+
+void SimMqttClient::UnregisterSub(IMqttSubscriber* sub)
+{
+	// Once this returns, no delivery is still calling "sub".
+	std::unique_lock dispatchLock(m_dispatchMutex);
+	std::unique_lock lock(m_mutex);
+	m_subs.erase(sub);
+	m_topics.ForEach([sub](auto& node) {
+		std::erase(node.values, sub);
+	});
+}
+
+bool SimMqttClient::Publish(
+	const std::string& topic,
+	const nlohmann::json& json,
+	int qos,
+	bool retain,
+	const std::chrono::duration<long, std::ratio<1, 1>>& delay)
+{
+	std::string jsonstr = json.dump();
+	return Publish(topic, std::as_bytes(std::span(jsonstr)), qos, retain, delay);
+}
+
+bool SimMqttClient::Publish(
+	const std::string& topic,
+	std::span<const std::byte> payload,
+	int qos,
+	bool retain,
+	const std::chrono::duration<long, std::ratio<1, 1>>& delay)
+{
+	std::unique_lock lock(m_mutex);
+	std::vector<std::byte> bytes(payload.begin(), payload.end());
+	if (retain)
+	{
+		// As with a broker, an empty retained message clears the topic.
+		if (bytes.empty())
+		{
+			m_retained.erase(topic);
+		}
+		else
+		{
+			m_retained[topic] = bytes;
+		}
+	}
+	m_latest[topic] = bytes;
+
+	auto now = m_kernel.Now().count();
+	m_digest = Hash(m_digest, std::as_bytes(std::span(&now, 1)));
+	m_digest = Hash(m_digest, std::as_bytes(std::span(topic)));
+	m_digest = Hash(m_digest, payload);
+	++m_published;
+
+	auto seq = m_nextDelivery++;
+	m_deliveries.emplace(seq, Delivery {topic, std::move(bytes)});
+	m_kernel.After(m_config.latency, [this, seq]() { Deliver_(seq); }, this);
+	return true;
+}
+
+PublishToken SimMqttClient::PublishTracked(
+	const std::string& topic,
+	std::span<const std::byte> payload,
+	int qos,
+	bool retain)
+{
+	Publish(topic, payload, qos, retain);
+	return {};
+}
+
+bool SimMqttClient::IsTopicMatch(const std::string& sub, const std::string& topic)
+{
+	TopicTrie<bool> trie;
+	trie.Insert(sub)->values.push_back(true);
+	bool match {false};
+	trie.Match(topic, [&match](const auto&) { match = true; });
+	return match;
+}
+
+bool SimMqttClient::GetLatest(const std::string& topic, std::vector<std::byte>& payload) const
+{
+	std::unique_lock lock(m_mutex);
+	auto it = m_latest.find(topic);
+	if (it == m_latest.end())
+	{
+		return false;
+	}
+	payload = it->second;
+	return true;
+}
+
+std::uint64_t SimMqttClient::Published() const
+{
+	std::unique_lock lock(m_mutex);
+	return m_published;
+}
+
+std::uint64_t SimMqttClient::Digest() const
+{
+	std::unique_lock lock(m_mutex);
+	return m_digest;
+}
+
+void SimMqttClient::Deliver_(std::uint64_t seq)
+{
+	std::unique_lock dispatchLock(m_dispatchMutex);
+
+	Delivery delivery;
+	std::vector<IMqttSubscriber*> subs;
+	{
+		std::unique_lock lock(m_mutex);
+		auto it = m_deliveries.find(seq);
+		if (it == m_deliveries.end())
+		{
+			return;
+		}
+		delivery = std::move(it->second);
+		m_deliveries.erase(it);
+
+		if (delivery.sub)
+		{
+			if (m_subs.contains(delivery.sub))
+			{
+				subs.push_back(delivery.sub);
+			}
+		}
+		else
+		{
+			m_topics.Match(delivery.topic, [&subs](const auto& node) {
+				subs.insert(subs.end(), node.values.begin(), node.values.end());
+			});
+		}
+	}
+
+	MqttMessage message(delivery.topic, delivery.payload);
+	for (auto sub : subs)
+	{
+		if (auto mailbox = sub->GetMailbox())
+		{
+			if (!mailbox->Post(message))
+			{
+				logger()->warn("SimMqttClient::Deliver_(topic=\"{}\"): mailbox \"{}\" is full, message dropped", message.Topic(), mailbox->Name());
+			}
+			continue;
+		}
+
+		try
+		{
+			sub->OnRawMessage(message);
+		}
+		catch (const std::exception& e)
+		{
+			logger()->error("SimMqttClient::Deliver_(topic=\"{}\"): caught: {}", message.Topic(), e.what());
+		}
+	}
+}
+
+} // namespace ncc
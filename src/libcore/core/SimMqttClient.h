@@ -0,0 +1,109 @@
+#pragma once
+
+#include <core/IMqttClient.h>
+#include <core/SimKernel.h>
+#include <core/TopicTrie.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace ncc
+{
+
+struct SimMqttConfig
+{
+	// Virtual time from publish to delivery.
+	std::chrono::microseconds latency {0};
+};
+
+// SimMqttClient is an in-process broker and client for simulations: every
+// publish is delivered to the matching subscribers as an event of a
+// SimKernel, "latency" later in virtual time, in the order published.
+// Retained messages are kept for replay (see RegisterSub()) and GetLatest()
+// returns the last payload of a topic.
+//
+// With the tasks on a Scheduler driven by the same kernel, a run is
+// deterministic. Digest() (a hash of every publish with its virtual time)
+// tells whether two runs did exactly the same thing, e.g. in a regression
+// test.
+class SimMqttClient : public IMqttClient
+{
+public:
+	explicit SimMqttClient(SimKernel& kernel, const SimMqttConfig& config = {});
+	~SimMqttClient() override;
+
+	void RegisterSub(const std::string& topic, IMqttSubscriber* sub, bool replay = false) override;
+	void UnregisterSub(IMqttSubscriber* sub) override;
+	bool IsConnected() const override { return true; }
+
+	using IMqttClient::Publish;
+
+	bool Publish(
+		const std::string& topic,
+		const nlohmann::json& json,
+		int qos = 0,
+		bool retain = false,
+		const std::chrono::duration<long, std::ratio<1, 1>>& delay = 5s) override;
+
+	bool Publish(
+		const std::string& topic,
+		std::span<const std::byte> payload,
+		int qos = 0,
+		bool retain = false,
+		const std::chrono::duration<long, std::ratio<1, 1>>& delay = 5s) override;
+
+	// Never tracked: the returned token is invalid.
+	PublishToken PublishTracked(
+		const std::string& topic,
+		std::span<const std::byte> payload,
+		int qos = 1,
+		bool retain = false) override;
+
+	PublishStats GetPublishStats() const override { return {}; }
+	bool IsTopicMatch(const std::string& sub, const std::string& topic) override;
+	OutboxStats GetOutboxStats() const override { return {}; }
+	ConnectionStats GetConnectionStats() const override { return {.connected = true}; }
+	std::map<std::string, LatencyStats> GetLatencyStats() const override { return {}; }
+	void ResetLatencyStats() override {}
+	bool GetLatest(const std::string& topic, std::vector<std::byte>& payload) const override;
+
+	std::uint64_t Published() const;
+	std::uint64_t Digest() const;
+
+private:
+	struct Delivery
+	{
+		std::string topic;
+		std::vector<std::byte> payload;
+		IMqttSubscriber* sub {nullptr}; // Only this subscriber (a replay)
+	};
+
+	void Deliver_(std::uint64_t seq);
+
+private:
+	SimKernel& m_kernel;
+	const SimMqttConfig m_config;
+
+	mutable std::mutex m_mutex;
+	TopicTrie<IMqttSubscriber*> m_topics;
+	std::set<IMqttSubscriber*> m_subs;
+	std::map<std::string, std::vector<std::byte>> m_latest;
+	std::map<std::string, std::vector<std::byte>> m_retained;
+	std::map<std::uint64_t, Delivery> m_deliveries; // By sequence number
+	std::uint64_t m_nextDelivery {0};
+	std::uint64_t m_published {0};
+	std::uint64_t m_digest;
+
+	// Held while calling subscribers, so UnregisterSub() can wait for a
+	// delivery in progress. Recursive, as a subscriber may unregister itself.
+	std::recursive_mutex m_dispatchMutex;
+};
+
+} // namespace ncc
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace ncc
+{
+
+// TimerWheel is a hierarchical timing wheel: four levels of 64 slots, where a
+// slot on each level spans 64 times as many ticks as one on the level below.
+// A timer goes on the level of the highest 6-bit digit in which its deadline
+// differs from the current tick. When the current tick reaches its slot the
+// timer is moved down ("cascaded"), so inserting and expiring cost O(1)
+// however many timers there are. Deadlines 2^24 or more ticks away wait in an
+// overflow list until they come within range.
+//
+// Time is counted in ticks and only moves forward through Advance(). Not
+// thread-safe.
+template <typename T>
+class TimerWheel
+{
+public:
+	// Deadlines that have already passed expire on the next tick.
+	void Insert(std::uint64_t deadline, T value)
+	{
+		if (deadline <= m_now)
+		{
+			deadline = m_now + 1;
+		}
+		++m_size;
+		Place_(Entry {deadline, std::move(value)});
+	}
+
+	// Moves time forward to "now", calling expired(value, deadline) for every
+	// timer that is due, in deadline order. "expired" may insert new timers.
+	template <typename Fn>
+	void Advance(std::uint64_t now, Fn&& expired)
+	{
+		while (m_now < now)
+		{
+			if (m_size == 0)
+			{
+				m_now = now;
+				break;
+			}
+			++m_now;
+
+			if ((m_now & Mask(levels)) == 0)
+			{
+				auto overflow = std::move(m_overflow);
+				m_overflow.clear();
+				for (auto& entry : overflow)
+				{
+					Place_(std::move(entry));
+				}
+			}
+			for (int level = levels - 1; level > 0; --level)
+			{
+				if ((m_now & Mask(level)) == 0)
+				{
+					Cascade_(level);
+				}
+			}
+
+			// Nothing can be added to the current slot while it is walked,
+			// since new deadlines are always later than m_now.
+			auto& slot = m_wheel[0][m_now & (slots - 1)];
+			for (std::size_t i = 0; i < slot.size(); ++i)
+			{
+				--m_size;
+				expired(slot[i].value, slot[i].deadline);
+			}
+			slot.clear();
+		}
+	}
+
+	// The earliest tick at which Advance() may have a timer to expire; it may
+	// also be a tick where timers only cascade. Only meaningful if !Empty().
+	std::uint64_t NextTick() const
+	{
+		auto boundary = (m_now | (slots - 1)) + 1;
+		for (auto tick = m_now + 1; tick < boundary; ++tick)
+		{
+			if (!m_wheel[0][tick & (slots - 1)].empty())
+			{
+				return tick;
+			}
+		}
+		return boundary;
+	}
+
+	std::uint64_t Now() const { return m_now; }
+	std::size_t Size() const { return m_size; }
+	bool Empty() const { return m_size == 0; }
+
+private:
+	static constexpr int bits {6};
+	static constexpr std::uint64_t slots {1u << bits};
+	static constexpr int levels {4};
+
+	struct Entry
+	{
+		std::uint64_t deadline;
+		T value;
+	};
+
+	// Ticks below the given level's digit.
+	static constexpr std::uint64_t Mask(int level)
+	{
+		return (std::uint64_t {1} << (bits * level)) - 1;
+	}
+
+	void Place_(Entry entry)
+	{
+		auto diff = entry.deadline ^ m_now;
+		int level {0};
+		while (level < levels && (diff >> (bits * (level + 1))) != 0)
+		{
+			++level;
+		}
+
+		if (level == levels)
+		{
+			m_overflow.push_back(std::move(entry));
+			return;
+		}
+		m_wheel[level][(entry.deadline >> (bits * level)) & (slots - 1)].push_back(std::move(entry));
+	}
+
+	void Cascade_(int level)
+	{
+		auto& slot = m_wheel[level][(m_now >> (bits * level)) & (slots - 1)];
+		auto entries = std::move(slot);
+		slot.clear();
+		for (auto& entry : entries)
+		{
+			Place_(std::move(entry));
+		}
+	}
+
+private:
+	std::array<std::array<std::vector<Entry>, slots>, levels> m_wheel;
+	std::vector<Entry> m_overflow;
+	std::uint64_t m_now {0};
+	std::size_t m_size {0};
+};
+
+} // namespace ncc
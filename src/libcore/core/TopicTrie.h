@@ -0,0 +1,294 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ncc
+{
+
+// TopicTrie indexes MQTT topic filters by level so that finding every filter
+// that matches a topic costs roughly the depth of the topic rather than the
+// number of filters.
+//
+// Each node represents one level of a filter. Literal levels are stored in a
+// map, while the '+' and '#' wildcards have their own child so they can be
+// checked without a lookup. Values (i.e. subscribers) are stored on the node
+// where their filter ends.
+//
+// Matching follows the MQTT rules:
+// - '+' matches exactly one level.
+// - '#' matches the parent level and any number of child levels.
+// - Topics starting with '$' are not matched by a wildcard in the first level.
+//
+// Copies share their nodes (copy-on-write): copying only copies the root, and
+// a change to a shared node copies that node and the path to it first
+// (path copying). So MqttClient can build each new subscription snapshot in
+// time proportional to the change rather than to the number of filters, and
+// a snapshot that has been copied is never modified.
+//
+// NOTE: TopicTrie is not thread safe. A Node* is valid until the next change
+// to a trie that shares nodes with another.
+template <typename T>
+class TopicTrie
+{
+public:
+	struct Node
+	{
+		std::string level;
+		std::string filter; // Full filter, only set on nodes holding values.
+		std::vector<T> values;
+
+		// Copying a node shares its children.
+		std::map<std::string, std::shared_ptr<Node>, std::less<>> children;
+		std::shared_ptr<Node> plus;
+		std::shared_ptr<Node> hash;
+
+		bool IsLeaf() const { return children.empty() && !plus && !hash; }
+	};
+
+	// Returns the node for "filter", creating it (and its parents) if needed.
+	Node* Insert(std::string_view filter)
+	{
+		Node* node = &m_root;
+		ForEachLevel_(filter, [&node](std::string_view level) {
+			node = GetOrCreateChild_(*node, level);
+		});
+		if (node->filter.empty())
+		{
+			node->filter = filter;
+		}
+		return node;
+	}
+
+	// Returns the node for "filter" or nullptr if it doesn't exist.
+	Node* Find(std::string_view filter)
+	{
+		Node* node = &m_root;
+		ForEachLevel_(filter, [&node](std::string_view level) {
+			if (node)
+			{
+				auto child = Child_(*node, level);
+				node = (child && *child ? Unshare_(*child) : nullptr);
+			}
+		});
+		return node;
+	}
+
+	// Removes the node for "filter" and any of its ancestors that no longer
+	// hold values or children. Must be called after the node's last value has
+	// been removed.
+	void Prune(std::string_view filter)
+	{
+		// The path from the root, unshared so that it can be changed.
+		std::vector<std::pair<Node*, std::string_view>> path;
+		Node* node = &m_root;
+		ForEachLevel_(filter, [&](std::string_view level) {
+			if (node)
+			{
+				path.emplace_back(node, level);
+				auto child = Child_(*node, level);
+				node = (child && *child ? Unshare_(*child) : nullptr);
+			}
+		});
+		if (!node)
+		{
+			return;
+		}
+
+		for (auto it = path.rbegin(); it != path.rend() && node->values.empty() && node->IsLeaf(); ++it)
+		{
+			auto [parent, level] = *it;
+			if (level == "+")
+			{
+				parent->plus.reset();
+			}
+			else if (level == "#")
+			{
+				parent->hash.reset();
+			}
+			else
+			{
+				parent->children.erase(parent->children.find(level));
+			}
+			node = parent;
+		}
+	}
+
+	void Prune(Node* node)
+	{
+		// A copy: the node (and its filter) may be erased.
+		Prune(std::string(node->filter));
+	}
+
+	// Calls fn(const Node&) for every node whose filter matches "topic".
+	// Nothing is allocated or copied while walking the trie.
+	template <typename Fn>
+	void Match(std::string_view topic, Fn&& fn) const
+	{
+		if (!topic.empty())
+		{
+			Match_(m_root, topic, false, topic.front() == '$', fn);
+		}
+	}
+
+	// Calls fn(Node&) for every node that holds at least one value. Nodes
+	// must not be pruned from within fn. Unshares the whole trie; the const
+	// overload doesn't.
+	template <typename Fn>
+	void ForEach(Fn&& fn)
+	{
+		ForEachMutable_(m_root, fn);
+	}
+
+	template <typename Fn>
+	void ForEach(Fn&& fn) const
+	{
+		ForEach_(m_root, fn);
+	}
+
+	bool Empty() const { return m_root.IsLeaf(); }
+
+private:
+	template <typename Fn>
+	static void ForEachLevel_(std::string_view filter, Fn&& fn)
+	{
+		for (;;)
+		{
+			auto pos = filter.find('/');
+			fn(filter.substr(0, pos));
+			if (pos == std::string_view::npos)
+			{
+				break;
+			}
+			filter.remove_prefix(pos + 1);
+		}
+	}
+
+	// The pointer to the child for "level", or nullptr if it has none.
+	static std::shared_ptr<Node>* Child_(Node& node, std::string_view level)
+	{
+		if (level == "+")
+		{
+			return &node.plus;
+		}
+		if (level == "#")
+		{
+			return &node.hash;
+		}
+		auto it = node.children.find(level);
+		return (it != node.children.end() ? &it->second : nullptr);
+	}
+
+	// Copies the node if another trie shares it, so that it can be changed.
+	static Node* Unshare_(std::shared_ptr<Node>& node)
+	{
+		if (node.use_count() > 1)
+		{
+			node = std::make_shared<Node>(*node);
+		}
+		return node.get();
+	}
+
+	static Node* GetOrCreateChild_(Node& node, std::string_view level)
+	{
+		auto child = Child_(node, level);
+		if (!child)
+		{
+			child = &node.children.emplace(std::string(level), nullptr).first->second;
+		}
+
+		if (!*child)
+		{
+			*child = std::make_shared<Node>();
+			(*child)->level = level;
+			return child->get();
+		}
+		return Unshare_(*child);
+	}
+
+	// "topic" holds the remaining levels; "atEnd" is set once every level of
+	// the topic has been consumed.
+	template <typename Fn>
+	static void Match_(const Node& node, std::string_view topic, bool atEnd, bool sysTopic, Fn& fn)
+	{
+		// '#' matches the current level as well as everything below it.
+		if (node.hash && !node.hash->values.empty() && !sysTopic)
+		{
+			fn(*node.hash);
+		}
+
+		if (atEnd)
+		{
+			if (!node.values.empty())
+			{
+				fn(node);
+			}
+			return;
+		}
+
+		auto pos = topic.find('/');
+		std::string_view level = topic.substr(0, pos);
+		std::string_view rest = (pos == std::string_view::npos ? std::string_view{} : topic.substr(pos + 1));
+		bool last = (pos == std::string_view::npos);
+
+		auto it = node.children.find(level);
+		if (it != node.children.end())
+		{
+			Match_(*it->second, rest, last, false, fn);
+		}
+		if (node.plus && !sysTopic)
+		{
+			Match_(*node.plus, rest, last, false, fn);
+		}
+	}
+
+	template <typename Fn>
+	static void ForEach_(const Node& node, Fn& fn)
+	{
+		if (!node.values.empty())
+		{
+			fn(node);
+		}
+		for (auto& [level, child] : node.children)
+		{
+			ForEach_(*child, fn);
+		}
+		if (node.plus)
+		{
+			ForEach_(*node.plus, fn);
+		}
+		if (node.hash)
+		{
+			ForEach_(*node.hash, fn);
+		}
+	}
+
+	template <typename Fn>
+	static void ForEachMutable_(Node& node, Fn& fn)
+	{
+		if (!node.values.empty())
+		{
+			fn(node);
+		}
+		for (auto& [level, child] : node.children)
+		{
+			ForEachMutable_(*Unshare_(child), fn);
+		}
+		if (node.plus)
+		{
+			ForEachMutable_(*Unshare_(node.plus), fn);
+		}
+		if (node.hash)
+		{
+			ForEachMutable_(*Unshare_(node.hash), fn);
+		}
+	}
+
+private:
+	Node m_root;
+};
+
+} // namespace ncc
@@ -0,0 +1,78 @@
+#include <core/Logger.h>
+#include <core/WorkerPool.h>
+
+namespace ncc
+{
+
+WorkerPool::WorkerPool(std::size_t numThreads, const std::string& name)
+	: m_name(name)
+{
+	if (numThreads == 0)
+	{
+		numThreads = 1;
+	}
+	m_threads.reserve(numThreads);
+	for (std::size_t i = 0; i < numThreads; ++i)
+	{
+		m_threads.emplace_back(&WorkerPool::Run_, this);
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::unique_lock lock(m_mutex);
+		m_stopping = true;
+	}
+	m_cv.notify_all();
+
+	// Queued tasks are still run before the threads exit.
+	for (auto& thread : m_threads)
+	{
+		thread.join();
+	}
+}
+
+void WorkerPool::Post(Task task)
+{
+	{
+		std::unique_lock lock(m_mutex);
+		m_tasks.push_back(std::move(task));
+	}
+	m_cv.notify_one();
+}
+
+std::size_t WorkerPool::Pending() const
+{
+	std::unique_lock lock(m_mutex);
+	return m_tasks.size();
+}
+
+void WorkerPool::Run_()
+{
+	for (;;)
+	{
+		Task task;
+		{
+			std::unique_lock lock(m_mutex);
+			m_cv.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+			if (m_tasks.empty())
+			{
+				break; // Stopping and nothing left to do.
+			}
+			task = std::move(m_tasks.front());
+			m_tasks.pop_front();
+		}
+
+		try
+		{
+			task();
+		}
+		catch (const std::exception& e)
+		{
+			logger()->error("{}: task threw: {}", m_name, e.what());
+		}
+	}
+}
+
+} // namespace ncc
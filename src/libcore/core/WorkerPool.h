@@ -0,0 +1,50 @@
+#pragma once
+
+#include <core/InplaceFunction.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ncc
+{
+
+// WorkerPool runs posted tasks on a small fixed set of threads. Tasks are
+// started in the order they were posted but may run concurrently, so work
+// that must stay ordered (i.e. a Mailbox) has to serialize itself.
+class WorkerPool
+{
+public:
+	using Task = InplaceFunction<void()>;
+
+	explicit WorkerPool(std::size_t numThreads, const std::string& name = "WorkerPool");
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	void Post(Task task);
+
+	std::size_t Size() const { return m_threads.size(); }
+
+	// Number of tasks waiting for a thread.
+	std::size_t Pending() const;
+
+private:
+	void Run_();
+
+private:
+	const std::string m_name;
+	std::vector<std::thread> m_threads;
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_cv;
+	std::deque<Task> m_tasks;
+	bool m_stopping {false};
+};
+
+} // namespace ncc
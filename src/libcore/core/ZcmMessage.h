@@ -0,0 +1,71 @@
+#pragma once
+
+#include <chrono>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace ncc
+{
+
+// Matches the C++ types generated by "zcm-gen --cpp" from src/types/*.zcm.
+// The encoded form starts with the type's 64-bit hash, so decode() rejects a
+// payload that was encoded from a different schema.
+template <typename T>
+concept ZcmMessage = requires(T msg, const T cmsg, void* buf, const void* cbuf, std::uint32_t len)
+{
+	{ cmsg.encode(buf, len, len) } -> std::convertible_to<int>;
+	{ msg.decode(cbuf, len, len) } -> std::convertible_to<int>;
+	{ cmsg.getEncodedSize() } -> std::convertible_to<std::uint32_t>;
+	{ T::getHash() } -> std::convertible_to<std::int64_t>;
+	{ T::getTypeName() } -> std::convertible_to<const char*>;
+};
+
+// Returns the current time in microseconds, as stored in the "utime" field of
+// every ZCM type.
+inline std::int64_t UtimeNow()
+{
+	using namespace std::chrono;
+	return duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+// Per-thread buffer reused by ZcmEncode(). It only grows, so encoding doesn't
+// allocate once it has reached the largest message size.
+inline std::vector<std::byte>& ZcmScratchBuffer()
+{
+	thread_local std::vector<std::byte> buffer;
+	return buffer;
+}
+
+// Encodes "msg" into the calling thread's scratch buffer. The returned span is
+// valid until the next call to ZcmEncode() on the same thread. Returns an
+// empty span if encoding failed.
+template <ZcmMessage T>
+std::span<const std::byte> ZcmEncode(const T& msg)
+{
+	auto& buffer = ZcmScratchBuffer();
+	std::uint32_t size = msg.getEncodedSize();
+	if (buffer.size() < size)
+	{
+		buffer.resize(size);
+	}
+
+	int len = msg.encode(buffer.data(), 0, size);
+	if (len < 0)
+	{
+		return {};
+	}
+	return {buffer.data(), static_cast<std::size_t>(len)};
+}
+
+// Decodes "payload" into "msg". Returns false if the payload is truncated or
+// was encoded from a different type.
+template <ZcmMessage T>
+bool ZcmDecode(std::span<const std::byte> payload, T& msg)
+{
+	return msg.decode(payload.data(), 0, static_cast<std::uint32_t>(payload.size())) >= 0;
+}
+
+} // namespace ncc
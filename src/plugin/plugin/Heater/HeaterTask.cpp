@@ -1,74 +1,76 @@
 #include <plugin/Heater/HeaterTask.h>
 #include <core/IMqttClient.h>
-
-#include <nlohmann/json.hpp>
+#include <core/Logger.h>
 
 namespace ncc
 {
 
 HeaterTask::HeaterTask(
 		IMqttClient& mqttClient,
-		int heaterNum,
-		bool autostart)
-	: BaseThread("HeaterTask", autostart)
+		int heaterType,
+		bool autostart,
+		const std::string& prefix,
+		Scheduler* scheduler)
+	: BaseThread("HeaterTask", false, scheduler)
 	, m_mqtt(mqttClient)
-	, m_heaterNum(heaterNum)
+	, m_executor("HeaterTask", &GetScheduler())
+	// Updates are handled as soon as they arrive, so the inbox only needs to
+	// absorb a short burst. A fleet has thousands of them.
+	, m_bus(m_executor, mqttClient, 16)
+	, m_heaterType(heaterType)
+	, m_topic(prefix + "/heater/" + std::to_string(heaterType))
+	, m_tempTopic(prefix + "/temperature-monitor/temperature")
 {
-	m_mqtt.RegisterSub("/temperature-monitor/temperature", this);
-#if 0
-	mqtt..Add(
-		"/temperature-monitor/temperature",
-		[this](const std::string& topic, const nlohmann::json& json) {
-			OnTempUpdate_(topic, json);
-		});
-#endif
+	if (autostart)
+	{
+		Start();
+	}
 }
 
-void HeaterTask::Run_()
+HeaterTask::~HeaterTask()
 {
-	m_running = true;
-	m_heaterOn = false;
-	for (;;)
-	{
-		std::unique_lock lock(m_mutex);
-		if (!m_running)
-		{
-			break;
-		}
-		m_cv.wait(lock);
-	}
+	// The coroutine runs on the pool, so stop before the members are destroyed.
+	Stop();
 }
 
-void HeaterTask::OnConnect(int rc)
+void HeaterTask::OnStart_()
 {
-	// noop - Wait for message.
+	// Start from the current temperature, if known.
+	constexpr bool replay {true};
+	m_bus.Subscribe(m_tempTopic, replay);
+	m_executor.Spawn(Loop_());
 }
 
-void HeaterTask::OnDisconnect(int rc)
+void HeaterTask::OnStop_()
 {
-	// noop - Wait for message.
+	// Destroys the coroutine at its co_await.
+	m_executor.Stop();
 }
 
-void HeaterTask::OnMessage(const std::string& topic, const nlohmann::json& json)
+CoTask HeaterTask::Loop_()
 {
-	constexpr float nominalTemp = 10.0;
-	float currentTemp = json["temperature"];
+	// The state is retained (and cached by the client), so late subscribers
+	// learn it without a periodic republish.
+	m_heaterOn = false;
+	PublishHeater_(m_heaterOn);
 
-	// If the heater state changes, publish the current state.
-	// If the heater state hasn't changed, publish it every X cycles. This
-	// will generate less noise but still inform late subscribers.
-	// TODO: Fix refreshCount as it depends on receiving messages. It should
-	// rely on a timer instead.
-	constexpr int refreshCount {3};
-	if (m_threshold == 0 || m_lastPublishedState != m_heaterOn)
+	for (;;)
 	{
-		m_lastPublishedState = m_heaterOn;
-
-		PublishHeater_(m_heaterOn);
-
-		m_threshold = 0;
+		auto msg = co_await m_bus.Next(m_tempTopic);
+		Demo::temperature_t temp;
+		if (!msg.Decode(temp))
+		{
+			logger()->warn("HeaterTask::Loop_(): {}: invalid temperature", msg.topic);
+			continue;
+		}
+		OnTempUpdate_(temp);
 	}
-	m_threshold = ++m_threshold % refreshCount;
+}
+
+void HeaterTask::OnTempUpdate_(const Demo::temperature_t& msg)
+{
+	constexpr float nominalTemp = 10.0;
+	float currentTemp = msg.degCelsius;
 
 //	logger()->debug("currentTemp={}, heater={}", currentTemp, (m_heaterOn ? "ON" : "OFF"));
 	if (currentTemp < nominalTemp)
@@ -91,14 +93,14 @@ void HeaterTask::OnMessage(const std::string& topic, const nlohmann::json& json)
 
 void HeaterTask::PublishHeater_(bool enabled)
 {
-	std::string topic = std::string("/heater/") + std::to_string(m_heaterNum);
-
-	std::string heaterJson =
-		"{\"heater\":" + std::to_string(m_heaterNum) + "," +
-		"\"enabled\":" + (enabled ? "true" : "false") + "}";
-	auto json = nlohmann::json::parse(heaterJson);
+	Demo::heater_t msg;
+	msg.utime = GetClock().Utime();
+	msg.heaterType = m_heaterType;
+	msg.enabled = enabled;
 
-	m_mqtt.Publish(topic, json);
+	constexpr int qos {0};
+	constexpr bool retain {true};
+	m_mqtt.Publish(m_topic, msg, qos, retain);
 }
 
 } // namespace ncc
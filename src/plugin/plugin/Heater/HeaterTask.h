@@ -1,8 +1,14 @@
 #pragma once
 
 #include <core/BaseThread.h>
+#include <core/CoBus.h>
+#include <core/Coroutine.h>
 #include <core/IMqttClient.h>
-#include <core/IMqttSubscriber.h>
+
+#include <string>
+
+#include <types/Demo/heater_t.hpp>
+#include <types/Demo/temperature_t.hpp>
 
 namespace ncc
 {
@@ -20,43 +26,48 @@ namespace ncc
 // - Heater will turn on if temperature is below 40C.
 // - Heater will turn off if temperature is at or above 40C.
 //
-// NOTE: Only need one heater topic, but two is easier (for now).
-//
-// Publishes:
-//    Topic: /heater/On/#, JSON: {"heater": <N>, "enabled": true}
-//    Topic: /heater/Off/#, JSON: {"heater": <N>, "enabled": false}
+// Publishes (retained, on every change):
+//    Topic: /heater/<heaterType>, ZCM: Demo::heater_t
+//    heaterType is Demo::heater_t::HOUSING (1) or MOTOR (2).
 // Subscribes:
-//    Topic: /temperature-monitor/temperature, JSON: {"temperature": -10.0}
+//    Topic: /temperature-monitor/temperature, ZCM: Demo::temperature_t
 //
 // Note:
 // - Subscription is needed to simulate temperature increasing when heater is
 //   turned on.
+// - The heater is a coroutine on the scheduler's pool that waits for each
+//   temperature update, not a handler on the MQTT network thread. It has no
+//   thread of its own.
+// - "prefix" is prepended to both topics so that several simulated cameras
+//   can share a broker (see camsim-loadgen) or a process (see Fleet).
 
-class HeaterTask : public BaseThread, public IMqttSubscriber
+class HeaterTask : public BaseThread
 {
 public:
 	explicit HeaterTask(
 		IMqttClient& mqttClient,
-		int heaterNum,
-		bool autostart = true);
-	~HeaterTask() override = default;
-
-	void OnConnect(int rc) override;
-	void OnDisconnect(int rc) override;
-	void OnMessage(const std::string& topic, const nlohmann::json& json) override;
+		int heaterType,
+		bool autostart = true,
+		const std::string& prefix = {},
+		Scheduler* scheduler = nullptr);
+	~HeaterTask() override;
 
 private:
-	void Run_() override;
+	void OnStart_() override;
+	void OnStop_() override;
 
-//	void OnTempUpdate_(const std::string& topic, const nlohmann::json& json);
+	CoTask Loop_();
+	void OnTempUpdate_(const Demo::temperature_t& msg);
 	void PublishHeater_(bool enabled);
 
 private:
 	IMqttClient& m_mqtt;
-	int m_heaterNum {0};
+	CoExecutor m_executor;
+	CoBus m_bus;
+	int m_heaterType {0};
+	const std::string m_topic;
+	const std::string m_tempTopic;
 	bool m_heaterOn {false};
-	bool m_lastPublishedState {false};
-	int m_threshold {0};
 };
 
 } // namespace ncc
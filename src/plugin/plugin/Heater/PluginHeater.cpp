@@ -11,7 +11,12 @@ class PluginHeater : public IPlugin
 public:
 	PluginHeater(Callbacks* cb)
 		: IPlugin(cb)
-		, m_heater(cb->mqttClient, 1, false)
+		, m_heater(
+			cb->mqttClient,
+			Demo::heater_t::HOUSING,
+			false,
+			cb->version >= 2 ? cb->prefix : std::string(),
+			cb->version >= 2 ? cb->scheduler : nullptr)
 	{
 		m_cb->pLogger->trace("{}::{}()", name(), name());
 	}
@@ -2,13 +2,33 @@
 
 #include <core/IMqttClient.h>
 
+#include <string>
+
 #include <spdlog/spdlog.h>
 
+namespace ncc
+{
+class Scheduler;
+}
+
 struct Callbacks
 {
 	spdlog::logger* pLogger {nullptr};
 	ncc::IMqttClient& mqttClient;
 	int version {0};
+
+	// Version 2:
+	// Topic namespace of the camera the plugin belongs to, i.e. "/camera/7".
+	// Empty for a stand-alone camera.
+	std::string prefix;
+	// Scheduler for the plugin's timers and message handlers; the
+	// process-wide scheduler() if null.
+	ncc::Scheduler* scheduler {nullptr};
+
+	// Version 3:
+	// Directory the plugin keeps its files in (i.e. PluginTelemetry's
+	// store); the working directory if empty.
+	std::string dataDir;
 };
 
 // XXX: What methods does a plugin need to have?
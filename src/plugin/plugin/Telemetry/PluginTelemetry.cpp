@@ -0,0 +1,91 @@
+#include <iostream>
+#include <plugin/IPlugin.h>
+#include <plugin/Telemetry/PluginTelemetry.h>
+#include <plugin/Telemetry/TelemetryTask.h>
+
+
+extern "C" const char* name() { return "PluginTelemetry"; }
+extern "C" const char* version() { return "0.0.1"; }
+
+class PluginTelemetry : public IPlugin
+{
+public:
+	PluginTelemetry(Callbacks* cb)
+		: IPlugin(cb)
+		, m_telemetry(cb->mqttClient, false, Config(cb))
+	{
+		m_cb->pLogger->trace("{}::{}()", name(), name());
+	}
+
+	~PluginTelemetry() override
+	{
+		m_cb->pLogger->trace("{}::~{}()", name(), name());
+		m_telemetry.Stop();
+	}
+
+	void Run() override
+	{
+		m_cb->pLogger->trace("{}::Run()", name());
+		m_telemetry.Start();
+	}
+
+private:
+	static ncc::TelemetryConfig Config(const Callbacks* cb)
+	{
+		ncc::TelemetryConfig config;
+		config.store.directory = "telemetry";
+		if (cb->version >= 2)
+		{
+			config.prefix = cb->prefix;
+			config.scheduler = cb->scheduler;
+		}
+		if (cb->version >= 3 && !cb->dataDir.empty())
+		{
+			config.store.directory = cb->dataDir + "/telemetry";
+		}
+		return config;
+	}
+
+private:
+	ncc::TelemetryTask m_telemetry;
+};
+
+extern "C"
+{
+
+void* create(void* ptr)
+{
+	IPlugin* plugin {nullptr};
+
+	try
+	{
+		auto cb = reinterpret_cast<Callbacks*>(ptr);
+		if (!cb || !cb->pLogger)
+		{
+			std::cerr << name() << ": create: invalid parameter" << std::endl;
+			return nullptr;
+		}
+
+		cb->pLogger->trace("lib{}.so: create()", name());
+
+		plugin = new PluginTelemetry(cb);
+		if (plugin)
+			cb->pLogger->info("Successfully instantiated {}.", name());
+		else
+			cb->pLogger->error("Failed to instantiate {}.", name());
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "lib" << name() << ": caught: " << e.what() << std::endl;
+	}
+
+	return plugin;
+}
+
+void destroy(void* ptr)
+{
+	IPlugin* plugin = reinterpret_cast<IPlugin*>(ptr);
+	delete plugin;
+}
+
+} // extern "C"
@@ -0,0 +1,615 @@
+#include <core/Logger.h>
+#include <plugin/Telemetry/TelemetryStore.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <limits>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace ncc
+{
+
+namespace
+{
+
+constexpr std::uint64_t segmentMagic {0x314745534c544d43}; // "CMTLSEG1"
+constexpr std::uint32_t version {1};
+
+// The columns start here, so they are cache line aligned.
+constexpr std::size_t headerSize {64};
+
+struct SegmentHeader
+{
+	std::uint64_t magic;
+	std::uint32_t version;
+	std::uint32_t reserved;
+	std::uint64_t capacity;
+	std::uint64_t blockSamples;
+	std::uint64_t count; // Written after the sample and its index entry
+};
+static_assert(sizeof(SegmentHeader) <= headerSize);
+
+// Index entry of a block of samples. The last block's entry covers the
+// samples appended so far.
+struct Block
+{
+	std::int64_t first;
+	std::int64_t last;
+	double min;
+	double max;
+	double sum;
+};
+
+constexpr std::size_t SegmentLength(std::size_t capacity, std::size_t blockSamples)
+{
+	return headerSize
+		+ capacity * (sizeof(std::int64_t) + sizeof(double))
+		+ capacity / blockSamples * sizeof(Block);
+}
+
+} // namespace
+
+// A segment file: the header, "capacity" utimes, "capacity" values, then one
+// Block per "blockSamples" samples.
+class TelemetryStore::Segment
+{
+public:
+	// Creates a segment. Throws std::system_error.
+	Segment(const fs::path& path, std::size_t capacity, std::size_t blockSamples)
+	{
+		int fd = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+		if (fd < 0)
+		{
+			throw std::system_error(errno, std::generic_category(), "open(\"" + path.string() + "\") failed");
+		}
+		auto length = SegmentLength(capacity, blockSamples);
+		if (ftruncate(fd, static_cast<off_t>(length)) < 0)
+		{
+			int err = errno;
+			close(fd);
+			unlink(path.c_str());
+			throw std::system_error(err, std::generic_category(), "ftruncate(\"" + path.string() + "\") failed");
+		}
+		Map_(fd, length, path);
+
+		m_header->version = version;
+		m_header->capacity = capacity;
+		m_header->blockSamples = blockSamples;
+		m_header->magic = segmentMagic;
+		Layout_();
+	}
+
+	// Opens an existing segment. Throws std::system_error, or
+	// std::runtime_error if it isn't a valid segment.
+	explicit Segment(const fs::path& path)
+	{
+		int fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+		if (fd < 0)
+		{
+			throw std::system_error(errno, std::generic_category(), "open(\"" + path.string() + "\") failed");
+		}
+		struct stat st {};
+		if (fstat(fd, &st) < 0)
+		{
+			int err = errno;
+			close(fd);
+			throw std::system_error(err, std::generic_category(), "fstat(\"" + path.string() + "\") failed");
+		}
+		auto length = static_cast<std::size_t>(st.st_size);
+		if (length < headerSize)
+		{
+			close(fd);
+			throw std::runtime_error(path.string() + " is not a telemetry segment");
+		}
+		Map_(fd, length, path);
+
+		const auto& header = *m_header;
+		if (header.magic != segmentMagic
+			|| header.version != version
+			|| header.blockSamples == 0
+			|| header.capacity % header.blockSamples != 0
+			|| length < SegmentLength(header.capacity, header.blockSamples)
+			|| header.count > header.capacity)
+		{
+			Unmap_();
+			throw std::runtime_error(path.string() + " is not a valid telemetry segment");
+		}
+		Layout_();
+	}
+
+	~Segment()
+	{
+		Unmap_();
+	}
+
+	Segment(const Segment&) = delete;
+	Segment& operator=(const Segment&) = delete;
+
+	std::size_t Count() const { return m_header->count; }
+	bool Full() const { return Count() == m_capacity; }
+	std::size_t BlockSamples() const { return m_blockSamples; }
+
+	// Only valid if Count() > 0.
+	std::int64_t Last() const { return m_utimes[Count() - 1]; }
+
+	std::int64_t Utime(std::size_t i) const { return m_utimes[i]; }
+	double Value(std::size_t i) const { return m_values[i]; }
+	const Block& BlockOf(std::size_t i) const { return m_blocks[i / m_blockSamples]; }
+
+	// Must not be Full().
+	void Append(std::int64_t utime, double value)
+	{
+		auto i = Count();
+		m_utimes[i] = utime;
+		m_values[i] = value;
+
+		auto& block = m_blocks[i / m_blockSamples];
+		if (i % m_blockSamples == 0)
+		{
+			block = {utime, utime, value, value, value};
+		}
+		else
+		{
+			block.last = utime;
+			block.min = std::min(block.min, value);
+			block.max = std::max(block.max, value);
+			block.sum += value;
+		}
+
+		m_header->count = i + 1;
+	}
+
+	// Index of the first sample with utime >= "utime", or Count().
+	std::size_t LowerBound(std::int64_t utime) const
+	{
+		auto count = Count();
+		auto blocks = (count + m_blockSamples - 1) / m_blockSamples;
+		auto block = static_cast<std::size_t>(std::partition_point(m_blocks, m_blocks + blocks,
+			[utime](const Block& block) { return block.last < utime; }) - m_blocks);
+		if (block == blocks)
+		{
+			return count;
+		}
+
+		auto begin = m_utimes + block * m_blockSamples;
+		auto end = m_utimes + std::min(count, (block + 1) * m_blockSamples);
+		return static_cast<std::size_t>(std::lower_bound(begin, end, utime) - m_utimes);
+	}
+
+private:
+	void Map_(int fd, std::size_t length, const fs::path& path)
+	{
+		void* addr = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (addr == MAP_FAILED)
+		{
+			int err = errno;
+			close(fd);
+			throw std::system_error(err, std::generic_category(), "mmap(\"" + path.string() + "\") failed");
+		}
+		m_fd = fd;
+		m_base = static_cast<std::byte*>(addr);
+		m_length = length;
+		m_header = reinterpret_cast<SegmentHeader*>(m_base);
+	}
+
+	void Unmap_()
+	{
+		munmap(m_base, m_length);
+		close(m_fd);
+	}
+
+	void Layout_()
+	{
+		m_capacity = m_header->capacity;
+		m_blockSamples = m_header->blockSamples;
+		m_utimes = reinterpret_cast<std::int64_t*>(m_base + headerSize);
+		m_values = reinterpret_cast<double*>(m_utimes + m_capacity);
+		m_blocks = reinterpret_cast<Block*>(m_values + m_capacity);
+	}
+
+private:
+	int m_fd {-1};
+	std::byte* m_base {nullptr};
+	std::size_t m_length {0};
+	SegmentHeader* m_header {nullptr};
+	std::int64_t* m_utimes {nullptr};
+	double* m_values {nullptr};
+	Block* m_blocks {nullptr};
+	std::size_t m_capacity {0};
+	std::size_t m_blockSamples {0};
+};
+
+struct TelemetryStore::Series
+{
+	// Guards the rest, except "directory".
+	std::mutex mutex;
+
+	fs::path directory;
+
+	// In time order. Only the last one may be empty.
+	std::vector<std::unique_ptr<Segment>> segments;
+	std::uint64_t nextNumber {0};
+
+	std::int64_t last {std::numeric_limits<std::int64_t>::min()};
+	double lastValue {0.0};
+
+	// A segment couldn't be created; logged once.
+	bool failed {false};
+};
+
+TelemetryStore::TelemetryStore(const TelemetryStoreConfig& config)
+	: m_config(config)
+{
+	if (config.directory.empty())
+	{
+		throw std::invalid_argument("TelemetryStore: no directory");
+	}
+	if (config.blockSamples == 0 || config.segmentSamples == 0 || config.segmentSamples % config.blockSamples != 0)
+	{
+		throw std::invalid_argument("TelemetryStore: segmentSamples must be a multiple of blockSamples");
+	}
+
+	logger()->debug("TelemetryStore(\"{}\"): segmentSamples={}, blockSamples={}",
+		config.directory, config.segmentSamples, config.blockSamples);
+}
+
+TelemetryStore::~TelemetryStore() = default;
+
+bool TelemetryStore::Append(std::string_view name, std::int64_t utime, double value)
+{
+	Series* series {nullptr};
+	{
+		std::lock_guard lock(m_mutex);
+		series = Series_(name, true);
+	}
+	if (!series)
+	{
+		m_dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	std::lock_guard lock(series->mutex);
+	// A retained message redelivered on resubscribe repeats the last sample.
+	if (utime < series->last || (utime == series->last && value == series->lastValue)
+		|| !std::isfinite(value)
+		|| ((series->segments.empty() || series->segments.back()->Full()) && !AddSegment_(*series)))
+	{
+		m_dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	series->segments.back()->Append(utime, value);
+	series->last = utime;
+	series->lastValue = value;
+	m_appended.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+std::vector<TelemetrySample> TelemetryStore::Range(
+	std::string_view name,
+	std::int64_t from,
+	std::int64_t to,
+	std::size_t limit)
+{
+	std::vector<TelemetrySample> samples;
+	if (from > to || limit == 0)
+	{
+		return samples;
+	}
+
+	auto series = FindSeries_(name);
+	if (!series)
+	{
+		return samples;
+	}
+
+	std::unique_lock lock(series->mutex);
+	for (auto pos = Find_(*series, from); pos.segment < series->segments.size(); )
+	{
+		const auto& segment = *series->segments[pos.segment];
+		const auto blockEnd = BlockEnd_(segment, pos.sample);
+		for (; pos.sample < blockEnd; ++pos.sample)
+		{
+			auto utime = segment.Utime(pos.sample);
+			if (utime > to || samples.size() == limit)
+			{
+				return samples;
+			}
+			samples.push_back({utime, segment.Value(pos.sample)});
+		}
+		if (!Next_(segment, pos))
+		{
+			break;
+		}
+
+		// Lets Append() in between blocks.
+		lock.unlock();
+		lock.lock();
+	}
+	return samples;
+}
+
+std::vector<TelemetryBucket> TelemetryStore::Downsample(
+	std::string_view name,
+	std::int64_t from,
+	std::int64_t to,
+	std::int64_t step,
+	std::size_t limit)
+{
+	std::vector<TelemetryBucket> buckets;
+	if (from > to || step <= 0 || limit == 0)
+	{
+		return buckets;
+	}
+
+	auto series = FindSeries_(name);
+	if (!series)
+	{
+		return buckets;
+	}
+
+	TelemetryBucket bucket;
+	double sum {0.0};
+	std::int64_t end {0}; // Last utime of "bucket"
+
+	auto flush = [&]() {
+		if (bucket.count)
+		{
+			bucket.mean = sum / static_cast<double>(bucket.count);
+			buckets.push_back(bucket);
+		}
+	};
+	auto merge = [&](std::uint64_t count, double min, double max, double blockSum) {
+		bucket.min = bucket.count ? std::min(bucket.min, min) : min;
+		bucket.max = bucket.count ? std::max(bucket.max, max) : max;
+		bucket.count += count;
+		sum += blockSum;
+	};
+
+	std::unique_lock lock(series->mutex);
+	for (auto pos = Find_(*series, from); pos.segment < series->segments.size(); )
+	{
+		const auto& segment = *series->segments[pos.segment];
+		const auto count = segment.Count();
+		const auto blockSamples = segment.BlockSamples();
+		const auto chunkEnd = BlockEnd_(segment, pos.sample);
+
+		for (auto& i = pos.sample; i < chunkEnd; )
+		{
+			auto utime = segment.Utime(i);
+			if (utime > to)
+			{
+				flush();
+				return buckets;
+			}
+			if (!bucket.count || utime > end)
+			{
+				flush();
+				if (buckets.size() == limit)
+				{
+					return buckets;
+				}
+
+				// In unsigned arithmetic, which can't overflow.
+				auto offset = static_cast<std::uint64_t>(utime) - static_cast<std::uint64_t>(from);
+				auto ustep = static_cast<std::uint64_t>(step);
+				bucket = {.utime = static_cast<std::int64_t>(static_cast<std::uint64_t>(from) + offset / ustep * ustep)};
+				sum = 0.0;
+				end = static_cast<std::uint64_t>(to - bucket.utime) < ustep ? to : bucket.utime + (step - 1);
+			}
+
+			// Whole blocks within the bucket are taken from the index.
+			const auto& block = segment.BlockOf(i);
+			if (i % blockSamples == 0 && block.last <= end)
+			{
+				auto blockEnd = std::min(count, i + blockSamples);
+				merge(blockEnd - i, block.min, block.max, block.sum);
+				i = blockEnd;
+			}
+			else
+			{
+				auto value = segment.Value(i);
+				merge(1, value, value, value);
+				++i;
+			}
+		}
+		if (!Next_(segment, pos))
+		{
+			break;
+		}
+
+		// Lets Append() in between blocks.
+		lock.unlock();
+		lock.lock();
+	}
+	flush();
+	return buckets;
+}
+
+std::vector<std::string> TelemetryStore::Names() const
+{
+	std::lock_guard lock(m_mutex);
+
+	std::vector<std::string> names;
+	names.reserve(m_series.size());
+	for (const auto& [name, series] : m_series)
+	{
+		names.push_back(name);
+	}
+	std::sort(names.begin(), names.end());
+	return names;
+}
+
+std::uint64_t TelemetryStore::Appended() const
+{
+	return m_appended.load(std::memory_order_relaxed);
+}
+
+std::uint64_t TelemetryStore::Dropped() const
+{
+	return m_dropped.load(std::memory_order_relaxed);
+}
+
+bool TelemetryStore::IsValidName(std::string_view series)
+{
+	if (series.empty())
+	{
+		return false;
+	}
+	for (std::size_t begin = 0; begin <= series.size(); )
+	{
+		auto end = std::min(series.find('/', begin), series.size());
+		auto level = series.substr(begin, end - begin);
+		if (level.empty() || level == "." || level == ".." || level.find_first_of(std::string_view("+#\0", 3)) != level.npos)
+		{
+			return false;
+		}
+		begin = end + 1;
+	}
+	return true;
+}
+
+TelemetryStore::Series* TelemetryStore::Series_(std::string_view name, bool create)
+{
+	if (auto it = m_series.find(name); it != m_series.end())
+	{
+		return it->second.get();
+	}
+	if (!IsValidName(name))
+	{
+		return nullptr;
+	}
+
+	auto series = std::make_unique<Series>();
+	series->directory = fs::path(m_config.directory) / name;
+
+	// Segments are named by number, so they sort in time order.
+	std::vector<std::pair<std::uint64_t, fs::path>> files;
+	std::error_code ec;
+	for (const auto& entry : fs::directory_iterator(series->directory, ec))
+	{
+		const auto& path = entry.path();
+		auto stem = path.stem().string();
+		if (path.extension() == ".seg" && !stem.empty()
+			&& std::all_of(stem.begin(), stem.end(), [](char c) { return c >= '0' && c <= '9'; }))
+		{
+			files.emplace_back(std::stoull(stem), path);
+		}
+	}
+	std::sort(files.begin(), files.end());
+
+	for (const auto& [number, path] : files)
+	{
+		series->nextNumber = number + 1;
+		try
+		{
+			auto segment = std::make_unique<Segment>(path);
+			if (segment->Count() && segment->Utime(0) < series->last)
+			{
+				logger()->warn("TelemetryStore::Series_(): {}: out of order, skipped", path.string());
+				continue;
+			}
+
+			// An empty segment is only kept if it is the last one.
+			if (!series->segments.empty() && series->segments.back()->Count() == 0)
+			{
+				series->segments.pop_back();
+			}
+			if (segment->Count())
+			{
+				series->last = segment->Last();
+				series->lastValue = segment->Value(segment->Count() - 1);
+			}
+			series->segments.push_back(std::move(segment));
+		}
+		catch (const std::exception& e)
+		{
+			logger()->warn("TelemetryStore::Series_(): skipped: {}", e.what());
+		}
+	}
+
+	if (series->segments.empty() && !create)
+	{
+		return nullptr;
+	}
+	if (!series->segments.empty())
+	{
+		logger()->debug("TelemetryStore::Series_(): {}: opened {} segment(s)", name, series->segments.size());
+	}
+	return m_series.emplace(std::string(name), std::move(series)).first->second.get();
+}
+
+bool TelemetryStore::AddSegment_(Series& series)
+{
+	char file[32];
+	std::snprintf(file, sizeof(file), "%08llu.seg", static_cast<unsigned long long>(series.nextNumber));
+
+	try
+	{
+		fs::create_directories(series.directory);
+		series.segments.push_back(std::make_unique<Segment>(series.directory / file, m_config.segmentSamples, m_config.blockSamples));
+		++series.nextNumber;
+		series.failed = false;
+		return true;
+	}
+	catch (const std::exception& e)
+	{
+		if (!series.failed)
+		{
+			logger()->error("TelemetryStore::AddSegment_(): {}", e.what());
+			series.failed = true;
+		}
+		return false;
+	}
+}
+
+TelemetryStore::Series* TelemetryStore::FindSeries_(std::string_view name)
+{
+	std::lock_guard lock(m_mutex);
+	return Series_(name, false);
+}
+
+std::size_t TelemetryStore::BlockEnd_(const Segment& segment, std::size_t sample)
+{
+	auto blockSamples = segment.BlockSamples();
+	return std::min(segment.Count(), (sample / blockSamples + 1) * blockSamples);
+}
+
+bool TelemetryStore::Next_(const Segment& segment, Position& pos)
+{
+	if (pos.sample < segment.Count())
+	{
+		return true;
+	}
+	if (!segment.Full())
+	{
+		return false; // The end of the series
+	}
+	++pos.segment;
+	pos.sample = 0;
+	return true;
+}
+
+TelemetryStore::Position TelemetryStore::Find_(const Series& series, std::int64_t from)
+{
+	const auto& segments = series.segments;
+	auto it = std::partition_point(segments.begin(), segments.end(),
+		[from](const auto& segment) { return segment->Count() && segment->Last() < from; });
+	if (it == segments.end())
+	{
+		return {segments.size(), 0};
+	}
+	return {static_cast<std::size_t>(it - segments.begin()), (*it)->LowerBound(from)};
+}
+
+} // namespace ncc
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace ncc
+{
+
+struct TelemetryStoreConfig
+{
+	// Series are stored under "<directory>/<series>/".
+	std::string directory;
+
+	// Samples per segment file. A segment takes 16 bytes per sample plus its
+	// index, but the file is sparse, so only what was written uses disk.
+	std::size_t segmentSamples {std::size_t {1} << 16};
+
+	// Samples per index entry. Must divide segmentSamples.
+	std::size_t blockSamples {256};
+};
+
+struct TelemetrySample
+{
+	std::int64_t utime {0};
+	double value {0.0};
+};
+
+// Summary of the samples in [utime, utime + step).
+struct TelemetryBucket
+{
+	std::int64_t utime {0};
+	std::uint64_t count {0};
+	double min {0.0};
+	double max {0.0};
+	double mean {0.0};
+};
+
+// TelemetryStore keeps time series of (utime, value) samples, one per series
+// name (i.e. "temperature-monitor/temperature").
+//
+// A series is a sequence of memory-mapped segment files, each holding a
+// fixed number of samples as two fixed-width columns (utimes, then values)
+// and a sparse index: one entry per block of samples with its first and last
+// utime and the minimum, maximum and sum of its values. A query finds its
+// start by binary search over the segments, then the index, then one block,
+// and a downsampled query aggregates whole blocks from the index, so neither
+// scans the files.
+//
+// Appending stores two values and updates one index entry in place; nothing
+// is allocated except when a segment fills up. Samples must be appended in
+// time order; older ones are dropped.
+//
+// Series on disk are opened when first used, so a store reopened on the
+// same directory continues them. The store is thread safe. Each series has
+// its own mutex, which a query only holds for one block of samples at a
+// time, so a large query delays an append by at most one block.
+class TelemetryStore
+{
+public:
+	// Throws std::invalid_argument for an invalid config.
+	explicit TelemetryStore(const TelemetryStoreConfig& config);
+	~TelemetryStore();
+
+	TelemetryStore(const TelemetryStore&) = delete;
+	TelemetryStore& operator=(const TelemetryStore&) = delete;
+
+	// Returns false if the sample was dropped: it is older than the series'
+	// last sample or repeats it (same utime and value), the name is invalid
+	// or a segment couldn't be created.
+	bool Append(std::string_view series, std::int64_t utime, double value);
+
+	// Samples with from <= utime <= to, oldest first, at most "limit".
+	std::vector<TelemetrySample> Range(
+		std::string_view series,
+		std::int64_t from,
+		std::int64_t to,
+		std::size_t limit);
+
+	// Summaries of the samples with from <= utime <= to in buckets of "step"
+	// microseconds, the first starting at "from", at most "limit". Empty
+	// buckets are left out.
+	std::vector<TelemetryBucket> Downsample(
+		std::string_view series,
+		std::int64_t from,
+		std::int64_t to,
+		std::int64_t step,
+		std::size_t limit);
+
+	// Names of the series used since the store was opened.
+	std::vector<std::string> Names() const;
+
+	std::uint64_t Appended() const;
+	std::uint64_t Dropped() const;
+
+	// "a/b" is valid; "", "/a", "a//b", "a/../b" and wildcards aren't.
+	static bool IsValidName(std::string_view series);
+
+private:
+	class Segment;
+	struct Series;
+
+	struct StringHash
+	{
+		using is_transparent = void;
+		std::size_t operator()(std::string_view str) const { return std::hash<std::string_view> {}(str); }
+	};
+
+	// Opens the series' existing segments the first time. Returns null if
+	// the name is invalid, or it has no segments and "create" is false.
+	// Called with m_mutex locked.
+	Series* Series_(std::string_view name, bool create);
+
+	// Locks m_mutex for Series_(name, false).
+	Series* FindSeries_(std::string_view name);
+
+	bool AddSegment_(Series& series);
+
+	// Position of the first sample with utime >= "from".
+	struct Position
+	{
+		std::size_t segment {0};
+		std::size_t sample {0};
+	};
+	static Position Find_(const Series& series, std::int64_t from);
+
+	// Queries process one block at a time, with the series locked. Samples
+	// never move once appended, so a Position stays valid in between.
+	// BlockEnd_() is the end of the block of "sample". Next_() moves "pos"
+	// past the end of a full segment; it returns false at the end of the
+	// series.
+	static std::size_t BlockEnd_(const Segment& segment, std::size_t sample);
+	static bool Next_(const Segment& segment, Position& pos);
+
+private:
+	const TelemetryStoreConfig m_config;
+
+	// Guards m_series only; a Series is never removed.
+	mutable std::mutex m_mutex;
+	std::unordered_map<std::string, std::unique_ptr<Series>, StringHash, std::equal_to<>> m_series;
+	std::atomic<std::uint64_t> m_appended {0};
+	std::atomic<std::uint64_t> m_dropped {0};
+};
+
+} // namespace ncc
@@ -0,0 +1,256 @@
+#include <core/IMqttClient.h>
+#include <core/JsonWriter.h>
+#include <core/Logger.h>
+#include <core/ZcmMessage.h>
+#include <plugin/Telemetry/TelemetryTask.h>
+
+#include <limits>
+#include <optional>
+
+#include <nlohmann/json.hpp>
+#include <types/Demo/heater_t.hpp>
+#include <types/Demo/power_level_t.hpp>
+#include <types/Demo/temperature_t.hpp>
+
+namespace ncc
+{
+
+namespace
+{
+
+TelemetryStoreConfig StoreConfig(const TelemetryConfig& config)
+{
+	auto store = config.store;
+	store.directory += config.prefix;
+	return store;
+}
+
+// Returns false if "key" is present but not an integer.
+bool GetInteger(const nlohmann::json& json, const char* key, std::int64_t& value)
+{
+	auto it = json.find(key);
+	if (it == json.end())
+	{
+		return true;
+	}
+	if (!it->is_number_integer())
+	{
+		return false;
+	}
+	value = it->get<std::int64_t>();
+	return true;
+}
+
+} // namespace
+
+TelemetryTask::TelemetryTask(
+		IMqttClient& mqttClient,
+		bool autostart,
+		const TelemetryConfig& config)
+	: BaseThread("TelemetryTask", false, config.scheduler)
+	, m_mqtt(mqttClient)
+	, m_config(config)
+	, m_tempTopic(config.prefix + "/temperature-monitor/temperature")
+	, m_heaterTopic(config.prefix + "/heater/#")
+	, m_powerTopic(config.prefix + "/power/level")
+	, m_queryTopic(config.prefix + "/telemetry/query")
+	, m_replyTopic(config.prefix + "/telemetry/reply")
+	, m_store(StoreConfig(config))
+	, m_executor("TelemetryTask", &GetScheduler())
+	, m_bus(m_executor, mqttClient)
+{
+	// Queue queries until the task starts.
+	m_bus.Subscribe(m_queryTopic);
+
+	if (autostart)
+	{
+		Start();
+	}
+}
+
+TelemetryTask::~TelemetryTask()
+{
+	// The coroutine runs on the pool, so stop before the members are destroyed.
+	Stop();
+}
+
+void TelemetryTask::OnStart_()
+{
+	// Not replayed: a retained value was recorded when it was published.
+	for (const auto& topic : {m_tempTopic, m_heaterTopic, m_powerTopic})
+	{
+		m_mqtt.RegisterSub(topic, this);
+	}
+	m_executor.Spawn(Queries_());
+}
+
+void TelemetryTask::OnStop_()
+{
+	// No message is being recorded once this returns.
+	m_mqtt.UnregisterSub(this);
+
+	// Destroys the coroutine at its co_await.
+	m_executor.Stop();
+}
+
+void TelemetryTask::OnRawMessage(const MqttMessage& msg)
+{
+	auto topic = msg.Topic();
+	auto series = topic.substr(m_config.prefix.size() + 1);
+
+	if (topic == m_tempTopic)
+	{
+		Demo::temperature_t temp;
+		if (ZcmDecode(msg.Payload(), temp))
+		{
+			m_store.Append(series, temp.utime, temp.degCelsius);
+			return;
+		}
+	}
+	else if (topic == m_powerTopic)
+	{
+		Demo::power_level_t power;
+		if (ZcmDecode(msg.Payload(), power))
+		{
+			m_store.Append(series, power.utime, power.powerLevel);
+			return;
+		}
+	}
+	else
+	{
+		Demo::heater_t heater;
+		if (ZcmDecode(msg.Payload(), heater))
+		{
+			m_store.Append(series, heater.utime, heater.enabled ? 1.0 : 0.0);
+			return;
+		}
+	}
+
+	logger()->warn("TelemetryTask::OnRawMessage(): {}: invalid payload", topic);
+}
+
+CoTask TelemetryTask::Queries_()
+{
+	for (;;)
+	{
+		auto msg = co_await m_bus.Next(m_queryTopic);
+		Answer_(msg);
+	}
+}
+
+void TelemetryTask::Answer_(const BusMessage& msg)
+{
+	const auto json = msg.Json();
+
+	auto& writer = JsonWriter::ThreadLocal();
+	writer.BeginObject();
+
+	// Echoed so that the requester can match the reply.
+	if (json.is_object() && json.contains("id"))
+	{
+		const auto& id = json["id"];
+		if (id.is_number_integer())
+		{
+			writer.Field("id", id.get<std::int64_t>());
+		}
+		else if (id.is_string())
+		{
+			writer.Field("id", id.get_ref<const std::string&>());
+		}
+	}
+
+	std::int64_t from {std::numeric_limits<std::int64_t>::min()};
+	std::int64_t to {std::numeric_limits<std::int64_t>::max()};
+	std::int64_t step {0};
+	const char* error {nullptr};
+	if (!json.is_object())
+	{
+		error = "query is not a JSON object";
+	}
+	else if (json.contains("series") && !json["series"].is_string())
+	{
+		error = "series is not a string";
+	}
+	else if (!GetInteger(json, "from", from) || !GetInteger(json, "to", to) || !GetInteger(json, "step", step))
+	{
+		error = "from, to and step must be integers";
+	}
+	else if (json.contains("step") && step <= 0)
+	{
+		error = "step must be positive";
+	}
+
+	if (error)
+	{
+		logger()->debug("TelemetryTask::Answer_(): {}", error);
+		writer.Field("error", error);
+	}
+	else if (!json.contains("series"))
+	{
+		writer.Key("series").BeginArray();
+		for (const auto& name : m_store.Names())
+		{
+			writer.Value(name);
+		}
+		writer.EndArray();
+	}
+	else
+	{
+		const auto& series = json["series"].get_ref<const std::string&>();
+		writer.Field("series", series);
+
+		// One more than fits, to tell whether there are more.
+		const auto limit = m_config.maxResults + 1;
+		std::optional<std::int64_t> next;
+		if (step)
+		{
+			auto buckets = m_store.Downsample(series, from, to, step, limit);
+			if (buckets.size() == limit)
+			{
+				next = buckets.back().utime;
+				buckets.pop_back();
+			}
+
+			writer.Field("step", step).Key("buckets").BeginArray();
+			for (const auto& bucket : buckets)
+			{
+				writer.BeginArray()
+					.Value(bucket.utime)
+					.Value(bucket.count)
+					.Value(bucket.min)
+					.Value(bucket.max)
+					.Value(bucket.mean)
+					.EndArray();
+			}
+			writer.EndArray();
+		}
+		else
+		{
+			auto samples = m_store.Range(series, from, to, limit);
+			if (samples.size() == limit)
+			{
+				next = samples.back().utime;
+				samples.pop_back();
+			}
+
+			writer.Key("samples").BeginArray();
+			for (const auto& sample : samples)
+			{
+				writer.BeginArray().Value(sample.utime).Value(sample.value).EndArray();
+			}
+			writer.EndArray();
+		}
+
+		if (next)
+		{
+			writer.Field("next", *next);
+		}
+	}
+	writer.EndObject();
+
+	constexpr int qos {0};
+	constexpr bool retain {false};
+	m_mqtt.Publish(m_replyTopic, writer.Bytes(), qos, retain);
+}
+
+} // namespace ncc
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <core/BaseThread.h>
+#include <core/CoBus.h>
+#include <core/Coroutine.h>
+#include <core/IMqttClient.h>
+#include <core/IMqttSubscriber.h>
+#include <core/Scheduler.h>
+#include <plugin/Telemetry/TelemetryStore.h>
+
+#include <cstddef>
+#include <string>
+
+namespace ncc
+{
+
+struct TelemetryConfig
+{
+	// Prepended to every topic so that several simulated cameras can share a
+	// broker (see camsim-loadgen) or a process (see Fleet).
+	std::string prefix;
+
+	// Segment files and their layout. The camera's series are stored under
+	// "<store.directory><prefix>/".
+	TelemetryStoreConfig store;
+
+	// Most samples or buckets in one reply.
+	std::size_t maxResults {10000};
+
+	// Answers queries; the process-wide scheduler() if null.
+	Scheduler* scheduler {nullptr};
+};
+
+// Telemetry records the camera's temperature, heater and power level values
+// in a TelemetryStore, and answers queries about their history.
+//
+// Series (named by topic, without the prefix):
+//    temperature-monitor/temperature, ZCM: Demo::temperature_t, degCelsius
+//    heater/<heaterType>, ZCM: Demo::heater_t, 1 if enabled else 0
+//    power/level, ZCM: Demo::power_level_t, powerLevel
+// The samples are stamped with the messages' utime.
+//
+// Publishes:
+//    Topic: /telemetry/reply, JSON: see below
+// Subscribes:
+//    Topic: /telemetry/query, JSON:
+//       {"id": <any>, "series": "temperature-monitor/temperature",
+//        "from": <utime>, "to": <utime>, "step": <microseconds>}
+//
+// Every field is optional. Without "series" the reply lists the series:
+//    {"id": <any>, "series": ["heater/1", ...]}
+// Without "step" it has the samples with from <= utime <= to (everything by
+// default), and "next" if there were more than maxResults:
+//    {"id": <any>, "series": "...", "samples": [[<utime>, <value>], ...], "next": <utime>}
+// With "step" it has the samples downsampled into buckets of that many
+// microseconds, leaving out empty ones:
+//    {"id": <any>, "series": "...", "step": <step>,
+//     "buckets": [[<utime>, <count>, <min>, <max>, <mean>], ...]}
+// An invalid query gets {"id": <any>, "error": "<reason>"}.
+//
+// Note:
+// - Samples are appended on the MQTT network thread, without a copy of the
+//   message or a queue; a sample costs a few stores into the mapped files.
+// - Queries are answered by a coroutine on the scheduler's pool.
+class TelemetryTask : public BaseThread, public IMqttSubscriber
+{
+public:
+	explicit TelemetryTask(
+		IMqttClient& mqttClient,
+		bool autostart = true,
+		const TelemetryConfig& config = {});
+	~TelemetryTask() override;
+
+	void OnConnect(int rc) override {}
+	void OnDisconnect(int rc) override {}
+	void OnRawMessage(const MqttMessage& msg) override;
+
+	TelemetryStore& Store() { return m_store; }
+
+private:
+	void OnStart_() override;
+	void OnStop_() override;
+
+	CoTask Queries_();
+	void Answer_(const BusMessage& msg);
+
+private:
+	IMqttClient& m_mqtt;
+	const TelemetryConfig m_config;
+	const std::string m_tempTopic;
+	const std::string m_heaterTopic;
+	const std::string m_powerTopic;
+	const std::string m_queryTopic;
+	const std::string m_replyTopic;
+	TelemetryStore m_store;
+	CoExecutor m_executor;
+	CoBus m_bus;
+};
+
+} // namespace ncc
@@ -12,7 +12,7 @@ class PluginTempMonitor : public IPlugin
 public:
 	PluginTempMonitor(Callbacks* cb)
 		: IPlugin(cb)
-		, m_tempMonitor(cb->mqttClient, false)
+		, m_tempMonitor(cb->mqttClient, false, Config(cb))
 	{
 		m_cb->pLogger->trace("{}::{}()", name(), name());
 	}
@@ -29,6 +29,18 @@ public:
 		m_tempMonitor.Start();
 	}
 
+private:
+	static ncc::TempMonitorConfig Config(const Callbacks* cb)
+	{
+		ncc::TempMonitorConfig config;
+		if (cb->version >= 2)
+		{
+			config.prefix = cb->prefix;
+			config.scheduler = cb->scheduler;
+		}
+		return config;
+	}
+
 private:
 	ncc::TempMonitorTask m_tempMonitor;
 };
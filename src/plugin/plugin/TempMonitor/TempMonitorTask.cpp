@@ -2,7 +2,10 @@
 #include <core/Logger.h>
 #include <plugin/TempMonitor/TempMonitorTask.h>
 
-#include <nlohmann/json.hpp>
+#include <algorithm>
+
+#include <types/Demo/heater_t.hpp>
+#include <types/Demo/temperature_t.hpp>
 
 using namespace std::chrono_literals;
 
@@ -11,44 +14,61 @@ namespace ncc
 
 TempMonitorTask::TempMonitorTask(
 		IMqttClient& mqttClient,
-		bool autostart)
-	: BaseThread("TempMonitorTask", autostart)
+		bool autostart,
+		const TempMonitorConfig& config)
+	: BaseThread("TempMonitorTask", false, config.scheduler)
 	, m_mqtt(mqttClient)
+	, m_config(config)
+	, m_topic(config.prefix + "/temperature-monitor/temperature")
+	, m_heaterTopic(config.prefix + "/heater/#")
+	, m_executor("TempMonitorTask", &GetScheduler())
+	// Heaters only publish changes, so this only needs room for a few per
+	// cycle. A fleet has thousands of them.
+	, m_bus(m_executor, mqttClient, 16)
 {
 //	Trace trace("TempMonitorTask::TempMonitorTask()");
 
-	m_mqtt.RegisterSub("/heater/#", this);
-#if 0
-		[this](const std::string& topic, const nlohmann::json& json) {
-			OnHeater_(topic, json);
-		});
-#endif
-}
+	// Queue the heaters' states until the monitor starts.
+	constexpr bool replay {true};
+	m_bus.Subscribe(m_heaterTopic, replay);
 
+	if (autostart)
+	{
+		Start();
+	}
+}
 
-void TempMonitorTask::OnConnect(int rc)
+TempMonitorTask::~TempMonitorTask()
 {
-	// Start publishing temperature.
+	// The coroutines run on the pool, so stop before the members are destroyed.
+	Stop();
 }
 
-void TempMonitorTask::OnDisconnect(int rc)
+void TempMonitorTask::OnStop_()
 {
+	// Destroys the coroutines at their co_await.
+	m_executor.Stop();
 }
 
-void TempMonitorTask::OnMessage(const std::string& topic, const nlohmann::json& json)
+CoTask TempMonitorTask::Heaters_()
 {
-	// TODO: Verify topic.
-	bool enabled = json["enabled"];
-
-	// Topic: /heater/On/#, JSON: {"heater": <N>, "enabled": true}
-	logger()->debug("TempMonitorTask::OnMessage(): enabled={}", (enabled ? "ON" : "OFF"));
-	if (enabled)
-	{
-		++m_numHeaters;
-	}
-	else if (m_numHeaters > 0)
+	for (;;)
 	{
-		--m_numHeaters;
+		auto msg = co_await m_bus.Next(m_heaterTopic);
+		Demo::heater_t heater;
+		if (!msg.Decode(heater))
+		{
+			logger()->warn("TempMonitorTask::Heaters_(): {}: invalid heater state", msg.topic);
+			continue;
+		}
+		bool enabled = heater.enabled;
+
+		// Heaters publish their state (not transitions) and the state may be
+		// replayed, so track each heater rather than counting messages.
+		logger()->debug("TempMonitorTask::Heaters_(): enabled={}", (enabled ? "ON" : "OFF"));
+		m_heaters[msg.topic] = enabled;
+		m_numHeaters = static_cast<int>(std::count_if(m_heaters.begin(), m_heaters.end(),
+			[](const auto& heater) { return heater.second; }));
 	}
 }
 
@@ -58,75 +78,77 @@ void TempMonitorTask::OnMessage(const std::string& topic, const nlohmann::json&
 // For this simulation, the temperature will start at -20C and max out at 40C.
 // If heaters are off, the temperature will slow decrease to a nominal
 // temperature of 12C.
-void TempMonitorTask::Run_()
+void TempMonitorTask::OnStart_()
 {
-	m_running = true;
 	m_currentTemp = -20.0;
-	constexpr float maximumTemp = 40.0;
-	constexpr float nominalTemp = 12.0; // 
-	auto updateDelay = 1s;
 
+	// Spawned first, so the replayed heater states are applied before the
+	// first cycle.
+	m_executor.Spawn(Heaters_());
+	m_executor.Spawn(Cycle_());
+}
+
+CoTask TempMonitorTask::Cycle_()
+{
 	for (;;)
 	{
-		std::unique_lock lock(m_mutex);
-		if (!m_running)
-		{
-			break;
-		}
+		Step_();
+		co_await m_executor.Sleep(m_config.period);
+	}
+}
+
+void TempMonitorTask::Step_()
+{
+	constexpr float maximumTemp = 40.0;
+	constexpr float nominalTemp = 12.0; // 
 
 #if 0
-		static int throttle = 1;
-		--throttle;
-		if (throttle == 0)
-		{
-			logger()->debug("TempMonitorTask::Run_(): current temperature={}", m_currentTemp);
-			throttle = 5;
-		}
+	static int throttle = 1;
+	--throttle;
+	if (throttle == 0)
+	{
+		logger()->debug("TempMonitorTask::Step_(): current temperature={}", m_currentTemp);
+		throttle = 5;
+	}
 #endif
-		// Adjust the temperature (simulator relies on heater subscription).
-		if (m_numHeaters && m_currentTemp < maximumTemp)
-		{
-			// Heater is on, increase temperature until maximum reached.
-			// Each heater raises temperature by 1C every cycle.
-			m_currentTemp += m_numHeaters;
-			if (m_currentTemp > maximumTemp)
-			{
-				m_currentTemp = maximumTemp;
-			}
-		}
-		if (m_numHeaters == 0 && m_currentTemp > nominalTemp)
+	// Adjust the temperature (simulator relies on heater subscription).
+	if (m_numHeaters && m_currentTemp < maximumTemp)
+	{
+		// Heater is on, increase temperature until maximum reached.
+		// Each heater raises temperature by 1C every cycle.
+		m_currentTemp += m_numHeaters;
+		if (m_currentTemp > maximumTemp)
 		{
-			// Over heated, returning to nominal temperature.
-			--m_currentTemp;
+			m_currentTemp = maximumTemp;
 		}
-
-		// Publish temperature every cycle.
-		PublishTemperature_();
-
-		// NOTE: Accurate timer is not needed since this is only a simulation.
-		// May need to implement something better...
-		m_cv.wait_for(lock, updateDelay);
 	}
+	if (m_numHeaters == 0 && m_currentTemp > nominalTemp)
+	{
+		// Over heated, returning to nominal temperature.
+		--m_currentTemp;
+	}
+
+	// Publish temperature every cycle.
+	PublishTemperature_();
 }
 
 void TempMonitorTask::PublishTemperature_()
 {
-	// If the temperature changes, publish the current temperature.
-	// If the temperature hasn't changed, publish it every ten cycles. This
-	// will generate less noise but still inform late subscribers.
-	constexpr int refreshCount {10};
-	if (m_threshold == 0 || !CompareAlmostEqual(m_lastPublishedTemp, m_currentTemp))
+	// Only publish changes. The value is retained (and cached by the client),
+	// so late subscribers still learn the current temperature.
+	if (m_published && !m_config.publishUnchanged && CompareAlmostEqual(m_lastPublishedTemp, m_currentTemp))
 	{
-		m_lastPublishedTemp = m_currentTemp;
-
-		std::string topic = "/temperature-monitor/temperature";
-		std::string tempJson = "{\"temperature\":" + std::to_string(m_currentTemp) + "}";
-		auto json = nlohmann::json::parse(tempJson);
-		m_mqtt.Publish(topic, json);
-
-		m_threshold = 0;
+		return;
 	}
-	m_threshold = ++m_threshold % refreshCount;
+	m_lastPublishedTemp = m_currentTemp;
+	m_published = true;
+
+	Demo::temperature_t msg;
+	msg.utime = GetClock().Utime();
+	msg.degCelsius = m_currentTemp;
+	constexpr int qos {0};
+	constexpr bool retain {true};
+	m_mqtt.Publish(m_topic, msg, qos, retain);
 }
 
 } // namespace ncc
@@ -1,12 +1,36 @@
 #pragma once
 
 #include <core/BaseThread.h>
+#include <core/CoBus.h>
+#include <core/Coroutine.h>
 #include <core/IMqttClient.h>
-#include <core/IMqttSubscriber.h>
+#include <core/Scheduler.h>
+
+#include <chrono>
+#include <map>
+#include <string>
+
+using namespace std::chrono_literals;
 
 namespace ncc
 {
 
+struct TempMonitorConfig
+{
+	// Prepended to every topic so that several simulated cameras can share a
+	// broker (see camsim-loadgen) or a process (see Fleet).
+	std::string prefix;
+
+	// Time between temperature updates.
+	std::chrono::milliseconds period {1s};
+
+	// Publish every update, not only changes. Used to generate a steady load.
+	bool publishUnchanged {false};
+
+	// Runs the update cycle; the process-wide scheduler() if null.
+	Scheduler* scheduler {nullptr};
+};
+
 static float CompareAlmostEqual(float x, float y)
 {
 	// https://stackoverflow.com/a/2411661
@@ -25,40 +49,50 @@ static float CompareAlmostEqual(float x, float y)
 // - If heaters do not turn off, temperature will increase to 80C.
 // - If heaters are off, temperature will decrease from 80C to 40C.
 //
-// NOTE: Only need one heater topic, but two is easier (for now).
-//
 // Publishes:
-//    Topic: /temperature-monitor/temperature, JSON: {"temperature": -10.0}
+//    Topic: /temperature-monitor/temperature, ZCM: Demo::temperature_t
 // Subscribes:
-//    Topic: /heater/On/#, JSON: {"heater": <N>, "enabled": true}
-//    Topic: /heater/Off/#, JSON: {"heater": <N>, "enabled": false}
+//    Topic: /heater/#, ZCM: Demo::heater_t
 //
 // Note:
 // - Subscription is needed to simulate temperature increasing when heater is
 //   turned on.
-class TempMonitorTask : public BaseThread, public IMqttSubscriber
+// - The update cycle and the heater tracking are two coroutines on one
+//   executor, so they never run concurrently and share state without a lock.
+//   The monitor has no thread of its own.
+class TempMonitorTask : public BaseThread
 {
 public:
 	explicit TempMonitorTask(
 		IMqttClient& mqttClient,
-		bool autostart = true);
-	~TempMonitorTask() override = default;
-
-	void OnConnect(int rc) override;
-	void OnDisconnect(int rc) override;
-	void OnMessage(const std::string& topic, const nlohmann::json& json) override;
+		bool autostart = true,
+		const TempMonitorConfig& config = {});
+	~TempMonitorTask() override;
 
 private:
-	void Run_() override;
+	void OnStart_() override;
+	void OnStop_() override;
+
+	CoTask Cycle_();
+	CoTask Heaters_();
+
+	// One update cycle.
+	void Step_();
 
 	void PublishTemperature_();
 
 private:
 	IMqttClient& m_mqtt;
+	const TempMonitorConfig m_config;
+	const std::string m_topic;
+	const std::string m_heaterTopic;
+	CoExecutor m_executor;
+	CoBus m_bus;
+	std::map<std::string, bool> m_heaters; // Topic => enabled
 	int m_numHeaters {0};
 	float m_currentTemp {0.0};
 	float m_lastPublishedTemp {0.0};
-	int m_threshold {0};
+	bool m_published {false};
 };
 
 } // namespace ncc
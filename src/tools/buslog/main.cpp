@@ -0,0 +1,267 @@
+#include <core/BusLog.h>
+#include <core/BusRecorder.h>
+#include <core/Logger.h>
+#include <core/MqttClient.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+#include <signal.h>
+
+namespace
+{
+
+std::atomic_bool g_stop {false};
+
+void SigIntHandler(int)
+{
+	g_stop = true;
+}
+
+void Usage(const char* argv0)
+{
+	std::cout
+		<< "Usage: " << argv0 << " record|replay|dump FILE [options]\n"
+		<< "\n"
+		<< "Records the messages on an MQTT broker to a bus log, replays a bus log\n"
+		<< "to a broker, or prints it.\n"
+		<< "\n"
+		<< "  record FILE         Record until Ctrl-C\n"
+		<< "    --topic FILTER    Topics to record (#)\n"
+		<< "    --capacity-mb MB  Largest log (1024)\n"
+		<< "  replay FILE         Republish the recorded messages\n"
+		<< "    --rate N          Speed; 1 keeps the original timing, 0 is as fast as\n"
+		<< "                      possible (1)\n"
+		<< "    --topic FILTER    Topics to replay (#)\n"
+		<< "    --retain          Publish as retained messages\n"
+		<< "  dump FILE           Print the recorded messages\n"
+		<< "\n"
+		<< "  --host HOST         Broker host (localhost)\n"
+		<< "  --port PORT         Broker port (1883)\n"
+		<< "  --from S            Start S seconds after the first message (0)\n"
+		<< "  --to S              Stop S seconds after the first message (end)\n";
+}
+
+struct Options
+{
+	std::string command;
+	std::string path;
+	std::string host {"localhost"};
+	int port {1883};
+	std::string topic {"#"};
+	std::size_t capacity {std::size_t {1024} << 20};
+	double rate {1.0};
+	bool retain {false};
+	double from {0.0};
+	std::optional<double> to;
+};
+
+bool WaitConnected(const ncc::IMqttClient& mqttClient)
+{
+	for (int i = 0; i < 500 && !g_stop; ++i)
+	{
+		if (mqttClient.IsConnected())
+		{
+			return true;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	return mqttClient.IsConnected();
+}
+
+// Receive times selected by --from and --to.
+std::pair<std::int64_t, std::int64_t> Range(const ncc::BusLogReader& log, const Options& options)
+{
+	auto offset = log.Begin();
+	auto first = log.Next(offset);
+	if (!first)
+	{
+		return {0, -1};
+	}
+	auto from = first->utime + static_cast<std::int64_t>(options.from * 1e6);
+	auto to = options.to
+		? first->utime + static_cast<std::int64_t>(*options.to * 1e6)
+		: std::numeric_limits<std::int64_t>::max();
+	return {from, to};
+}
+
+int Record(const Options& options)
+{
+	ncc::MqttClient mqttClient("camsim-buslog", options.host, options.port);
+	ncc::BusRecorder recorder(mqttClient, options.path, ncc::BusRecorderConfig {
+		.topic = options.topic,
+		.log = {.capacity = options.capacity},
+	});
+	if (!WaitConnected(mqttClient))
+	{
+		std::cerr << "Not connected to " << options.host << ":" << options.port << " yet; still trying." << std::endl;
+	}
+
+	std::cout << "Recording " << options.topic << " to " << options.path << ", press Ctrl-C to stop." << std::endl;
+	while (!g_stop)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+
+	std::printf("Recorded %llu message(s), %llu bytes, %llu dropped\n",
+		static_cast<unsigned long long>(recorder.Recorded()),
+		static_cast<unsigned long long>(recorder.Bytes()),
+		static_cast<unsigned long long>(recorder.Dropped()));
+	return 0;
+}
+
+int Replay(const Options& options)
+{
+	ncc::MqttClient mqttClient("camsim-buslog", options.host, options.port);
+	ncc::BusReplayer replayer(mqttClient, options.path);
+	if (!WaitConnected(mqttClient))
+	{
+		std::cerr << "Not connected to " << options.host << ":" << options.port << std::endl;
+		return 1;
+	}
+
+	ncc::BusLogReader log(options.path);
+	auto [from, to] = Range(log, options);
+	auto stats = replayer.Run(ncc::ReplayConfig {
+		.rate = options.rate,
+		.from = from,
+		.to = to,
+		.topic = options.topic,
+		.retain = options.retain,
+	}, g_stop);
+
+	std::printf("Replayed %llu message(s) over %.3f s of recording, %llu failed\n",
+		static_cast<unsigned long long>(stats.published),
+		static_cast<double>(stats.last - stats.first) / 1e6,
+		static_cast<unsigned long long>(stats.failed));
+	return stats.failed ? 1 : 0;
+}
+
+int Dump(const Options& options)
+{
+	ncc::BusLogReader log(options.path);
+	auto [from, to] = Range(log, options);
+	auto offset = log.Begin();
+	auto first = log.Next(offset);
+
+	for (offset = log.Seek(from); !g_stop; )
+	{
+		auto record = log.Next(offset);
+		if (!record || record->utime > to)
+		{
+			break;
+		}
+
+		// Text (i.e. JSON) payloads are printed as is; ZCM and other binary
+		// payloads by size only.
+		std::string_view text(reinterpret_cast<const char*>(record->payload.data()), record->payload.size());
+		bool printable = std::all_of(text.begin(), text.end(), [](unsigned char c) { return std::isprint(c) || std::isspace(c); });
+		std::printf("%+14.6f %.*s %zu %.*s\n",
+			static_cast<double>(record->utime - first->utime) / 1e6,
+			static_cast<int>(record->topic.size()), record->topic.data(),
+			record->payload.size(),
+			printable ? static_cast<int>(text.size()) : 0, text.data());
+	}
+	return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	Options options;
+
+	try
+	{
+		if (argc < 3)
+		{
+			throw std::invalid_argument("a command and a file are needed");
+		}
+		options.command = argv[1];
+		options.path = argv[2];
+		if (options.command != "record" && options.command != "replay" && options.command != "dump")
+		{
+			throw std::invalid_argument("unknown command " + options.command);
+		}
+
+		for (int i = 3; i < argc; ++i)
+		{
+			std::string arg(argv[i]);
+			auto value = [&]() -> std::string {
+				if (i + 1 >= argc)
+				{
+					throw std::invalid_argument(arg + " needs a value");
+				}
+				return argv[++i];
+			};
+
+			if (arg == "--host")             { options.host = value(); }
+			else if (arg == "--port")        { options.port = std::stoi(value()); }
+			else if (arg == "--topic")       { options.topic = value(); }
+			else if (arg == "--capacity-mb") { options.capacity = std::stoull(value()) << 20; }
+			else if (arg == "--rate")        { options.rate = std::stod(value()); }
+			else if (arg == "--retain")      { options.retain = true; }
+			else if (arg == "--from")        { options.from = std::stod(value()); }
+			else if (arg == "--to")          { options.to = std::stod(value()); }
+			else if (arg == "--help" || arg == "-h")
+			{
+				Usage(argv[0]);
+				return 0;
+			}
+			else
+			{
+				throw std::invalid_argument("unknown option " + arg);
+			}
+		}
+		if (options.rate < 0.0)
+		{
+			throw std::invalid_argument("--rate must not be negative");
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << argv[0] << ": " << e.what() << "\n";
+		Usage(argv[0]);
+		return 2;
+	}
+
+	signal(SIGINT, SigIntHandler);
+
+	int ret {0};
+	try
+	{
+		// Log to a file only; stdout is for the results.
+		ncc::InitializeLogger("camsim-buslog", false, {"file"}, spdlog::level::warn);
+
+		if (options.command == "record")
+		{
+			ret = Record(options);
+		}
+		else if (options.command == "replay")
+		{
+			ret = Replay(options);
+		}
+		else
+		{
+			ret = Dump(options);
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "main(): caught: " << e.what() << std::endl;
+		ret = 1;
+	}
+
+	return ret;
+}
@@ -0,0 +1,190 @@
+#include <core/IMqttSubscriber.h>
+#include <core/Logger.h>
+#include <core/Metrics.h>
+#include <core/MqttClient.h>
+#include <core/ZcmMessage.h>
+#include <loadgen/LoadGen.h>
+#include <plugin/Heater/HeaterTask.h>
+#include <plugin/TempMonitor/TempMonitorTask.h>
+
+#include <memory>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <types/Demo/temperature_t.hpp>
+
+namespace ncc
+{
+
+namespace
+{
+
+constexpr std::string_view temperatureTopic {"/temperature-monitor/temperature"};
+
+// Sleeps for "duration" or until "stop" is set. Returns false if stopped.
+bool SleepFor(std::chrono::milliseconds duration, const std::atomic_bool& stop)
+{
+	auto deadline = std::chrono::steady_clock::now() + duration;
+	while (std::chrono::steady_clock::now() < deadline)
+	{
+		if (stop)
+		{
+			return false;
+		}
+		std::this_thread::sleep_for(10ms);
+	}
+	return !stop;
+}
+
+// One simulated camera: its own connection, a temperature monitor and its
+// heaters, all publishing under "<prefix>/<num>".
+struct Camera
+{
+	Camera(const LoadGenConfig& config, int num)
+		: name("camsim-loadgen-" + std::to_string(num))
+		, prefix(config.prefix + "/" + std::to_string(num))
+		, client(name, config.host, config.port, config.outbox, LocalDeliveryConfig {.enabled = true})
+		, tempMonitor(client, false, TempMonitorConfig {
+			.prefix = prefix,
+			.period = config.period,
+			.publishUnchanged = true,
+		})
+		, sent(metrics().Counter("mqtt_messages_sent_total", "Messages sent to the broker", {{"client", name}}))
+	{
+		for (int i = 1; i <= config.heatersPerCamera; ++i)
+		{
+			heaters.push_back(std::make_unique<HeaterTask>(client, i, false, prefix));
+		}
+	}
+
+	void Start()
+	{
+		tempMonitor.Start();
+		for (auto& heater : heaters)
+		{
+			heater->Start();
+		}
+	}
+
+	std::uint64_t Dropped() const
+	{
+		auto stats = client.GetOutboxStats();
+		return stats.droppedOldest + stats.droppedNewest + stats.timedOut + stats.sendFailed;
+	}
+
+	const std::string name;
+	const std::string prefix;
+
+	// Declared first so that the tasks are stopped before it is destroyed.
+	MqttClient client;
+	TempMonitorTask tempMonitor;
+	std::vector<std::unique_ptr<HeaterTask>> heaters;
+
+	// The counter outlives the client, so it keeps counting across runs.
+	CounterMetric& sent;
+};
+
+// Counts everything the cameras publish and measures the temperature latency.
+// Runs on the observer client's network thread.
+class Observer : public IMqttSubscriber
+{
+public:
+	void OnConnect(int rc) override {}
+	void OnDisconnect(int rc) override {}
+
+	void OnRawMessage(const MqttMessage& msg) override
+	{
+		m_received.fetch_add(1, std::memory_order_relaxed);
+		if (msg.Topic().ends_with(temperatureTopic) && ZcmDecode(msg.Payload(), m_msg) && m_msg.utime > 0)
+		{
+			m_latency.Record(std::chrono::microseconds(UtimeNow() - m_msg.utime));
+		}
+	}
+
+	std::uint64_t Received() const { return m_received.load(std::memory_order_relaxed); }
+	Histogram& Latency() { return m_latency; }
+
+private:
+	std::atomic<std::uint64_t> m_received {0};
+	Demo::temperature_t m_msg {};
+	Histogram m_latency;
+};
+
+} // namespace
+
+LoadGen::LoadGen(const LoadGenConfig& config)
+	: m_config(config)
+{
+}
+
+LoadGenResult LoadGen::Run(int cameras, const std::atomic_bool& stop)
+{
+	LoadGenResult result;
+	result.cameras = cameras;
+	result.offeredRate = cameras * 1000.0 / static_cast<double>(m_config.period.count());
+
+	Observer observer;
+	MqttClient observerClient("camsim-loadgen-observer", m_config.host, m_config.port);
+	observerClient.RegisterSub(m_config.prefix + "/#", &observer);
+
+	std::vector<std::unique_ptr<Camera>> fleet;
+	fleet.reserve(cameras);
+	for (int i = 0; i < cameras; ++i)
+	{
+		fleet.push_back(std::make_unique<Camera>(m_config, i));
+	}
+	for (auto& camera : fleet)
+	{
+		camera->Start();
+	}
+	logger()->info("LoadGen::Run(): started {} camera(s)", cameras);
+
+	auto sum = [&fleet](auto fn) {
+		std::uint64_t total {0};
+		for (const auto& camera : fleet)
+		{
+			total += fn(*camera);
+		}
+		return total;
+	};
+	auto sent = [](const Camera& camera) { return camera.sent.Value(); };
+	auto dropped = [](const Camera& camera) { return camera.Dropped(); };
+
+	if (SleepFor(m_config.warmup, stop))
+	{
+		auto sent0 = sum(sent);
+		auto dropped0 = sum(dropped);
+		auto received0 = observer.Received();
+		observer.Latency().Reset();
+		auto start = std::chrono::steady_clock::now();
+
+		SleepFor(m_config.duration, stop);
+
+		// Messages in flight at either end of the window skew the loss by
+		// roughly rate x latency.
+		result.sent = sum(sent) - sent0;
+		result.dropped = sum(dropped) - dropped0;
+		result.received = observer.Received() - received0;
+		result.lost = static_cast<std::int64_t>(result.sent) - static_cast<std::int64_t>(result.received);
+		result.latency = observer.Latency().Summary();
+
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		result.sentRate = static_cast<double>(result.sent) / elapsed.count();
+		result.receivedRate = static_cast<double>(result.received) / elapsed.count();
+	}
+
+	for (const auto& camera : fleet)
+	{
+		if (!camera->client.IsConnected())
+		{
+			++result.notConnected;
+		}
+	}
+
+	fleet.clear();
+	observerClient.UnregisterSub(&observer);
+	return result;
+}
+
+} // namespace ncc
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <core/Histogram.h>
+#include <core/Outbox.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+using namespace std::chrono_literals;
+
+namespace ncc
+{
+
+struct LoadGenConfig
+{
+	std::string host {"localhost"};
+	int port {1883};
+
+	// Camera N publishes under "<prefix>/<N>".
+	std::string prefix {"/camsim"};
+
+	int heatersPerCamera {1};
+
+	// Every camera publishes one temperature per period.
+	std::chrono::milliseconds period {100ms};
+
+	// Time for the cameras to connect and settle before measuring, and how
+	// long to measure.
+	std::chrono::milliseconds warmup {2s};
+	std::chrono::milliseconds duration {10s};
+
+	OutboxConfig outbox {
+		.capacity = 1024,
+		.policy = OverflowPolicy::DropOldest,
+	};
+};
+
+struct LoadGenResult
+{
+	int cameras {0};
+	double offeredRate {0};     // Temperature messages per second, by configuration
+	double sentRate {0};        // Messages per second sent to the broker
+	double receivedRate {0};    // Messages per second received by the observer
+	std::uint64_t sent {0};
+	std::uint64_t received {0};
+	std::int64_t lost {0};      // Sent but not received; QoS 0 drops by the broker or network
+	std::uint64_t dropped {0};  // Dropped by the camera outboxes before being sent
+	int notConnected {0};       // Cameras that never connected
+	HistogramSummary latency;   // Publish to observer, nanoseconds
+};
+
+// LoadGen runs simulated cameras against a broker and measures what an
+// observer receives.
+//
+// Each camera is a MqttClient of its own with a TempMonitorTask and
+// HeaterTasks, configured like the "camera" app but publishing under a
+// per-camera prefix. The observer is one more client subscribed to every
+// camera. Latency is measured from the "utime" stamped into each temperature
+// message, so the observer must run on the same host as the cameras.
+//
+// NOTE: Every camera has a connection (and network thread) of its own, so
+// the host's limits may be reached before the broker's.
+class LoadGen
+{
+public:
+	explicit LoadGen(const LoadGenConfig& config);
+
+	// Starts "cameras" cameras, measures for the configured duration and
+	// stops them again. Returns early (with what was measured) once
+	// "stop" is set.
+	LoadGenResult Run(int cameras, const std::atomic_bool& stop);
+
+private:
+	const LoadGenConfig m_config;
+};
+
+} // namespace ncc
@@ -0,0 +1,144 @@
+#include <core/Logger.h>
+#include <loadgen/LoadGen.h>
+
+#include <atomic>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <signal.h>
+
+namespace
+{
+
+std::atomic_bool g_stop {false};
+
+void SigIntHandler(int)
+{
+	g_stop = true;
+}
+
+void Usage(const char* argv0)
+{
+	std::cout
+		<< "Usage: " << argv0 << " [options]\n"
+		<< "\n"
+		<< "Runs simulated cameras against an MQTT broker and reports what an\n"
+		<< "observer receives. With several camera counts, one run per count.\n"
+		<< "\n"
+		<< "  --host HOST         Broker host (localhost)\n"
+		<< "  --port PORT         Broker port (1883)\n"
+		<< "  --cameras N[,N...]  Number of cameras per run (10)\n"
+		<< "  --heaters N         Heaters per camera (1)\n"
+		<< "  --period-ms MS      Temperature publish period per camera (100)\n"
+		<< "  --warmup-ms MS      Time to connect and settle before measuring (2000)\n"
+		<< "  --duration-ms MS    Measurement time per run (10000)\n"
+		<< "  --prefix TOPIC      Topic prefix (/camsim)\n";
+}
+
+std::vector<int> ParseList(const std::string& text)
+{
+	std::vector<int> values;
+	std::istringstream ss(text);
+	std::string item;
+	while (std::getline(ss, item, ','))
+	{
+		values.push_back(std::stoi(item));
+	}
+	return values;
+}
+
+double Ms(std::uint64_t ns)
+{
+	return static_cast<double>(ns) / 1e6;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	ncc::LoadGenConfig config;
+	std::vector<int> cameraCounts {10};
+
+	try
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			std::string arg(argv[i]);
+			auto value = [&]() -> std::string {
+				if (i + 1 >= argc)
+				{
+					throw std::invalid_argument(arg + " needs a value");
+				}
+				return argv[++i];
+			};
+
+			if (arg == "--host")             { config.host = value(); }
+			else if (arg == "--port")        { config.port = std::stoi(value()); }
+			else if (arg == "--cameras")     { cameraCounts = ParseList(value()); }
+			else if (arg == "--heaters")     { config.heatersPerCamera = std::stoi(value()); }
+			else if (arg == "--period-ms")   { config.period = std::chrono::milliseconds(std::stoi(value())); }
+			else if (arg == "--warmup-ms")   { config.warmup = std::chrono::milliseconds(std::stoi(value())); }
+			else if (arg == "--duration-ms") { config.duration = std::chrono::milliseconds(std::stoi(value())); }
+			else if (arg == "--prefix")      { config.prefix = value(); }
+			else if (arg == "--help" || arg == "-h")
+			{
+				Usage(argv[0]);
+				return 0;
+			}
+			else
+			{
+				throw std::invalid_argument("unknown option " + arg);
+			}
+		}
+		if (config.period.count() <= 0)
+		{
+			throw std::invalid_argument("--period-ms must be positive");
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << argv[0] << ": " << e.what() << "\n";
+		Usage(argv[0]);
+		return 2;
+	}
+
+	signal(SIGINT, SigIntHandler);
+
+	int ret {0};
+	try
+	{
+		// Log to a file only; stdout is for the results.
+		ncc::InitializeLogger("camsim-loadgen", false, {"file"}, spdlog::level::warn);
+
+		ncc::LoadGen loadGen(config);
+
+		std::printf("%8s %10s %10s %10s %9s %9s %8s %8s %8s %8s %8s\n",
+			"cameras", "offered/s", "sent/s", "recv/s", "lost", "dropped",
+			"p50 ms", "p99 ms", "p999 ms", "max ms", "offline");
+		for (int cameras : cameraCounts)
+		{
+			if (g_stop)
+			{
+				break;
+			}
+
+			auto r = loadGen.Run(cameras, g_stop);
+			std::printf("%8d %10.0f %10.0f %10.0f %9lld %9llu %8.2f %8.2f %8.2f %8.2f %8d\n",
+				r.cameras, r.offeredRate, r.sentRate, r.receivedRate,
+				static_cast<long long>(r.lost), static_cast<unsigned long long>(r.dropped),
+				Ms(r.latency.p50), Ms(r.latency.p99), Ms(r.latency.p999), Ms(r.latency.max),
+				r.notConnected);
+			std::fflush(stdout);
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "main(): caught: " << e.what() << std::endl;
+		ret = 1;
+	}
+
+	return ret;
+}